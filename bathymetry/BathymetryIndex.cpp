@@ -0,0 +1,383 @@
+/*
+ *      Copyright (c) 2006- Imperial College London
+ *      See COPYING file for copying and redistribution conditions.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; version 2 of the License.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      Contact info: gerard.j.gorman@gmail.com/g.gorman@imperial.ac.uk
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "BathymetryIndex.h"
+#include "LRUPageBuffer.h"
+#include "MappedStorageManager.h"
+#include "NetCDF_reader.h"
+
+using namespace std;
+using namespace SpatialIndex;
+
+// Tiles have tile_size x tile_size cells, and neighbouring tiles share
+// their edge points, so every cell lies wholly in one tile.
+const int tile_size = 128;
+
+// Page size of the storage manager and the number of pages (tree nodes
+// and tiles) held in memory by each process.
+const uint32_t page_size = 4096;
+const uint32_t buffer_capacity = 32;
+
+const int header_magic = 0x42415448;
+const uint32_t header_length = 3*sizeof(int) + sizeof(id_type) + 6*sizeof(double);
+
+namespace{
+  // Collects the identifiers (storage pages) of the tiles found.
+  class TileVisitor : public IVisitor, public vector<id_type>{
+  public:
+    virtual void visitNode(const INode& node){}
+    virtual void visitData(const IData& data){
+      push_back(data.getIdentifier());
+    }
+    virtual void visitData(vector<const IData*>& v){}
+  };
+
+  // Streams the tile extents to the bulk loader.
+  class TileStream : public IDataStream{
+  public:
+    TileStream(const vector<Region> &regions, const vector<id_type> &pages) : regions(regions), pages(pages), index(0){}
+    virtual ~TileStream(){}
+
+    virtual IData* getNext(){
+      Region region(regions[index]);
+      IData *data = new RTree::Data(0, NULL, region, pages[index]);
+      index++;
+      return data;
+    }
+    virtual bool hasNext(){
+      return index<regions.size();
+    }
+    virtual uint32_t size(){
+      return regions.size();
+    }
+    virtual void rewind(){
+      index = 0;
+    }
+
+  private:
+    const vector<Region> &regions;
+    const vector<id_type> &pages;
+    size_t index;
+  };
+
+  void store_header(IStorageManager *sm, id_type &page, id_type index_id, const double *x_range,
+                    const double *y_range, const double *spacing, const int *dimension){
+    ::byte header[header_length];
+    ::byte *ptr = header;
+    memcpy(ptr, &header_magic, sizeof(int));       ptr += sizeof(int);
+    memcpy(ptr, dimension, 2*sizeof(int));         ptr += 2*sizeof(int);
+    memcpy(ptr, &index_id, sizeof(id_type));       ptr += sizeof(id_type);
+    memcpy(ptr, x_range, 2*sizeof(double));        ptr += 2*sizeof(double);
+    memcpy(ptr, y_range, 2*sizeof(double));        ptr += 2*sizeof(double);
+    memcpy(ptr, spacing, 2*sizeof(double));
+
+    sm->storeByteArray(page, header_length, header);
+  }
+}
+
+BathymetryIndex::BathymetryIndex(){
+  VerboseOff();
+  is_constant = true;
+  storageManager = NULL;
+  storage = NULL;
+  rTree = NULL;
+}
+
+BathymetryIndex::~BathymetryIndex(){
+  Free();
+}
+
+BathymetryIndex::BathymetryIndex(string basename){
+  VerboseOff();
+  storageManager = NULL;
+  storage = NULL;
+  rTree = NULL;
+  SetFile(basename);
+  return;
+}
+
+void BathymetryIndex::Create(string filename, string basename){
+  NetCDF_reader reader(filename.c_str(), false);
+
+  double x_range[2], y_range[2], spacing[2];
+  int dimension[2];
+  reader.GetXRange(x_range[0], x_range[1]);
+  reader.GetYRange(y_range[0], y_range[1]);
+  reader.GetSpacing(spacing[0], spacing[1]);
+  reader.GetDimension(dimension[0], dimension[1]);
+
+  vector<double> data;
+  reader.Read(data);
+
+  Create(x_range, y_range, spacing, dimension, data, basename);
+}
+
+void BathymetryIndex::Create(const double *x_range, const double *y_range, const double *spacing,
+                             const int *dimension, const vector<double> &data, string basename){
+  assert(data.size()==(size_t)dimension[0]*dimension[1]);
+
+  // The header is the first page, and is stored again with the
+  // identifier of the tree once the tree is built.
+  IStorageManager *diskfile = StorageManager::createNewDiskStorageManager(basename, page_size);
+  id_type header_page = StorageManager::NewPage;
+  store_header(diskfile, header_page, StorageManager::NewPage, x_range, y_range, spacing, dimension);
+  assert(header_page==0);
+
+  // Store the tiles, each as its first grid point, its size and its values.
+  vector<Region> regions;
+  vector<id_type> pages;
+  vector< ::byte> buffer;
+  for(int j0=0;j0==0 || j0<dimension[1]-1;j0+=tile_size){
+    int nj = min(tile_size+1, dimension[1]-j0);
+    for(int i0=0;i0==0 || i0<dimension[0]-1;i0+=tile_size){
+      int ni = min(tile_size+1, dimension[0]-i0);
+
+      int extent[] = {i0, j0, ni, nj};
+      buffer.resize(sizeof(extent) + ni*nj*sizeof(double));
+      memcpy(&(buffer[0]), extent, sizeof(extent));
+      double *values = (double *)&(buffer[sizeof(extent)]);
+      for(int j=0;j<nj;j++)
+        for(int i=0;i<ni;i++)
+          values[j*ni+i] = data[(j0+j)*dimension[0]+i0+i];
+
+      id_type page = StorageManager::NewPage;
+      diskfile->storeByteArray(page, buffer.size(), &(buffer[0]));
+
+      double low[] = {x_range[0]+i0*spacing[0], y_range[0]+j0*spacing[1]};
+      double high[] = {x_range[0]+(i0+ni-1)*spacing[0], y_range[0]+(j0+nj-1)*spacing[1]};
+      regions.push_back(Region(low, high, 2));
+      pages.push_back(page);
+    }
+  }
+
+  TileStream stream(regions, pages);
+  id_type index_id;
+  ISpatialIndex *tree = RTree::createAndBulkLoadNewRTree(RTree::BLM_STR, stream, *diskfile, 0.7, 100, 100, 2,
+                                                         RTree::RV_RSTAR, index_id);
+  delete tree;
+
+  store_header(diskfile, header_page, index_id, x_range, y_range, spacing, dimension);
+  delete diskfile;
+}
+
+void BathymetryIndex::Free(){
+  if(rTree){
+    delete rTree;
+    rTree = NULL;
+  }
+  delete storage;
+  storage = NULL;
+  delete storageManager;
+  storageManager = NULL;
+}
+
+bool BathymetryIndex::HasPoint(double longitude, double latitude) const{
+  if(verbose)
+    cout<<"double BathymetryIndex::HasValue("<<longitude<<", "<<latitude<<") const\n";
+
+  if(longitude<x_range[0])
+    return false;
+  if(longitude>x_range[1])
+    return false;
+
+  if(latitude<y_range[0])
+    return false;
+  if(latitude>y_range[1])
+    return false;
+
+  return true;
+}
+
+void BathymetryIndex::LoadTile(int i0, int i1, int j0, int j1){
+  if(verbose)
+    cout<<"void BathymetryIndex::LoadTile("<<i0<<", "<<i1<<", "<<j0<<", "<<j1<<")\n";
+
+  double centre[] = {x_range[0] + 0.5*(i0+i1)*spacing[0], y_range[0] + 0.5*(j0+j1)*spacing[1]};
+  TileVisitor visitor;
+  rTree->pointLocationQuery(Point(centre, 2), visitor);
+
+  // Tiles meet at their edges, so a point may be in more than one of
+  // them; take the first that holds all the points around it.
+  for(size_t t=0;t<visitor.size();t++){
+    uint32_t len;
+    ::byte *data;
+    storage->loadByteArray(visitor[t], len, &data);
+
+    int extent[4] = {0, 0, 0, 0};
+    if(len>=sizeof(extent))
+      memcpy(extent, data, sizeof(extent));
+    if(len!=sizeof(extent)+(size_t)extent[2]*extent[3]*sizeof(double)){
+      delete [] data;
+      cerr<<__FILE__<<", "<<__LINE__<<": ERROR - corrupt tile in bathymetry index\n";
+      exit(-1);
+    }
+    if(i0>=extent[0] && i1<extent[0]+extent[2] && j0>=extent[1] && j1<extent[1]+extent[3]){
+      memcpy(tile, extent, sizeof(extent));
+      tile_data.resize(extent[2]*extent[3]);
+      memcpy(&(tile_data[0]), data+sizeof(extent), tile_data.size()*sizeof(double));
+      delete [] data;
+      return;
+    }
+    delete [] data;
+  }
+
+  cerr<<__FILE__<<", "<<__LINE__<<": ERROR - no tile holds grid points ("
+      <<i0<<", "<<j0<<") to ("<<i1<<", "<<j1<<")\n";
+  exit(-1);
+}
+
+double BathymetryIndex::GetTileValue(int ix, int iy) const{
+  if(verbose)
+    cout<<"double BathymetryIndex::GetTileValue("<<ix<<", "<<iy<<") const";
+
+  assert(!is_constant);
+
+  ix = std::min(std::max(ix, 0), dimension[0]-1) - tile[0];
+  iy = std::min(std::max(iy, 0), dimension[1]-1) - tile[1];
+  assert(ix>=0 && ix<tile[2]);
+  assert(iy>=0 && iy<tile[3]);
+
+  if(verbose)
+    cout<<" = "<<tile_data[iy*tile[2]+ix]<<endl;
+
+  return tile_data[iy*tile[2]+ix];
+}
+
+double BathymetryIndex::GetValue(double longitude, double latitude){
+  if(verbose)
+    cout<<"double BathymetryIndex::GetValue("<<longitude<<", "<<latitude<<")\n";
+
+  if(is_constant)
+    return 1.0;
+
+  longitude = std::min(std::max(x_range[0], longitude), x_range[1]);
+  latitude = std::min(std::max(y_range[0], latitude), y_range[1]);
+
+  int i0 = (int)floor((longitude - x_range[0])/spacing[0]);
+  int i1 =  (int)ceil((longitude - x_range[0])/spacing[0]);
+
+  int j0 = (int)floor((latitude - y_range[0])/spacing[1]);
+  int j1 =  (int)ceil((latitude - y_range[0])/spacing[1]);
+
+  double x0 = x_range[0] + i0*spacing[0];
+  double x1 = x_range[0] + i1*spacing[0];
+
+  double y0 = y_range[0] + j0*spacing[1];
+  double y1 = y_range[0] + j1*spacing[1];
+
+  // Consecutive points are usually close together, so the tile of the
+  // previous point is kept.
+  int ci0 = std::min(std::max(i0, 0), dimension[0]-1);
+  int ci1 = std::min(std::max(i1, 0), dimension[0]-1);
+  int cj0 = std::min(std::max(j0, 0), dimension[1]-1);
+  int cj1 = std::min(std::max(j1, 0), dimension[1]-1);
+  if(ci0<tile[0] || ci1>=tile[0]+tile[2] || cj0<tile[1] || cj1>=tile[1]+tile[3])
+    LoadTile(ci0, ci1, cj0, cj1);
+
+  double z00 = GetTileValue(i0, j0);
+  double z01 = GetTileValue(i0, j1);
+  double z10 = GetTileValue(i1, j0);
+  double z11 = GetTileValue(i1, j1);
+
+  double val;
+  if(i0==i1){ // No interpolation along longitude
+    if(j0==j1){
+      val = z00;
+    }else{
+      val = z00 + (latitude-y0)*(z01-z00)/(y1-y0);
+    }
+  }else if(j0==j1){ // No interpolation along latitude
+    val =  z00 + (longitude-x0)*(z10-z00)/(x1-x0);
+  }else{ // Bi-linear interpolation
+    double dx = x1-x0;
+    double dy = y1-y0;
+
+    val = (z00*(x1-longitude)*(y1-latitude) +
+           z10*(longitude-x0)*(y1-latitude) +
+           z01*(x1-longitude)*(latitude-y0) +
+           z11*(longitude-x0)*(latitude-y0))/(dx*dy);
+  }
+
+  if(verbose)
+    cout<<"z00, z10, z01, z11, val = "
+        <<z00<<", "<<z10<<", "<<z01<<", "<<z11<<", "<<val<<endl;
+
+  return val;
+}
+
+void BathymetryIndex::SetFile(string basename){
+  Free();
+
+  if(basename.empty()){
+    is_constant=true;
+    return;
+  }
+
+  try{
+    storageManager = new MappedStorageManager(basename);
+    storage = new LRUPageBuffer(*storageManager, buffer_capacity);
+
+    uint32_t len;
+    ::byte *header;
+    storageManager->loadByteArray(0, len, &header);
+    if(len!=header_length){
+      delete [] header;
+      cerr<<__FILE__<<", "<<__LINE__<<": ERROR - "<<basename<<" is not a bathymetry index\n";
+      exit(-1);
+    }
+
+    int magic;
+    id_type index_id;
+    ::byte *ptr = header;
+    memcpy(&magic, ptr, sizeof(int));         ptr += sizeof(int);
+    memcpy(dimension, ptr, 2*sizeof(int));    ptr += 2*sizeof(int);
+    memcpy(&index_id, ptr, sizeof(id_type));  ptr += sizeof(id_type);
+    memcpy(x_range, ptr, 2*sizeof(double));   ptr += 2*sizeof(double);
+    memcpy(y_range, ptr, 2*sizeof(double));   ptr += 2*sizeof(double);
+    memcpy(spacing, ptr, 2*sizeof(double));
+    delete [] header;
+
+    if(magic!=header_magic){
+      cerr<<__FILE__<<", "<<__LINE__<<": ERROR - "<<basename<<" is not a bathymetry index\n";
+      exit(-1);
+    }
+
+    rTree = RTree::loadRTree(*storage, index_id);
+  }catch(Tools::Exception &e){
+    cerr<<__FILE__<<", "<<__LINE__<<": ERROR - cannot open bathymetry index "<<basename<<": "<<e.what()<<endl;
+    exit(-1);
+  }
+
+  for(int i=0;i<4;i++)
+    tile[i] = 0;
+
+  is_constant = false;
+}
+
+void BathymetryIndex::VerboseOff(){
+  verbose=false;
+}
+
+void BathymetryIndex::VerboseOn(){
+  verbose=true;
+}
@@ -0,0 +1,81 @@
+/*
+ *      Copyright (c) 2006- Imperial College London
+ *      See COPYING file for copying and redistribution conditions.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; version 2 of the License.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      Contact info: gerard.j.gorman@gmail.com/g.gorman@imperial.ac.uk
+ */
+#ifndef BATHYMETRYINDEX_H
+#define BATHYMETRYINDEX_H
+
+#include "confdefs.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <spatialindex/SpatialIndex.h>
+
+/** Out-of-core sampling of gridded data, such as global bathymetry.
+
+    The grid is cut into overlapping tiles, which are stored with an
+    R-tree of their extents in the .idx and .dat files of a spatialindex
+    disk storage manager (see Create). The files are opened read-only and
+    memory mapped, so the operating system shares the pages between all
+    the processes on a node, and only the tiles being sampled are copied
+    into a small least recently used buffer. Values are interpolated as
+    by SampleNetCDF2.
+*/
+class BathymetryIndex{
+ public:
+  BathymetryIndex();
+  BathymetryIndex(std::string);
+  ~BathymetryIndex();
+
+  /// Create the index basename.idx/basename.dat from a netCDF grid.
+  static void Create(std::string filename, std::string basename);
+
+  /// Create the index basename.idx/basename.dat from a grid of
+  /// dimension[0] x dimension[1] values, longitude varying fastest.
+  static void Create(const double *x_range, const double *y_range, const double *spacing,
+                     const int *dimension, const std::vector<double> &data, std::string basename);
+
+  double GetValue(double, double);
+
+  bool HasPoint(double, double) const;
+
+  void SetFile(std::string);
+
+  void VerboseOff();
+  void VerboseOn();
+
+ private:
+  double GetTileValue(int, int) const;
+  void LoadTile(int i0, int i1, int j0, int j1);
+  void Free();
+
+  bool is_constant;
+
+  double x_range[2];          // Longitude
+  double y_range[2];          // Latitude
+
+  double spacing[2];          // Grid spacing
+  int dimension[2];           // Grid dimensions
+
+  SpatialIndex::IStorageManager *storageManager;
+  SpatialIndex::StorageManager::IBuffer *storage;
+  SpatialIndex::ISpatialIndex *rTree;
+
+  int tile[4];                // First grid point and size of the current tile
+  std::vector<double> tile_data;
+  bool verbose;
+};
+#endif
@@ -0,0 +1,84 @@
+/*
+ *      Copyright (c) 2006- Imperial College London
+ *      See COPYING file for copying and redistribution conditions.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; version 2 of the License.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      Contact info: gerard.j.gorman@gmail.com/g.gorman@imperial.ac.uk
+ */
+
+#include <cassert>
+#include <cstring>
+
+#include "LRUPageBuffer.h"
+
+using namespace std;
+using namespace SpatialIndex;
+
+LRUPageBuffer::LRUPageBuffer(IStorageManager &storageManager, size_t capacity) :
+  storageManager(storageManager), capacity(capacity), hits(0){
+  assert(capacity>0);
+}
+
+LRUPageBuffer::~LRUPageBuffer(){
+}
+
+void LRUPageBuffer::loadByteArray(const id_type page, uint32_t& len, ::byte** data){
+  map<id_type, Entry>::iterator it = pages.find(page);
+  if(it!=pages.end()){
+    hits++;
+    recency.splice(recency.begin(), recency, it->second.position);
+  }else{
+    ::byte *loaded;
+    uint32_t length;
+    storageManager.loadByteArray(page, length, &loaded);
+    if(pages.size()==capacity)
+      Forget(recency.back());
+
+    it = pages.insert(make_pair(page, Entry())).first;
+    it->second.data.assign(loaded, loaded + length);
+    delete [] loaded;
+    recency.push_front(page);
+    it->second.position = recency.begin();
+  }
+
+  // Callers own, and delete, the copy they are given.
+  len = it->second.data.size();
+  *data = new ::byte[len];
+  if(len>0)
+    memcpy(*data, &(it->second.data[0]), len);
+}
+
+void LRUPageBuffer::storeByteArray(id_type& page, const uint32_t len, const ::byte* const data){
+  storageManager.storeByteArray(page, len, data);
+  Forget(page);
+}
+
+void LRUPageBuffer::deleteByteArray(const id_type page){
+  storageManager.deleteByteArray(page);
+  Forget(page);
+}
+
+uint64_t LRUPageBuffer::getHits(){
+  return hits;
+}
+
+void LRUPageBuffer::clear(){
+  pages.clear();
+  recency.clear();
+}
+
+void LRUPageBuffer::Forget(id_type page){
+  map<id_type, Entry>::iterator it = pages.find(page);
+  if(it==pages.end())
+    return;
+  recency.erase(it->second.position);
+  pages.erase(it);
+}
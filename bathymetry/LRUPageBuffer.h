@@ -0,0 +1,61 @@
+/*
+ *      Copyright (c) 2006- Imperial College London
+ *      See COPYING file for copying and redistribution conditions.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; version 2 of the License.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      Contact info: gerard.j.gorman@gmail.com/g.gorman@imperial.ac.uk
+ */
+
+#ifndef LRUPAGEBUFFER_H
+#define LRUPAGEBUFFER_H
+
+#include "confdefs.h"
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include <spatialindex/SpatialIndex.h>
+
+/** Holds up to capacity pages of a storage manager in memory, evicting
+    the least recently used page when full (the buffers that come with
+    spatialindex evict a random page). Stores and deletes are passed
+    straight through to the storage manager.
+*/
+class LRUPageBuffer : public SpatialIndex::StorageManager::IBuffer{
+ public:
+  LRUPageBuffer(SpatialIndex::IStorageManager &storageManager, size_t capacity);
+  virtual ~LRUPageBuffer();
+
+  virtual void loadByteArray(const SpatialIndex::id_type page, uint32_t& len, ::byte** data);
+  virtual void storeByteArray(SpatialIndex::id_type& page, const uint32_t len, const ::byte* const data);
+  virtual void deleteByteArray(const SpatialIndex::id_type page);
+
+  virtual uint64_t getHits();
+  virtual void clear();
+
+ private:
+  typedef std::list<SpatialIndex::id_type> Recency;
+  struct Entry{
+    std::vector< ::byte> data;
+    Recency::iterator position;
+  };
+
+  void Forget(SpatialIndex::id_type page);
+
+  SpatialIndex::IStorageManager &storageManager;
+  size_t capacity;
+  uint64_t hits;
+  // Pages from the most to the least recently used.
+  Recency recency;
+  std::map<SpatialIndex::id_type, Entry> pages;
+};
+#endif
@@ -0,0 +1,153 @@
+/*
+ *      Copyright (c) 2006- Imperial College London
+ *      See COPYING file for copying and redistribution conditions.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; version 2 of the License.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      Contact info: gerard.j.gorman@gmail.com/g.gorman@imperial.ac.uk
+ */
+
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MappedStorageManager.h"
+
+using namespace std;
+using namespace SpatialIndex;
+
+MappedStorageManager::MappedStorageManager(string basename) :
+  data_fd(-1), data(NULL), data_length(0), page_size(0){
+  // The page index, in the format written by DiskStorageManager::flush.
+  // Empty pages are never read.
+  string index_name = basename + ".idx";
+  ifstream index_file(index_name.c_str(), ios::in | ios::binary);
+  if(index_file.fail())
+    throw Tools::IllegalArgumentException("MappedStorageManager: cannot read " + index_name);
+
+  id_type next_page, page, id;
+  uint32_t count;
+  index_file.read(reinterpret_cast<char*>(&page_size), sizeof(uint32_t));
+  index_file.read(reinterpret_cast<char*>(&next_page), sizeof(id_type));
+  index_file.read(reinterpret_cast<char*>(&count), sizeof(uint32_t));
+  for(uint32_t i=0;i<count && index_file.good();i++)
+    index_file.read(reinterpret_cast<char*>(&page), sizeof(id_type));
+
+  index_file.read(reinterpret_cast<char*>(&count), sizeof(uint32_t));
+  for(uint32_t i=0;i<count && index_file.good();i++){
+    Entry entry;
+    uint32_t npages;
+    index_file.read(reinterpret_cast<char*>(&id), sizeof(id_type));
+    index_file.read(reinterpret_cast<char*>(&entry.length), sizeof(uint32_t));
+    index_file.read(reinterpret_cast<char*>(&npages), sizeof(uint32_t));
+    for(uint32_t j=0;j<npages && index_file.good();j++){
+      index_file.read(reinterpret_cast<char*>(&page), sizeof(id_type));
+      entry.pages.push_back(page);
+    }
+    if(!page_index.insert(make_pair(id, entry)).second)
+      throw Tools::IllegalStateException("MappedStorageManager: corrupt " + index_name);
+  }
+  if(index_file.fail())
+    throw Tools::IllegalStateException("MappedStorageManager: corrupt " + index_name);
+
+  // Map the data file. The destructor does not run if the constructor
+  // throws, so release the file first.
+  string data_name = basename + ".dat";
+  data_fd = open(data_name.c_str(), O_RDONLY);
+  if(data_fd<0)
+    throw Tools::IllegalArgumentException("MappedStorageManager: cannot read " + data_name);
+
+  struct stat stats;
+  if(fstat(data_fd, &stats)!=0){
+    Release();
+    throw Tools::IllegalStateException("MappedStorageManager: cannot stat " + data_name);
+  }
+  data_length = stats.st_size;
+  if(data_length<(size_t)next_page*page_size){
+    Release();
+    throw Tools::IllegalStateException("MappedStorageManager: corrupt " + data_name);
+  }
+
+  if(data_length>0){
+    void *addr = mmap(NULL, data_length, PROT_READ, MAP_SHARED, data_fd, 0);
+    if(addr==MAP_FAILED){
+      Release();
+      throw Tools::IllegalStateException("MappedStorageManager: cannot map " + data_name);
+    }
+    data = static_cast< ::byte*>(addr);
+  }
+}
+
+MappedStorageManager::~MappedStorageManager(){
+  Release();
+}
+
+void MappedStorageManager::Release(){
+  if(data!=NULL)
+    munmap(data, data_length);
+  data = NULL;
+  if(data_fd>=0)
+    close(data_fd);
+  data_fd = -1;
+}
+
+const MappedStorageManager::Entry &MappedStorageManager::FindEntry(id_type page) const{
+  map<id_type, Entry>::const_iterator it = page_index.find(page);
+  if(it==page_index.end())
+    throw InvalidPageException(page);
+  return it->second;
+}
+
+void MappedStorageManager::loadByteArray(const id_type page, uint32_t& len, ::byte** out){
+  const Entry &entry = FindEntry(page);
+
+  // Check the pages are mapped and hold the whole entry before copying
+  // any of it.
+  uint32_t remaining = entry.length;
+  for(size_t i=0;i<entry.pages.size() && remaining>0;i++){
+    uint32_t n = min(remaining, page_size);
+    if((size_t)entry.pages[i]*page_size + n>data_length)
+      throw Tools::IllegalStateException("MappedStorageManager: corrupt data file");
+    remaining -= n;
+  }
+  if(remaining>0)
+    throw Tools::IllegalStateException("MappedStorageManager: corrupt page index");
+
+  len = entry.length;
+  *out = new ::byte[len];
+  remaining = len;
+  for(size_t i=0;i<entry.pages.size() && remaining>0;i++){
+    uint32_t n = min(remaining, page_size);
+    memcpy(*out + (len - remaining), data + (size_t)entry.pages[i]*page_size, n);
+    remaining -= n;
+  }
+}
+
+void MappedStorageManager::storeByteArray(id_type& page, const uint32_t len, const ::byte* const bytes){
+  if(page!=StorageManager::NewPage && FindEntry(page).length==len){
+    ::byte *stored;
+    uint32_t stored_length;
+    loadByteArray(page, stored_length, &stored);
+    bool same = memcmp(stored, bytes, len)==0;
+    delete [] stored;
+    if(same)
+      return;
+  }
+
+  throw Tools::IllegalStateException("MappedStorageManager: the storage manager is read-only");
+}
+
+void MappedStorageManager::deleteByteArray(const id_type page){
+  throw Tools::IllegalStateException("MappedStorageManager: the storage manager is read-only");
+}
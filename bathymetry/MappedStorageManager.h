@@ -0,0 +1,63 @@
+/*
+ *      Copyright (c) 2006- Imperial College London
+ *      See COPYING file for copying and redistribution conditions.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; version 2 of the License.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      Contact info: gerard.j.gorman@gmail.com/g.gorman@imperial.ac.uk
+ */
+
+#ifndef MAPPEDSTORAGEMANAGER_H
+#define MAPPEDSTORAGEMANAGER_H
+
+#include "confdefs.h"
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <spatialindex/SpatialIndex.h>
+
+/** Read-only view of the .idx and .dat files written by a spatialindex
+    DiskStorageManager. The page index is read into memory and the data
+    file is memory mapped, so pages are read by the operating system on
+    demand and the mapped pages are shared by all the processes on a
+    node that open the same files. Only the public IStorageManager
+    interface is used, so any libspatialindex will do.
+*/
+class MappedStorageManager : public SpatialIndex::IStorageManager{
+ public:
+  MappedStorageManager(std::string basename);
+  virtual ~MappedStorageManager();
+
+  virtual void loadByteArray(const SpatialIndex::id_type page, uint32_t& len, ::byte** data);
+
+  /// Only stores of a page with its current contents are allowed, as
+  /// indices store their header when they are destroyed.
+  virtual void storeByteArray(SpatialIndex::id_type& page, const uint32_t len, const ::byte* const data);
+  virtual void deleteByteArray(const SpatialIndex::id_type page);
+
+ private:
+  struct Entry{
+    uint32_t length;
+    std::vector<SpatialIndex::id_type> pages;
+  };
+
+  const Entry &FindEntry(SpatialIndex::id_type page) const;
+  void Release();
+
+  int data_fd;
+  ::byte *data;
+  size_t data_length;
+  uint32_t page_size;
+  std::map<SpatialIndex::id_type, Entry> page_index;
+};
+#endif
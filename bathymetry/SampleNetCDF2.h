@@ -40,6 +40,10 @@ class SampleNetCDF2{
   
   double GetValue(double, double) const;
 
+  /// Sample n points at once. Longitudes outside the range of a
+  /// global grid wrap around; other points are clamped to the grid.
+  void GetValues(int n, const double *longitude, const double *latitude, double *values) const;
+
   bool HasPoint(double, double) const;
 
   void SetFile(std::string);
@@ -50,6 +54,7 @@ class SampleNetCDF2{
  private:
   void Debug(char *) const;
   double GetValue(int, int) const;
+  void SetCache();
 
   bool is_constant;
   
@@ -61,5 +66,11 @@ class SampleNetCDF2{
   
   std::vector<double> data;
   bool verbose;
+
+  // The data with an extra column and row, so that every cell has
+  // four corners, and the number of columns spanning 360 degrees if
+  // the grid is global (otherwise 0).
+  std::vector<double> cache;
+  int wrap;
 };
 #endif
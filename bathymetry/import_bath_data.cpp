@@ -31,8 +31,10 @@ USA
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <vector>
 #include <math.h>
 
+#include "BathymetryIndex.h"
 #include "SampleNetCDF2.h"
 #include "confdefs.h"
 
@@ -59,70 +61,72 @@ extern "C" {
 
 }
 
-void set_from_map_fc(const char* filename, const double *X, const double *Y, const double *Z, double *depth, int *n, double *surf_h){
+// Files ending in .idx are tiled indices written by
+// create_bathymetry_index, which are sampled out-of-core.
+bool is_bathymetry_index(const string &file){
+  return file.size()>4 && file.compare(file.size()-4, 4, ".idx")==0;
+}
 
-        string file=string(filename);
-        SampleNetCDF2 map(file);
-
-        const int ncolumns = *n;
-        double *x = new double[ncolumns];
-        double *y = new double[ncolumns];
-        double *z = new double[ncolumns];
-        const double sh = *surf_h;
-        double height[ncolumns];
+template<class Map>
+void get_values(Map &map, int n, const double *x, const double *y, double *values){
+        for (int i = 0; i < n; i++)
+          values[i]=map.GetValue(x[i], y[i]);
+}
+
+void get_values(SampleNetCDF2 &map, int n, const double *x, const double *y, double *values){
+        map.GetValues(n, x, y, values);
+}
+
+template<class Map>
+void sample_sphere(Map &map, const string &file, const double *X, const double *Y, const double *Z, double *depth, int ncolumns, double sh){
+        vector<double> longitude(ncolumns), latitude(ncolumns), height(ncolumns);
+        for (int i = 0; i < ncolumns; i++)
+          get_ll(X[i], Y[i], Z[i], longitude[i], latitude[i]);
+        if(ncolumns>0)
+          get_values(map, ncolumns, &longitude[0], &latitude[0], &height[0]);
         for (int i = 0; i < ncolumns; i++) {
-          x[i] = X[i];
-          y[i] = Y[i];
-          z[i] = Z[i];
-          double longitude, latitude;
-          get_ll(x[i], y[i], z[i], longitude, latitude);
-          if(map.HasPoint(longitude, latitude)){
-                height[i]=map.GetValue(longitude, latitude);
-          }else{
-                cerr << "Point [" << x[i] << ", " << y[i] << ", " << z[i] << "] with longitude and latitude [" << longitude << ", " << latitude <<  "] not found in netCDF file, " << file << ".\n";
+          if(!map.HasPoint(longitude[i], latitude[i])){
+                cerr << "Point [" << X[i] << ", " << Y[i] << ", " << Z[i] << "] with longitude and latitude [" << longitude[i] << ", " << latitude[i] <<  "] not found in bathymetry file, " << file << ".\n";
                 height[i]=0.0;
           }
-        }
-
-        delete [] x;
-        delete [] y;
-        delete [] z;
-
-        for (int i=0; i<ncolumns; i++) {
-
           depth[i]=sh-height[i];
-
         }
 }
 
-void set_from_map_beta_fc(const char* filename, const double *X, const double *Y, double *depth, int *n, double *surf_h){
-
-        string file=string(filename);
-        SampleNetCDF2 map(file);
-
-        const int ncolumns = *n;
-        const double sh = *surf_h;
-        double *x = new double[ncolumns];
-        double *y = new double[ncolumns];
-        double height[ncolumns];
+template<class Map>
+void sample_plane(Map &map, const string &file, const double *X, const double *Y, double *depth, int ncolumns, double sh){
+        vector<double> height(ncolumns);
+        if(ncolumns>0)
+          get_values(map, ncolumns, X, Y, &height[0]);
         for (int i = 0; i < ncolumns; i++) {
-          x[i] = X[i];
-          y[i] = Y[i];
-          if(map.HasPoint(x[i], y[i])){
-                height[i]=map.GetValue(x[i], y[i]);
-          }else{
-                cerr << "Point [" << x[i] << ", " << y[i] << "] not found in netCDF file, " << file << ".\n";
+          if(!map.HasPoint(X[i], Y[i])){
+                cerr << "Point [" << X[i] << ", " << Y[i] << "] not found in bathymetry file, " << file << ".\n";
                 height[i]=0.0;
           }
+          depth[i]=sh-height[i];
         }
+}
 
-        delete [] x;
-        delete [] y;
+void set_from_map_fc(const char* filename, const double *X, const double *Y, const double *Z, double *depth, int *n, double *surf_h){
 
-        for (int i=0; i<ncolumns; i++) {
+        string file=string(filename);
+        if(is_bathymetry_index(file)){
+          BathymetryIndex map(file.substr(0, file.size()-4));
+          sample_sphere(map, file, X, Y, Z, depth, *n, *surf_h);
+        }else{
+          SampleNetCDF2 map(file);
+          sample_sphere(map, file, X, Y, Z, depth, *n, *surf_h);
+        }
+}
 
-          depth[i]=sh-height[i];
+void set_from_map_beta_fc(const char* filename, const double *X, const double *Y, double *depth, int *n, double *surf_h){
 
+        string file=string(filename);
+        if(is_bathymetry_index(file)){
+          BathymetryIndex map(file.substr(0, file.size()-4));
+          sample_plane(map, file, X, Y, depth, *n, *surf_h);
+        }else{
+          SampleNetCDF2 map(file);
+          sample_plane(map, file, X, Y, depth, *n, *surf_h);
         }
 }
-
@@ -50,20 +50,12 @@ void get_field_values_fc(const char* filename, const double *X, const double *Y,
         SampleNetCDF2 map(file);
 
         const int nodes = *n;
-        double *x = new double[nodes];
-        double *y = new double[nodes];
+        map.GetValues(nodes, X, Y, Z);
         for (int i = 0; i < nodes; i++) {
-          x[i] = X[i];
-          y[i] = Y[i];
-          if(map.HasPoint(x[i], y[i])){
-                Z[i]=map.GetValue(x[i], y[i]);
-          }else{
-                cerr << "Point [" << x[i] << ", " << y[i] << "] not found in netCDF file, " << file << ".\n";
+          if(!map.HasPoint(X[i], Y[i])){
+                cerr << "Point [" << X[i] << ", " << Y[i] << "] not found in netCDF file, " << file << ".\n";
                 Z[i]=0.0;
           }
         }
 
-        delete [] x;
-        delete [] y;
-
 }
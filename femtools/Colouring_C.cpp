@@ -0,0 +1,201 @@
+/*  Copyright (C) 2006 Imperial College London and others.
+
+    Please see the AUTHORS file in the main source directory for a full list
+    of copyright holders.
+
+    Prof. C Pain
+    Applied Modelling and Computation Group
+    Department of Earth Science and Engineering
+    Imperial College London
+
+    amcgsoftware@imperial.ac.uk
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation,
+    version 2.1 of the License.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+    USA
+*/
+
+#include "confdefs.h"
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+  // Spread the low 21 bits of x so that there are two zero bits between
+  // each of them
+  uint64_t SpreadBits(uint64_t x)
+  {
+    x &= 0x1fffff;
+    x = (x | (x << 32)) & 0x1f00000000ffffULL;
+    x = (x | (x << 16)) & 0x1f0000ff0000ffULL;
+    x = (x | (x << 8)) & 0x100f00f00f00f00fULL;
+    x = (x | (x << 4)) & 0x10c30c30c30c30c3ULL;
+    x = (x | (x << 2)) & 0x1249249249249249ULL;
+    return x;
+  }
+
+  // Morton (Z-order) keys of npoints points (dim x npoints, Fortran
+  // order) in their bounding box. Points that are close in space mostly
+  // have close keys.
+  void MortonKeys(int dim, int npoints, const double* points, vector<uint64_t>& keys)
+  {
+    double lower[3], upper[3];
+    for(int i = 0;i < dim;i++){
+      lower[i] = points[i];
+      upper[i] = points[i];
+    }
+    for(int p = 1;p < npoints;p++){
+      for(int i = 0;i < dim;i++){
+        lower[i] = min(lower[i], points[p * dim + i]);
+        upper[i] = max(upper[i], points[p * dim + i]);
+      }
+    }
+
+    const double cells = (double) 0x1fffff;
+    keys.resize(npoints);
+    for(int p = 0;p < npoints;p++){
+      uint64_t key = 0;
+      for(int i = 0;i < dim;i++){
+        double width = upper[i] - lower[i];
+        uint64_t cell = width > 0.0 ? (uint64_t) ((points[p * dim + i] - lower[i]) / width * cells) : 0;
+        key |= SpreadBits(cell) << i;
+      }
+      keys[p] = key;
+    }
+  }
+
+  class KeyLess
+  {
+    public:
+      KeyLess(const vector<uint64_t>& keys) : keys(keys)
+      {
+      }
+
+      bool operator()(int a, int b) const
+      {
+        return keys[a] < keys[b];
+      }
+
+    private:
+      const vector<uint64_t>& keys;
+  };
+}
+
+extern "C"
+{
+#define cColourGraph F77_FUNC(ccolour_graph, CCOLOUR_GRAPH)
+  // Colour the n vertices of the graph with adjacency (rowStart, columns)
+  // (CSR, 1-based, possibly including the diagonal) so that no two
+  // adjacent vertices share a colour.
+  //
+  // If dim > 0, centroids (dim x n) are positions of the vertices: the
+  // vertices are coloured, and ordered within each colour, along a
+  // space-filling curve through them, so that a contiguous range of a
+  // colour covers a compact region. Otherwise the natural order is used.
+  // Colours are greedily balanced towards n / ncolours vertices each.
+  //
+  // On return colour holds the (1-based) colour of each vertex, and the
+  // vertices of colour c are vertices(colourStart(c):colourStart(c + 1) - 1).
+  // colourStart must have space for n + 1 entries.
+  void cColourGraph(const int* n, const int* rowStart, const int* columns,
+                    const int* dim, const double* centroids,
+                    int* ncolours, int* colour, int* colourStart, int* vertices)
+  {
+    const int nvertices = *n;
+    *ncolours = 0;
+    colourStart[0] = 1;
+    if(nvertices == 0){
+      return;
+    }
+
+    vector<int> order(nvertices);
+    for(int v = 0;v < nvertices;v++){
+      order[v] = v;
+    }
+    if(*dim > 0){
+      vector<uint64_t> keys;
+      MortonKeys(*dim, nvertices, centroids, keys);
+      stable_sort(order.begin(), order.end(), KeyLess(keys));
+    }
+
+    // Greedy colouring in curve order. Neighbour colours are marked with
+    // the vertex being coloured, so the marks never need clearing.
+    vector<int> mark, size;
+    for(int v = 0;v < nvertices;v++){
+      colour[v] = 0;
+    }
+    for(int i = 0;i < nvertices;i++){
+      const int v = order[i];
+      for(int j = rowStart[v] - 1;j < rowStart[v + 1] - 1;j++){
+        const int c = colour[columns[j] - 1];
+        if(c > 0 && columns[j] - 1 != v){
+          mark[c - 1] = v;
+        }
+      }
+      int c = 0;
+      while(c < *ncolours && mark[c] == v){
+        c++;
+      }
+      if(c == *ncolours){
+        mark.push_back(-1);
+        size.push_back(0);
+        (*ncolours)++;
+      }
+      colour[v] = c + 1;
+      size[c]++;
+    }
+
+    // Move vertices out of over-full colours into the smallest colour
+    // none of their neighbours has, if that is under-full
+    const int target = (nvertices + *ncolours - 1) / *ncolours;
+    fill(mark.begin(), mark.end(), -1);
+    for(int i = 0;i < nvertices;i++){
+      const int v = order[i];
+      const int c = colour[v] - 1;
+      if(size[c] <= target){
+        continue;
+      }
+      for(int j = rowStart[v] - 1;j < rowStart[v + 1] - 1;j++){
+        if(columns[j] - 1 != v){
+          mark[colour[columns[j] - 1] - 1] = v;
+        }
+      }
+      int best = -1;
+      for(int d = 0;d < *ncolours;d++){
+        if(d != c && mark[d] != v && size[d] < target && (best < 0 || size[d] < size[best])){
+          best = d;
+        }
+      }
+      if(best >= 0){
+        size[c]--;
+        size[best]++;
+        colour[v] = best + 1;
+      }
+    }
+
+    // Colour to vertex map, keeping curve order within each colour
+    for(int c = 0;c < *ncolours;c++){
+      colourStart[c + 1] = colourStart[c] + size[c];
+    }
+    vector<int> next(colourStart, colourStart + *ncolours);
+    for(int i = 0;i < nvertices;i++){
+      const int v = order[i];
+      vertices[next[colour[v] - 1]++ - 1] = v + 1;
+    }
+  }
+}
@@ -1,6 +1,7 @@
 #include "Judy.h"
 #include "confdefs.h"
 #include "stdio.h"
+#include "stdlib.h"
 #include "assert.h"
 
 /* To understand these, read
@@ -149,3 +150,202 @@ void integer_hash_table_fetch_pair_c(Pvoid_t* i, int* idx, int* key, int* val)
   *val = *pvalue;
   *i = ptr;
 }
+
+/* Bulk versions of the above, so that building or querying a large set or
+   table is one call from Fortran rather than one per entry. */
+
+static int compare_words(const void* a, const void* b)
+{
+  Word_t wa = *(const Word_t*) a, wb = *(const Word_t*) b;
+  return (wa > wb) - (wa < wb);
+}
+
+/* Sort n words and remove duplicates, returning the new count */
+static int sort_unique_words(Word_t* words, int n)
+{
+  int i, m = 0;
+  qsort(words, n, sizeof(Word_t), compare_words);
+  for (i = 0; i < n; i++)
+  {
+    if (m == 0 || words[i] != words[m - 1])
+    {
+      words[m++] = words[i];
+    }
+  }
+  return m;
+}
+
+void integer_set_insert_multiple_c(Pvoid_t* i, int* n, int* v, int* c)
+{
+  int j, changed, count = 0;
+  Pvoid_t ptr = (Pvoid_t) *i;
+
+  if (ptr == NULL && *n > 1)
+  {
+    /* Build an empty set in one go from the sorted values */
+    Word_t* words = (Word_t*) malloc(*n * sizeof(Word_t));
+    assert(words != NULL);
+    for (j = 0; j < *n; j++)
+    {
+      words[j] = v[j];
+    }
+    count = sort_unique_words(words, *n);
+    changed = Judy1SetArray(&ptr, count, words, PJE0);
+    assert(changed == 1);
+    free(words);
+  }
+  else
+  {
+    for (j = 0; j < *n; j++)
+    {
+      Word_t index = v[j];
+      J1S(changed, ptr, index);
+      count += changed;
+    }
+  }
+  *c = count;
+  *i = ptr;
+}
+
+void integer_set_has_value_multiple_c(Pvoid_t* i, int* n, int* v, int* present)
+{
+  int j, wpresent;
+  Pvoid_t ptr = (Pvoid_t) *i;
+  for (j = 0; j < *n; j++)
+  {
+    Word_t value = v[j];
+    J1T(wpresent, ptr, value);
+    present[j] = wpresent;
+  }
+}
+
+void integer_set_fetch_all_c(Pvoid_t* i, int* v)
+{
+  Word_t index = 0;
+  int found, j = 0;
+  Pvoid_t ptr = (Pvoid_t) *i;
+  J1F(found, ptr, index);
+  while (found)
+  {
+    v[j++] = index;
+    J1N(found, ptr, index);
+  }
+}
+
+typedef struct
+{
+  Word_t key;
+  Word_t value;
+  int order;
+} key_value_pair;
+
+static int compare_pairs(const void* a, const void* b)
+{
+  const key_value_pair* pa = (const key_value_pair*) a;
+  const key_value_pair* pb = (const key_value_pair*) b;
+  if (pa->key != pb->key)
+  {
+    return (pa->key > pb->key) - (pa->key < pb->key);
+  }
+  return (pa->order > pb->order) - (pa->order < pb->order);
+}
+
+void integer_hash_table_insert_multiple_c(Pvoid_t* i, int* n, int* k, int* v)
+{
+  int j, m, worked;
+  PWord_t pvalue;
+  Pvoid_t ptr = (Pvoid_t) *i;
+
+  if (ptr == NULL && *n > 1)
+  {
+    /* Build an empty table in one go from the keys sorted, keeping the
+       last value inserted for a repeated key as the insert above does */
+    key_value_pair* pairs = (key_value_pair*) malloc(*n * sizeof(key_value_pair));
+    Word_t* keys = (Word_t*) malloc(*n * sizeof(Word_t));
+    Word_t* values = (Word_t*) malloc(*n * sizeof(Word_t));
+    assert(pairs != NULL && keys != NULL && values != NULL);
+    for (j = 0; j < *n; j++)
+    {
+      pairs[j].key = k[j];
+      pairs[j].value = v[j];
+      pairs[j].order = j;
+    }
+    qsort(pairs, *n, sizeof(key_value_pair), compare_pairs);
+    m = 0;
+    for (j = 0; j < *n; j++)
+    {
+      if (m > 0 && pairs[j].key == keys[m - 1])
+      {
+        values[m - 1] = pairs[j].value;
+      }
+      else
+      {
+        keys[m] = pairs[j].key;
+        values[m] = pairs[j].value;
+        m++;
+      }
+    }
+    worked = JudyLInsArray(&ptr, m, keys, values, PJE0);
+    assert(worked == 1);
+    free(pairs);
+    free(keys);
+    free(values);
+  }
+  else
+  {
+    for (j = 0; j < *n; j++)
+    {
+      Word_t key = k[j];
+      JLI(pvalue, ptr, key);
+      *pvalue = v[j];
+    }
+  }
+  *i = ptr;
+}
+
+void integer_hash_table_fetch_multiple_c(Pvoid_t* i, int* n, int* k, int* v)
+{
+  int j;
+  PWord_t pvalue;
+  Pvoid_t ptr = (Pvoid_t) *i;
+  for (j = 0; j < *n; j++)
+  {
+    Word_t key = k[j];
+    JLG(pvalue, ptr, key);
+    if (pvalue == NULL)
+    {
+      fprintf(stderr, "Error: hash table has no key %d\n", k[j]);
+      assert(pvalue != NULL);
+    }
+    v[j] = *pvalue;
+  }
+}
+
+void integer_hash_table_has_key_multiple_c(Pvoid_t* i, int* n, int* k, int* present)
+{
+  int j;
+  PWord_t pvalue;
+  Pvoid_t ptr = (Pvoid_t) *i;
+  for (j = 0; j < *n; j++)
+  {
+    Word_t key = k[j];
+    JLG(pvalue, ptr, key);
+    present[j] = (pvalue != NULL);
+  }
+}
+
+void integer_hash_table_fetch_all_c(Pvoid_t* i, int* k, int* v)
+{
+  Word_t key = 0;
+  PWord_t pvalue;
+  int j = 0;
+  Pvoid_t ptr = (Pvoid_t) *i;
+  JLF(pvalue, ptr, key);
+  while (pvalue != NULL)
+  {
+    k[j] = key;
+    v[j] = *pvalue;
+    j++;
+    JLN(pvalue, ptr, key);
+  }
+}
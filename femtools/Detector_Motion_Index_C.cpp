@@ -0,0 +1,164 @@
+/*  Copyright (C) 2006 Imperial College London and others.
+    
+    Please see the AUTHORS file in the main source directory for a full list
+    of copyright holders.
+
+    Prof. C Pain
+    Applied Modelling and Computation Group
+    Department of Earth Science and Engineering
+    Imperial College London
+
+    amcgsoftware@imperial.ac.uk
+    
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation,
+    version 2.1 of the License.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+    USA
+*/
+
+#include "Detector_Motion_Index.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace SpatialIndex;
+
+using namespace std;
+
+using namespace Fluidity;
+
+DetectorMotionIndex::DetectorMotionIndex(const int& dim, const double& horizon)
+{
+  // The TPR-tree needs at least two dimensions
+  assert(dim > 1);
+  assert(horizon > 0.0);
+
+  this->dim = dim;
+  this->horizon = horizon;
+
+  storageManager = StorageManager::createNewMemoryStorageManager();
+  storage = StorageManager::createNewRandomEvictionsBuffer(*storageManager, capacity, writeThrough);
+  id_type id;
+  // Queries must end strictly before the tree horizon
+  tprTree = TPRTree::createNewTPRTree(*storage, fillFactor, indexCapacity, leafCapacity, dim, TPRTree::TPRV_RSTAR, 2.0 * horizon, id);
+
+  return;
+}
+
+DetectorMotionIndex::~DetectorMotionIndex()
+{
+  delete tprTree;
+  delete storage;
+  delete storageManager;
+
+  return;
+}
+
+void DetectorMotionIndex::SetInput(const double* positions, const double* vlow, const double* vhigh, const int& npoints)
+{
+  assert(npoints >= 0);
+
+  for(int i = 0;i < npoints;i++)
+  {
+    // Points are inserted at time zero, and valid from then on
+    MovingRegion point(positions + i * dim, positions + i * dim, vlow + i * dim, vhigh + i * dim, 0.0, horizon, dim);
+    tprTree->insertData(0, NULL, point, i + 1);
+  }
+
+  return;
+}
+
+void DetectorMotionIndex::Query(const double* low, const double* high, const double& tStart, const double& tEnd)
+{
+  assert(low);
+  assert(high);
+  assert(tStart >= 0.0);
+  assert(tStart <= tEnd);
+  assert(tEnd <= horizon);
+
+  visitor.clear();
+
+  vector<double> zero(dim, 0.0);
+  MovingRegion box(low, high, &zero[0], &zero[0], tStart, tEnd, dim);
+  tprTree->intersectsWithQuery(box, visitor);
+
+  return;
+}
+
+void DetectorMotionIndex::QueryOutput(int& npoints) const
+{
+  npoints = visitor.size();
+
+  return;
+}
+
+void DetectorMotionIndex::GetOutput(int* ids) const
+{
+  copy(visitor.begin(), visitor.end(), ids);
+
+  return;
+}
+
+map<int, DetectorMotionIndex*> detectorMotionIndex;
+
+extern "C" {
+  void cDetectorMotionIndexSetInput(int* id, const int* dim, const double* horizon, const double* positions, const double* vlow, const double* vhigh, const int* npoints)
+  {
+    assert(*dim > 1);
+    assert(*npoints >= 0);
+
+    *id = 1;
+    while(detectorMotionIndex.count(*id) > 0)
+    {
+      (*id)++;
+    }
+
+    detectorMotionIndex[*id] = new DetectorMotionIndex(*dim, *horizon);
+
+    detectorMotionIndex[*id]->SetInput(positions, vlow, vhigh, *npoints);
+
+    return;
+  }
+
+  void cDetectorMotionIndexReset(const int* id)
+  {
+    if(detectorMotionIndex.count(*id) > 0)
+    {
+      delete detectorMotionIndex[*id];
+      detectorMotionIndex.erase(*id);
+    }
+
+    return;
+  }
+
+  void cDetectorMotionIndexQuery(const int* id, const double* low, const double* high, const double* tStart, const double* tEnd, int* npoints)
+  {
+    assert(detectorMotionIndex.count(*id) > 0);
+    assert(detectorMotionIndex[*id]);
+
+    detectorMotionIndex[*id]->Query(low, high, *tStart, *tEnd);
+    detectorMotionIndex[*id]->QueryOutput(*npoints);
+
+    return;
+  }
+
+  void cDetectorMotionIndexGetOutput(const int* id, int* ids)
+  {
+    assert(detectorMotionIndex.count(*id) > 0);
+    assert(detectorMotionIndex[*id]);
+
+    detectorMotionIndex[*id]->GetOutput(ids);
+
+    return;
+  }
+}
@@ -289,11 +289,18 @@ void ElementIntersectionFinder::SetInput(const double*& positions, const int& nn
 }
 
 void ElementIntersectionFinder::SetTestElement(const double*& positions, const int& dim, const int& loc)
+{
+  Find(positions, dim, loc, visitor);
+  
+  return;
+}
+
+void ElementIntersectionFinder::Find(const double* positions, const int& dim, const int& loc, ElementListVisitor& found) const
 {
   assert(positions);
   assert(dim == this->dim);
   
-  visitor.clear();
+  found.clear();
   
   double high[dim], low[dim];
   for(int i = 0;i < dim;i++)
@@ -316,10 +323,9 @@ void ElementIntersectionFinder::SetTestElement(const double*& positions, const i
     }
   }
   
-  SpatialIndex::Region* region = new SpatialIndex::Region(low, high, dim);
-  rTree->intersectsWithQuery(*region, visitor);
-  
-  delete region;
+  // spatialindex serialises queries on the same tree
+  SpatialIndex::Region region(low, high, dim);
+  rTree->intersectsWithQuery(region, found);
   
   return;
 }
@@ -370,27 +376,14 @@ void ElementIntersectionFinder::Free()
 
 ElementIntersector::ElementIntersector()
 {
-  positionsA = NULL;
-  positionsB = NULL;
-  
   loc = 0;
+  dim = 0;
 
   return;
 }
 
 ElementIntersector::~ElementIntersector()
 {
-  if(this->positionsA)
-  {
-    free(this->positionsA);
-    this->positionsA = NULL;
-  }
-  if(this->positionsB)
-  {
-    free(this->positionsB);
-    this->positionsB = NULL;
-  }
-
   return;
 }
 
@@ -407,29 +400,12 @@ void ElementIntersector::SetInput(double*& positionsA, double*& positionsB, cons
   this->dim = dim;
   this->loc = loc;
 
-  assert(dim >= 0);
-  assert(loc >= 0);
+  assert(dim >= 0 && dim <= 3);
+  assert(loc >= 0 && loc <= maxIntersectorLoc);
   
-  if(this->positionsA)
-  {
-    free(this->positionsA);
-    this->positionsA = NULL;
-  }
-  this->positionsA = (double*)malloc(loc * dim * sizeof(double));
-  assert(this->positionsA);
   memcpy(this->positionsA, positionsA, loc * dim * sizeof(double));
-  
-  if(this->positionsB)
-  {
-    free(this->positionsB);
-    this->positionsB = NULL;
-  }
-  this->positionsB = (double*)malloc(loc * dim * sizeof(double));
-  assert(positionsB);
   memcpy(this->positionsB, positionsB, loc * dim * sizeof(double));
   
-  this->loc = loc;
-  
   return;
 }
 
@@ -732,6 +708,7 @@ void ElementIntersector1D::GetOutput(double*& positions, int*& enlist) const{
 
 ElementIntersector2D::ElementIntersector2D()
 {
+  nvertices = 0;
   intersection = NULL;
   exactness = 0;
   
@@ -761,39 +738,7 @@ void ElementIntersector2D::Intersect()
 
   if (loc == 3)
   {
-    GEOM_REAL vec[2];
-    for (int i = 0; i < 2; i++)
-      vec[i] = (GEOM_REAL) positionsA[0 + i];
-    Vector2 pointA1(vec);
-
-    for (int i = 0; i < 2; i++)
-      vec[i] = (GEOM_REAL) positionsA[2 + i];
-    Vector2 pointA2(vec);
-
-    for (int i = 0; i < 2; i++)
-      vec[i] = (GEOM_REAL) positionsA[4 + i];
-    Vector2 pointA3(vec);
-
-    Wm4::Triangle2<GEOM_REAL> triA = Triangle2(pointA1, pointA2, pointA3);
-    triA.Orient();
-
-    for (int i = 0; i < 2; i++)
-      vec[i] = (GEOM_REAL) positionsB[0 + i];
-    Vector2 pointB1(vec);
-
-    for (int i = 0; i < 2; i++)
-      vec[i] = (GEOM_REAL) positionsB[2 + i];
-    Vector2 pointB2(vec);
-
-    for (int i = 0; i < 2; i++)
-      vec[i] = (GEOM_REAL) positionsB[4 + i];
-    Vector2 pointB3(vec);
-
-    Wm4::Triangle2<GEOM_REAL> triB = Triangle2(pointB1, pointB2, pointB3);
-    triB.Orient();
-
-    intersection = new Wm4::IntrTriangle2Triangle2<GEOM_REAL>(triA, triB);
-    intersection->Find();
+    nvertices = ClipTriangles(positionsA, positionsB, polygon);
   }
   else if (loc == 4)
   {
@@ -838,8 +783,15 @@ void ElementIntersector2D::Intersect()
 
 void ElementIntersector2D::QueryOutput(int& nnodes, int& nelms) const
 {
-  assert(intersection);
-  nnodes = intersection->GetQuantity();
+  if (loc == 3)
+  {
+    nnodes = nvertices;
+  }
+  else
+  {
+    assert(intersection);
+    nnodes = intersection->GetQuantity();
+  }
   if (nnodes > 2)
     nelms = nnodes - 2;
   else
@@ -850,17 +802,30 @@ void ElementIntersector2D::QueryOutput(int& nnodes, int& nelms) const
 
 void ElementIntersector2D::GetOutput(double*& positions, int*& enlist) const
 {
-  assert(intersection);
- 
-  int nnodes = intersection->GetQuantity(); 
-  for (int node = 0; node < nnodes; node++)
+  int nnodes;
+  if (loc == 3)
   {
-    Vector2 V = intersection->GetPoint(node);
-    positions[node] = V[0];
-    positions[node + nnodes] = V[1];
+    nnodes = nvertices;
+    for (int node = 0; node < nnodes; node++)
+    {
+      positions[node] = polygon[2 * node];
+      positions[node + nnodes] = polygon[2 * node + 1];
+    }
+  }
+  else
+  {
+    assert(intersection);
+ 
+    nnodes = intersection->GetQuantity(); 
+    for (int node = 0; node < nnodes; node++)
+    {
+      Vector2 V = intersection->GetPoint(node);
+      positions[node] = V[0];
+      positions[node + nnodes] = V[1];
+    }
   }
   
-  for (int ele = 0; ele < intersection->GetQuantity() - 2; ele++)
+  for (int ele = 0; ele < nnodes - 2; ele++)
   {
     enlist[ele * 3] = 1;
     enlist[ele * 3 + 1] = ele + 2;
@@ -912,6 +877,23 @@ void WmElementIntersector3D::Intersect()
     volumes = NULL;
   }
 
+  if(BoundingBoxesOverlap(3, 4, positionsA, positionsB))
+  {
+    ClipPlane planesB[4];
+    TetrahedronPlanes(positionsB, planesB);
+    elements = ClipTetrahedra(positionsA, planesB, tets, work);
+  }
+  else
+  {
+    elements = 0;
+  }
+  if(elements >= 0)
+  {
+    nodes = elements * loc;
+    return;
+  }
+
+  // The clipping buffers overflowed, so fall back to Wm4
   Vector3 cur_vector;
 
   // The reason we don't pass in positionsA[0], positionsA[3], etc.
@@ -1005,19 +987,31 @@ void WmElementIntersector3D::QueryOutput(int& nnodes, int& nelms) const
 
 void WmElementIntersector3D::GetOutput(double*& positions, int*& enlist) const
 {
-  assert(intersection);
-  assert(volumes);
   assert(elements >= 0);
   assert(nodes >= 0);
 
-  vector<Tetrahedron3> vec;
-  vec = intersection->GetIntersection();
-
   for (size_t enlist_index = 0; enlist_index < (size_t) loc * elements; enlist_index++)
   {
     enlist[enlist_index] = enlist_index + 1;
   }
 
+  if (!intersection)
+  {
+    for (int node = 0; node < nodes; node++)
+    {
+      positions[node] = tets[3 * node];
+      positions[node + nodes] = tets[3 * node + 1];
+      positions[node + 2 * nodes] = tets[3 * node + 2];
+    }
+    
+    return;
+  }
+
+  assert(volumes);
+
+  vector<Tetrahedron3> vec;
+  vec = intersection->GetIntersection();
+
   size_t pos_index = 0;
   size_t vector_idx;
   Vector3 cur_vector;
@@ -1039,6 +1033,164 @@ void WmElementIntersector3D::GetOutput(double*& positions, int*& enlist) const
   return;
 }
 
+ElementIntersector* Fluidity::NewElementIntersector(const int& dim, const int& exact)
+{
+  switch(dim)
+  {
+    case 1:
+      if(exact == 0)
+      {
+        return new ElementIntersector1D();
+      }
+      cerr << "Exact intersector not available in 1D" << endl;
+      exit(-1);
+    case 2:
+      if(exact == 0)
+      {
+        return new ElementIntersector2D();
+      }
+      return new ElementIntersectorCGAL2D();
+    case 3:
+      if(exact == 0)
+      {
+        return new WmElementIntersector3D();
+      }
+      return new ElementIntersectorCGAL3D();
+    default:
+      cerr << "Invalid element intersector dimension" << endl;
+      exit(-1);
+  }
+}
+
+namespace
+{
+  // Copy the node positions of one element, node-major
+  inline void GatherElement(const double* positions, const int* nodes, const int& loc, const int& dim, double* element)
+  {
+    for(int i = 0;i < loc;i++)
+    {
+      memcpy(element + i * dim, positions + (nodes[i] - 1) * dim, dim * sizeof(double));
+    }
+  }
+}
+
+void Fluidity::SupermeshElements(const int& dim, const int& exact,
+                                 const double* positionsA, const int* enlistA, const int& locA,
+                                 const double* positionsB, const int* enlistB, const int& locB, const int& nelementsB,
+                                 const int* mapStarts, const int* map,
+                                 SupermeshOutput& output)
+{
+  assert(dim >= 1 && dim <= 3);
+  assert(locA == locB);
+  assert(locA <= maxIntersectorLoc);
+
+  if(dim < 1 || dim > 3)
+  {
+    cerr << "Invalid element intersector dimension" << endl;
+    exit(-1);
+  }
+
+  // Elements of B are handed out to threads in blocks. Each block is
+  // supermeshed into its own piece, and the pieces joined in block order.
+  const int blockSize = 64;
+  const int nblocks = (nelementsB + blockSize - 1) / blockSize;
+  vector<SupermeshOutput> pieces(nblocks);
+  
+#pragma omp parallel if(exact == 0)
+  {
+    ElementIntersector* intersector = NewElementIntersector(dim, exact);
+    double elementA[3 * maxIntersectorLoc], elementB[3 * maxIntersectorLoc];
+    double* inputA = elementA;
+    double* inputB = elementB;
+    vector<double> positionsC;
+    vector<int> enlistC;
+
+#pragma omp for schedule(dynamic)
+    for(int block = 0;block < nblocks;block++)
+    {
+      SupermeshOutput& piece = pieces[block];
+      int end = min(nelementsB, (block + 1) * blockSize);
+      for(int eleB = block * blockSize;eleB < end;eleB++)
+      {
+        GatherElement(positionsB, enlistB + eleB * locB, locB, dim, elementB);
+        for(int i = mapStarts[eleB] - 1;i < mapStarts[eleB + 1] - 1;i++)
+        {
+          int eleA = map[i] - 1;
+          GatherElement(positionsA, enlistA + eleA * locA, locA, dim, elementA);
+
+          intersector->SetInput(inputA, inputB, dim, locA);
+          intersector->Intersect();
+          int nnodes, nelms;
+          intersector->QueryOutput(nnodes, nelms);
+          if(nelms <= 0)
+          {
+            continue;
+          }
+
+          positionsC.resize(nnodes * dim);
+          enlistC.resize(nelms * (dim + 1));
+          double* outputPositions = &positionsC[0];
+          int* outputEnlist = &enlistC[0];
+          intersector->GetOutput(outputPositions, outputEnlist);
+
+          // GetOutput gives positions component by component
+          int offset = piece.positions.size() / dim;
+          for(int node = 0;node < nnodes;node++)
+          {
+            for(int j = 0;j < dim;j++)
+            {
+              piece.positions.push_back(positionsC[node + j * nnodes]);
+            }
+          }
+          for(int ele = 0;ele < nelms;ele++)
+          {
+            for(int j = 0;j < dim + 1;j++)
+            {
+              piece.enlist.push_back(enlistC[ele * (dim + 1) + j] + offset);
+            }
+            piece.parentsA.push_back(eleA + 1);
+            piece.parentsB.push_back(eleB + 1);
+          }
+        }
+      }
+    }
+    
+    delete intersector;
+  }
+
+  size_t npositions = 0, nelements = 0;
+  for(int block = 0;block < nblocks;block++)
+  {
+    npositions += pieces[block].positions.size();
+    nelements += pieces[block].parentsA.size();
+  }
+  output.positions.clear();
+  output.enlist.clear();
+  output.parentsA.clear();
+  output.parentsB.clear();
+  output.positions.reserve(npositions);
+  output.enlist.reserve(nelements * (dim + 1));
+  output.parentsA.reserve(nelements);
+  output.parentsB.reserve(nelements);
+  for(int block = 0;block < nblocks;block++)
+  {
+    SupermeshOutput& piece = pieces[block];
+    int offset = output.positions.size() / dim;
+    output.positions.insert(output.positions.end(), piece.positions.begin(), piece.positions.end());
+    for(size_t i = 0;i < piece.enlist.size();i++)
+    {
+      output.enlist.push_back(piece.enlist[i] + offset);
+    }
+    output.parentsA.insert(output.parentsA.end(), piece.parentsA.begin(), piece.parentsA.end());
+    output.parentsB.insert(output.parentsB.end(), piece.parentsB.begin(), piece.parentsB.end());
+    
+    // Release each piece as soon as it has been copied
+    piece = SupermeshOutput();
+  }
+  
+  return;
+}
+
 ElementIntersector* elementIntersector = NULL;
 
 ElementIntersectionFinder elementIntersectionFinder;
@@ -1065,27 +1217,7 @@ extern "C"
       elementIntersector = NULL;
     }
     
-    ElementIntersector1D* intersector_1;
-    ElementIntersector2D* intersector_2;
-    WmElementIntersector3D* intersector_3;
-    switch(*dim)
-    {
-      case 1:
-        intersector_1 = new ElementIntersector1D();
-        elementIntersector = (ElementIntersector*)intersector_1;
-        break;
-      case 2:
-        intersector_2 = new ElementIntersector2D();
-        elementIntersector = (ElementIntersector*)intersector_2;
-        break;
-      case 3:
-        intersector_3 = new WmElementIntersector3D();
-        elementIntersector = (ElementIntersector*)intersector_3;
-        break;
-      default:
-        cerr << "Invalid element intersector dimension" << endl;
-        exit(-1);
-    }
+    elementIntersector = NewElementIntersector(*dim, 0);
     
     return;
   }
@@ -1109,53 +1241,7 @@ extern "C"
       delete elementIntersector;
     }
     
-    ElementIntersector1D* intersector_1_inexact;
-    ElementIntersector2D* intersector_2_inexact;
-    ElementIntersectorCGAL2D* intersector_2_exact;
-    ElementIntersector3D* intersector_3_inexact;
-    ElementIntersectorCGAL3D* intersector_3_exact;
-
-    switch(dim)
-    {
-      case 1:
-        if (*exact == 0)
-        {
-          intersector_1_inexact = new ElementIntersector1D();
-          elementIntersector = (ElementIntersector*)intersector_1_inexact;
-        }
-        else{
-          cerr << "Exact intersector not available in 1D" << endl;
-          exit(-1);
-        }
-        break;
-      case 2:
-        if (*exact == 0)
-        {
-          intersector_2_inexact = new ElementIntersector2D();
-          elementIntersector = (ElementIntersector*)intersector_2_inexact;
-        }
-        else
-        {
-          intersector_2_exact = new ElementIntersectorCGAL2D();
-          elementIntersector = (ElementIntersector*)intersector_2_exact;
-        }
-        break;
-      case 3:
-        if (*exact == 0)
-        {
-          intersector_3_inexact = new WmElementIntersector3D();
-          elementIntersector = (ElementIntersector*)intersector_3_inexact;
-        }
-        else
-        {
-          intersector_3_exact = new ElementIntersectorCGAL3D();
-          elementIntersector = (ElementIntersector*)intersector_3_exact;
-        }
-        break;
-      default:
-        cerr << "Invalid element intersector dimension" << endl;
-        exit(-1);
-    }
+    elementIntersector = NewElementIntersector(dim, *exact);
     
     return;
   }
@@ -1223,6 +1309,102 @@ extern "C"
     return;
   }
 
+  void cIntersectorCreate(void** handle, const int* dim, const int* exact)
+  {
+    *handle = NewElementIntersector(*dim, *exact);
+    
+    return;
+  }
+
+  void cIntersectorDestroy(void** handle)
+  {
+    delete (ElementIntersector*)*handle;
+    *handle = NULL;
+    
+    return;
+  }
+
+  void cIntersectorHandleSetInput(void** handle, double* positionsA, double* positionsB, const int* dim, const int* loc)
+  {
+    assert(*handle);
+    assert(*dim >= 0);
+    assert(*loc >= 0);
+    
+    ((ElementIntersector*)*handle)->SetInput(positionsA, positionsB, *dim, *loc);
+    
+    return;
+  }
+
+  void cIntersectorHandleDrive(void** handle)
+  {
+    assert(*handle);
+    
+    ((ElementIntersector*)*handle)->Intersect();
+    
+    return;
+  }
+
+  void cIntersectorHandleQuery(void** handle, int* nnodes, int* nelms)
+  {
+    assert(*handle);
+    
+    ((ElementIntersector*)*handle)->QueryOutput(*nnodes, *nelms);
+    
+    return;
+  }
+
+  void cIntersectorHandleGetOutput(void** handle, const int* nnodes, const int* nelms, const int* dim, const int* loc, double* positions, int* enlist)
+  {
+    assert(*handle);
+#ifdef DDEBUG
+    int nnodesQuery, nelmsQuery;
+    ((ElementIntersector*)*handle)->QueryOutput(nnodesQuery, nelmsQuery);
+    assert(*nnodes == nnodesQuery);
+    assert(*nelms == nelmsQuery);
+    assert(*dim == (int) ((ElementIntersector*)*handle)->GetDim());
+#endif
+    
+    ((ElementIntersector*)*handle)->GetOutput(positions, enlist);
+    
+    return;
+  }
+
+  void cSupermeshElements(const int* dim, const int* exact,
+                          const double* positionsA, const int* enlistA, const int* locA,
+                          const double* positionsB, const int* enlistB, const int* locB, const int* nelementsB,
+                          const int* mapStarts, const int* map,
+                          void** handle, int* nnodes, int* nelms)
+  {
+    SupermeshOutput* output = new SupermeshOutput();
+    SupermeshElements(*dim, *exact, positionsA, enlistA, *locA, positionsB, enlistB, *locB, *nelementsB,
+                      mapStarts, map, *output);
+    
+    *handle = output;
+    *nnodes = output->positions.size() / *dim;
+    *nelms = output->parentsA.size();
+    
+    return;
+  }
+
+  void cSupermeshElementsGetOutput(void** handle, double* positions, int* enlist, int* parentsA, int* parentsB)
+  {
+    assert(*handle);
+    
+    SupermeshOutput* output = (SupermeshOutput*)*handle;
+    if(!output->positions.empty())
+    {
+      memcpy(positions, &output->positions[0], output->positions.size() * sizeof(double));
+      memcpy(enlist, &output->enlist[0], output->enlist.size() * sizeof(int));
+      memcpy(parentsA, &output->parentsA[0], output->parentsA.size() * sizeof(int));
+      memcpy(parentsB, &output->parentsB[0], output->parentsB.size() * sizeof(int));
+    }
+    
+    delete output;
+    *handle = NULL;
+    
+    return;
+  }
+
   void cIntersectionFinderReset(int* ntests)
   {
     *ntests = elementIntersectionFinder.Reset();
@@ -1265,4 +1447,61 @@ extern "C"
     
     return;
   }
+
+  void cIntersectionFinderCreate(void** handle)
+  {
+    *handle = new ElementIntersectionFinder();
+    
+    return;
+  }
+
+  void cIntersectionFinderDestroy(void** handle)
+  {
+    delete (ElementIntersectionFinder*)*handle;
+    *handle = NULL;
+    
+    return;
+  }
+
+  void cIntersectionFinderHandleSetInput(void** handle, const double* positions, const int* enlist, const int* dim, const int* loc, const int* nnodes, const int* nelements)
+  {
+    assert(*handle);
+    assert(*dim >= 0);
+    assert(*loc >= 0);
+    assert(*nnodes >= 0);
+    assert(*nelements >= 0);
+    
+    ((ElementIntersectionFinder*)*handle)->SetInput(positions, *nnodes, *dim, enlist, *nelements, *loc);
+    
+    return;
+  }
+
+  void cIntersectionFinderHandleFind(void** handle, const double* positions, const int* dim, const int* loc)
+  {
+    assert(*handle);
+    assert(*dim >= 0);
+    assert(*loc >= 0);
+    
+    ((ElementIntersectionFinder*)*handle)->SetTestElement(positions, *dim, *loc);
+    
+    return;
+  }
+
+  void cIntersectionFinderHandleQueryOutput(void** handle, int* nelms)
+  {
+    assert(*handle);
+    
+    ((ElementIntersectionFinder*)*handle)->QueryOutput(*nelms);
+    
+    return;
+  }
+
+  void cIntersectionFinderHandleGetOutput(void** handle, int* id, const int* index)
+  {
+    assert(*handle);
+    
+    ((ElementIntersectionFinder*)*handle)->GetOutput(*id, *index);
+    
+    return;
+  }
 }
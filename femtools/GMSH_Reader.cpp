@@ -0,0 +1,727 @@
+/*  Copyright (C) 2006 Imperial College London and others.
+    
+    Please see the AUTHORS file in the main source directory for a full list
+    of copyright holders.
+
+    Prof. C Pain
+    Applied Modelling and Computation Group
+    Department of Earth Science and Engineering
+    Imperial College London
+
+    amcgsoftware@imperial.ac.uk
+    
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation,
+    version 2.1 of the License.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+    USA
+*/
+
+#include "GMSH_Reader.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+using namespace Fluidity;
+
+namespace{
+  // Sections smaller than this are parsed by a single thread
+  const size_t minChunkBytes = 1 << 20;
+
+  // Read the line starting at pos, without its line ending, and advance pos
+  // to the start of the next line
+  bool NextLine(const char* data, size_t size, size_t& pos, string& line){
+    if(pos >= size){
+      return false;
+    }
+    const char* end = (const char*)memchr(data + pos, '\n', size - pos);
+    size_t lineEnd = end ? end - data : size;
+    line.assign(data + pos, lineEnd - pos);
+    if(!line.empty() and line[line.size() - 1] == '\r'){
+      line.erase(line.size() - 1);
+    }
+    pos = end ? lineEnd + 1 : size;
+    return true;
+  }
+
+  // Position of the first line starting with tag at or after pos, or size
+  size_t FindTag(const char* data, size_t size, size_t pos, const char* tag){
+    const size_t len = strlen(tag);
+    while(pos < size){
+      const char* p = (const char*)memchr(data + pos, tag[0], size - pos);
+      if(!p){
+        return size;
+      }
+      pos = p - data;
+      if(size - pos >= len and memcmp(p, tag, len) == 0 and (pos == 0 or data[pos - 1] == '\n')){
+        return pos;
+      }
+      pos++;
+    }
+    return size;
+  }
+
+  // Next line (after one at pos) must be the tag
+  bool ExpectTag(const char* data, size_t size, size_t& pos, const char* tag){
+    string line;
+    while(NextLine(data, size, pos, line)){
+      if(line.find_first_not_of(" \t") != string::npos){
+        return line.compare(0, strlen(tag), tag) == 0;
+      }
+    }
+    return false;
+  }
+
+  int NumberOfChunks(size_t bytes){
+#ifdef _OPENMP
+    return max(1, min(omp_get_max_threads(), (int)(bytes / minChunkBytes)));
+#else
+    return 1;
+#endif
+  }
+
+  // Parses whitespace separated integers and reals from a line
+  class LineParser{
+    public:
+      LineParser(const char* data, const char* end) : p(data), end(end){}
+
+      bool Int(int& value){
+        char* q;
+        value = (int)strtol(p, &q, 10);
+        if(q == p or q > end){
+          return false;
+        }
+        p = q;
+        return true;
+      }
+
+      bool Real(double& value){
+        char* q;
+        value = strtod(p, &q);
+        if(q == p or q > end){
+          return false;
+        }
+        p = q;
+        return true;
+      }
+
+    private:
+      const char* p;
+      const char* end;
+  };
+
+  bool BlankLine(const char* p, const char* end){
+    for(;p < end;p++){
+      if(*p != ' ' and *p != '\t' and *p != '\r'){
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template<class T>
+  void Append(vector<T>& to, const vector<T>& from){
+    to.insert(to.end(), from.begin(), from.end());
+  }
+
+  // Parse the lines in [begin, end) with parseLine(line, lineEnd, output),
+  // in parallel chunks that are then concatenated in order with
+  // appendChunk(output, chunk)
+  template<class Output, class ParseLine, class AppendChunk>
+  bool ParseLines(const char* data, size_t begin, size_t end, Output& output, ParseLine parseLine, AppendChunk appendChunk){
+    const int nchunks = NumberOfChunks(end - begin);
+    vector<Output> chunks(nchunks);
+    vector<size_t> bounds(nchunks + 1);
+    bounds[0] = begin;
+    bounds[nchunks] = end;
+    for(int i = 1;i < nchunks;i++){
+      size_t pos = begin + ((end - begin) * i) / nchunks;
+      const char* p = (const char*)memchr(data + pos - 1, '\n', end - pos + 1);
+      bounds[i] = p ? min((size_t)(p - data) + 1, end) : end;
+    }
+
+    bool ok = true;
+#pragma omp parallel for schedule(static, 1) reduction(&&:ok)
+    for(int i = 0;i < nchunks;i++){
+      size_t pos = bounds[i];
+      while(ok and pos < bounds[i + 1]){
+        const char* lineEnd = (const char*)memchr(data + pos, '\n', bounds[i + 1] - pos);
+        if(!lineEnd){
+          lineEnd = data + bounds[i + 1];
+        }
+        if(!BlankLine(data + pos, lineEnd)){
+          ok = parseLine(data + pos, lineEnd, chunks[i]);
+        }
+        pos = lineEnd - data + 1;
+      }
+    }
+    if(!ok){
+      return false;
+    }
+
+    for(int i = 0;i < nchunks;i++){
+      appendChunk(output, chunks[i]);
+    }
+    return true;
+  }
+
+  struct ParseNode{
+    bool operator()(const char* p, const char* end, GMSHNodes& nodes) const{
+      LineParser parser(p, end);
+      int id;
+      double x[3];
+      if(!(parser.Int(id) and parser.Real(x[0]) and parser.Real(x[1]) and parser.Real(x[2]))){
+        return false;
+      }
+      nodes.ids.push_back(id);
+      nodes.x.insert(nodes.x.end(), x, x + 3);
+      return true;
+    }
+  };
+
+  struct AppendNodes{
+    void operator()(GMSHNodes& nodes, const GMSHNodes& chunk) const{
+      Append(nodes.ids, chunk.ids);
+      Append(nodes.x, chunk.x);
+    }
+  };
+
+  struct ParseElement{
+    bool operator()(const char* p, const char* end, GMSHElements& elements) const{
+      LineParser parser(p, end);
+      int id, type, ntags;
+      if(!(parser.Int(id) and parser.Int(type) and parser.Int(ntags)) or ntags < 0){
+        return false;
+      }
+      const int nloc = GMSHElementNodeCount(type);
+      if(nloc < 0){
+        return false;
+      }
+      elements.ids.push_back(id);
+      elements.types.push_back(type);
+      for(int i = 0;i < ntags + nloc;i++){
+        int value;
+        if(!parser.Int(value)){
+          return false;
+        }
+        (i < ntags ? elements.tags : elements.nodes).push_back(value);
+      }
+      elements.tag_starts.push_back(elements.tags.size());
+      elements.node_starts.push_back(elements.nodes.size());
+      return true;
+    }
+  };
+
+  struct AppendElements{
+    void operator()(GMSHElements& elements, const GMSHElements& chunk) const{
+      const int tagOffset = elements.tags.size(), nodeOffset = elements.nodes.size();
+      Append(elements.ids, chunk.ids);
+      Append(elements.types, chunk.types);
+      Append(elements.tags, chunk.tags);
+      Append(elements.nodes, chunk.nodes);
+      for(size_t i = 0;i < chunk.types.size();i++){
+        elements.tag_starts.push_back(chunk.tag_starts[i] + tagOffset);
+        elements.node_starts.push_back(chunk.node_starts[i] + nodeOffset);
+      }
+    }
+  };
+
+  struct ParseColumn{
+    bool operator()(const char* p, const char* end, vector<int>& columns) const{
+      LineParser parser(p, end);
+      int id;
+      double value;
+      if(!(parser.Int(id) and parser.Real(value))){
+        return false;
+      }
+      columns.push_back((int)floor(value));
+      return true;
+    }
+  };
+
+  struct AppendColumns{
+    void operator()(vector<int>& columns, const vector<int>& chunk) const{
+      Append(columns, chunk);
+    }
+  };
+}
+
+int Fluidity::GMSHElementNodeCount(int type){
+  switch(type){
+    case 1:
+      return 2;  // Line
+    case 2:
+      return 3;  // Triangle
+    case 3:
+      return 4;  // Quadrilateral
+    case 4:
+      return 4;  // Tetrahedron
+    case 5:
+      return 8;  // Hexahedron
+    case 15:
+      return 1;  // Point
+    default:
+      return -1;
+  }
+}
+
+GMSHReader::GMSHReader() : data(NULL), size(0), mapped(false){
+}
+
+GMSHReader::~GMSHReader(){
+  Close();
+}
+
+void GMSHReader::Close(){
+  if(mapped){
+    munmap((void*)data, size);
+  }
+  data = NULL;
+  size = 0;
+  mapped = false;
+  buffer.clear();
+  blocks.clear();
+}
+
+GMSHReadError GMSHReader::Open(const string& filename){
+  Close();
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if(fd < 0){
+    return GMSH_READ_FILE_NOT_FOUND;
+  }
+  struct stat fileStat;
+  if(fstat(fd, &fileStat) != 0 or fileStat.st_size == 0){
+    close(fd);
+    return GMSH_READ_FILE_INVALID;
+  }
+  size = fileStat.st_size;
+
+  void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(map != MAP_FAILED){
+    data = (const char*)map;
+    mapped = true;
+#ifdef MADV_SEQUENTIAL
+    madvise(map, size, MADV_SEQUENTIAL);
+#endif
+  }else{
+    // Fall back to a single read
+    buffer.resize(size);
+    if(pread(fd, &buffer[0], size, 0) != (ssize_t)size){
+      close(fd);
+      Close();
+      return GMSH_READ_FILE_INVALID;
+    }
+    data = &buffer[0];
+  }
+  close(fd);
+
+  GMSHReadError ret = Locate();
+  if(ret != GMSH_READ_SUCCESS){
+    Close();
+  }
+  return ret;
+}
+
+GMSHReadError GMSHReader::Locate(){
+  nnodes = -1;
+  nelements = -1;
+  ncolumns = -1;
+  ncolumn_components = 0;
+
+  size_t pos = 0;
+  string line;
+  if(!ExpectTag(data, size, pos, "$MeshFormat") or !NextLine(data, size, pos, line)){
+    return GMSH_READ_FILE_INVALID;
+  }
+  double version;
+  int fileType, dataSize;
+  if(sscanf(line.c_str(), "%lf %d %d", &version, &fileType, &dataSize) != 3){
+    return GMSH_READ_FILE_INVALID;
+  }
+  if(version < 2.0 or version >= 3.0){
+    return GMSH_READ_UNSUPPORTED_VERSION;
+  }
+  if(dataSize != sizeof(double)){
+    return GMSH_READ_FILE_INVALID;
+  }
+  format = fileType == 1 ? GMSH_FORMAT_BINARY : GMSH_FORMAT_ASCII;
+  if(format == GMSH_FORMAT_BINARY){
+    // The integer 1, in binary, to check the byte order
+    int one;
+    if(size - pos < sizeof(int) + 1){
+      return GMSH_READ_FILE_INVALID;
+    }
+    memcpy(&one, data + pos, sizeof(int));
+    if(one != 1){
+      return GMSH_READ_FILE_INVALID;
+    }
+    pos += sizeof(int) + 1;
+  }
+  if(!ExpectTag(data, size, pos, "$EndMeshFormat")){
+    return GMSH_READ_FILE_INVALID;
+  }
+
+  while(NextLine(data, size, pos, line)){
+    if(line == "$Nodes"){
+      if(!NextLine(data, size, pos, line) or sscanf(line.c_str(), "%d", &nnodes) != 1 or nnodes < 0){
+        return GMSH_READ_FILE_INVALID;
+      }
+      nodes_begin = pos;
+      if(format == GMSH_FORMAT_BINARY){
+        const size_t recordSize = sizeof(int) + 3 * sizeof(double);
+        if((size - pos) / recordSize < (size_t)nnodes){
+          return GMSH_READ_FILE_INVALID;
+        }
+        nodes_end = pos + nnodes * recordSize;
+        pos = nodes_end;
+      }else{
+        nodes_end = FindTag(data, size, pos, "$EndNodes");
+        pos = nodes_end;
+      }
+      if(!ExpectTag(data, size, pos, "$EndNodes")){
+        return GMSH_READ_FILE_INVALID;
+      }
+    }else if(line == "$Elements"){
+      if(!NextLine(data, size, pos, line) or sscanf(line.c_str(), "%d", &nelements) != 1 or nelements < 0){
+        return GMSH_READ_FILE_INVALID;
+      }
+      elements_begin = pos;
+      if(format == GMSH_FORMAT_BINARY){
+        // Elements come in blocks of one type, each with a header of the
+        // type, number of elements and number of tags
+        int first = 0;
+        while(first < nelements){
+          ElementBlock block;
+          int header[3];
+          if(size - pos < sizeof(header)){
+            return GMSH_READ_FILE_INVALID;
+          }
+          memcpy(header, data + pos, sizeof(header));
+          pos += sizeof(header);
+          block.type = header[0];
+          block.count = header[1];
+          block.ntags = header[2];
+          block.first = first;
+          block.begin = pos;
+          const int nloc = GMSHElementNodeCount(block.type);
+          if(nloc < 0){
+            return GMSH_READ_UNSUPPORTED_ELEMENT;
+          }
+          if(block.count <= 0 or block.ntags < 0 or block.count > nelements - first){
+            return GMSH_READ_FILE_INVALID;
+          }
+          const size_t recordSize = (1 + block.ntags + nloc) * sizeof(int);
+          if((size - pos) / recordSize < (size_t)block.count){
+            return GMSH_READ_FILE_INVALID;
+          }
+          pos += block.count * recordSize;
+          first += block.count;
+          blocks.push_back(block);
+        }
+        elements_end = pos;
+      }else{
+        elements_end = FindTag(data, size, pos, "$EndElements");
+        pos = elements_end;
+      }
+      if(!ExpectTag(data, size, pos, "$EndElements")){
+        return GMSH_READ_FILE_INVALID;
+      }
+    }else if(line == "$NodeData"){
+      GMSHReadError ret = LocateNodeData(pos);
+      if(ret != GMSH_READ_SUCCESS){
+        return ret;
+      }
+    }else if(line.size() > 1 and line[0] == '$'){
+      // Skip any other section
+      pos = FindTag(data, size, pos, ("$End" + line.substr(1)).c_str());
+      if(!NextLine(data, size, pos, line)){
+        return GMSH_READ_FILE_INVALID;
+      }
+    }
+  }
+
+  if(nnodes < 0 or nelements < 0){
+    return GMSH_READ_FILE_INVALID;
+  }
+  return GMSH_READ_SUCCESS;
+}
+
+GMSHReadError GMSHReader::LocateNodeData(size_t& pos){
+  // Header of string tags (the field name), real tags (the time) and
+  // integer tags (the time step, number of components and number of nodes)
+  string line, name;
+  int ntags;
+  vector<int> intTags;
+  for(int kind = 0;kind < 3;kind++){
+    if(!NextLine(data, size, pos, line) or sscanf(line.c_str(), "%d", &ntags) != 1 or ntags < 0){
+      return GMSH_READ_FILE_INVALID;
+    }
+    for(int i = 0;i < ntags;i++){
+      if(!NextLine(data, size, pos, line)){
+        return GMSH_READ_FILE_INVALID;
+      }
+      if(kind == 0 and i == 0){
+        size_t first = line.find_first_not_of(" \t\"");
+        size_t last = line.find_last_not_of(" \t\"");
+        name = first == string::npos ? "" : line.substr(first, last - first + 1);
+      }else if(kind == 2){
+        intTags.push_back(atoi(line.c_str()));
+      }
+    }
+  }
+  if(intTags.size() < 3){
+    return GMSH_READ_FILE_INVALID;
+  }
+
+  size_t begin = pos, end;
+  if(format == GMSH_FORMAT_BINARY){
+    const size_t recordSize = sizeof(int) + max(intTags[1], 1) * sizeof(double);
+    if(intTags[2] < 0 or (size - pos) / recordSize < (size_t)intTags[2]){
+      return GMSH_READ_FILE_INVALID;
+    }
+    end = pos + intTags[2] * recordSize;
+  }else{
+    end = FindTag(data, size, pos, "$EndNodeData");
+  }
+  pos = end;
+  if(!ExpectTag(data, size, pos, "$EndNodeData")){
+    return GMSH_READ_FILE_INVALID;
+  }
+
+  if(name == "column_ids" and ncolumns < 0){
+    ncolumns = intTags[2];
+    ncolumn_components = max(intTags[1], 1);
+    columns_begin = begin;
+    columns_end = end;
+  }
+  return GMSH_READ_SUCCESS;
+}
+
+GMSHFormat GMSHReader::Format() const{
+  return format;
+}
+
+int GMSHReader::NodeCount() const{
+  return nnodes;
+}
+
+int GMSHReader::ElementCount() const{
+  return nelements;
+}
+
+bool GMSHReader::HasColumnIDs() const{
+  return ncolumns >= 0;
+}
+
+GMSHReadError GMSHReader::ReadNodes(GMSHNodes& nodes) const{
+  assert(data);
+  nodes.ids.clear();
+  nodes.x.clear();
+
+  if(format == GMSH_FORMAT_BINARY){
+    nodes.ids.resize(nnodes);
+    nodes.x.resize(3 * nnodes);
+    const size_t recordSize = sizeof(int) + 3 * sizeof(double);
+#pragma omp parallel for schedule(static) if(nnodes * recordSize > minChunkBytes)
+    for(int i = 0;i < nnodes;i++){
+      const char* record = data + nodes_begin + i * recordSize;
+      memcpy(&nodes.ids[i], record, sizeof(int));
+      memcpy(&nodes.x[3 * i], record + sizeof(int), 3 * sizeof(double));
+    }
+  }else{
+    if(!ParseLines(data, nodes_begin, nodes_end, nodes, ParseNode(), AppendNodes())){
+      return GMSH_READ_FILE_INVALID;
+    }
+    if((int)nodes.ids.size() != nnodes){
+      return GMSH_READ_FILE_INVALID;
+    }
+  }
+
+  return GMSH_READ_SUCCESS;
+}
+
+GMSHReadError GMSHReader::ReadElements(GMSHElements& elements) const{
+  assert(data);
+  elements.ids.clear();
+  elements.types.clear();
+  elements.tags.clear();
+  elements.nodes.clear();
+  elements.tag_starts.assign(1, 0);
+  elements.node_starts.assign(1, 0);
+
+  if(format == GMSH_FORMAT_BINARY){
+    elements.ids.resize(nelements);
+    elements.types.resize(nelements);
+    elements.tag_starts.resize(nelements + 1);
+    elements.node_starts.resize(nelements + 1);
+    for(size_t b = 0;b < blocks.size();b++){
+      const ElementBlock& block = blocks[b];
+      const int nloc = GMSHElementNodeCount(block.type);
+      const size_t recordSize = (1 + block.ntags + nloc) * sizeof(int);
+      const int offset = block.first;
+      const int tagOffset = elements.tags.size(), nodeOffset = elements.nodes.size();
+      const int n = block.count;
+      elements.tags.resize(tagOffset + n * block.ntags);
+      elements.nodes.resize(nodeOffset + n * nloc);
+#pragma omp parallel for schedule(static) if(n * recordSize > minChunkBytes)
+      for(int i = 0;i < n;i++){
+        const char* record = data + block.begin + i * recordSize;
+        memcpy(&elements.ids[offset + i], record, sizeof(int));
+        elements.types[offset + i] = block.type;
+        if(block.ntags > 0){
+          memcpy(&elements.tags[tagOffset + i * block.ntags], record + sizeof(int), block.ntags * sizeof(int));
+        }
+        memcpy(&elements.nodes[nodeOffset + i * nloc], record + (1 + block.ntags) * sizeof(int), nloc * sizeof(int));
+        elements.tag_starts[offset + i + 1] = tagOffset + (i + 1) * block.ntags;
+        elements.node_starts[offset + i + 1] = nodeOffset + (i + 1) * nloc;
+      }
+    }
+  }else{
+    if(!ParseLines(data, elements_begin, elements_end, elements, ParseElement(), AppendElements())){
+      return GMSH_READ_FILE_INVALID;
+    }
+    if((int)elements.types.size() != nelements){
+      return GMSH_READ_FILE_INVALID;
+    }
+  }
+
+  return GMSH_READ_SUCCESS;
+}
+
+GMSHReadError GMSHReader::ReadColumnIDs(vector<int>& columns) const{
+  assert(data);
+  columns.clear();
+  if(ncolumns < 0){
+    return GMSH_READ_SUCCESS;
+  }
+  if(ncolumns != nnodes){
+    return GMSH_READ_COLUMN_COUNT_MISMATCH;
+  }
+
+  if(format == GMSH_FORMAT_BINARY){
+    columns.resize(ncolumns);
+    const size_t recordSize = sizeof(int) + ncolumn_components * sizeof(double);
+#pragma omp parallel for schedule(static) if(ncolumns * recordSize > minChunkBytes)
+    for(int i = 0;i < ncolumns;i++){
+      double value;
+      memcpy(&value, data + columns_begin + i * recordSize + sizeof(int), sizeof(double));
+      columns[i] = (int)floor(value);
+    }
+  }else{
+    if(!ParseLines(data, columns_begin, columns_end, columns, ParseColumn(), AppendColumns())){
+      return GMSH_READ_FILE_INVALID;
+    }
+  }
+  if((int)columns.size() != ncolumns){
+    return GMSH_READ_FILE_INVALID;
+  }
+
+  return GMSH_READ_SUCCESS;
+}
+
+GMSHMeshData* readGMSHData = NULL;
+
+extern "C"{
+  void cGMSHReaderReset(){
+    if(readGMSHData){
+      delete readGMSHData;
+      readGMSHData = NULL;
+    }
+
+    return;
+  }
+
+  int cGMSHReaderSetInput(char* filename, int* filename_len, int* format, int* nnodes, int* nelements,
+    int* ntags, int* nelement_nodes, int* have_columns){
+    cGMSHReaderReset();
+    readGMSHData = new GMSHMeshData();
+
+    GMSHReader reader;
+    GMSHReadError ret = reader.Open(string(filename, *filename_len));
+    if(ret == GMSH_READ_SUCCESS){
+      ret = reader.ReadNodes(readGMSHData->nodes);
+    }
+    if(ret == GMSH_READ_SUCCESS){
+      ret = reader.ReadElements(readGMSHData->elements);
+    }
+    if(ret == GMSH_READ_SUCCESS){
+      ret = reader.ReadColumnIDs(readGMSHData->columns);
+    }
+    if(ret != GMSH_READ_SUCCESS){
+      cGMSHReaderReset();
+      return ret;
+    }
+
+    readGMSHData->format = reader.Format();
+    *format = reader.Format();
+    *nnodes = readGMSHData->nodes.ids.size();
+    *nelements = readGMSHData->elements.types.size();
+    *ntags = readGMSHData->elements.tags.size();
+    *nelement_nodes = readGMSHData->elements.nodes.size();
+    *have_columns = reader.HasColumnIDs() ? 1 : 0;
+
+    return GMSH_READ_SUCCESS;
+  }
+
+  void cGMSHReaderGetOutput(int* nnodes, int* nelements, int* ntags, int* nelement_nodes,
+    int* node_ids, double* x, int* columns, int* types, int* tag_starts, int* tags,
+    int* node_starts, int* element_nodes){
+    assert(readGMSHData);
+    const GMSHNodes& nodes = readGMSHData->nodes;
+    const GMSHElements& elements = readGMSHData->elements;
+    assert(*nnodes == (int)nodes.ids.size());
+    assert(*nelements == (int)elements.types.size());
+    assert(*ntags == (int)elements.tags.size());
+    assert(*nelement_nodes == (int)elements.nodes.size());
+    assert(readGMSHData->columns.empty() or (int)readGMSHData->columns.size() == *nnodes);
+
+    if(*nnodes > 0){
+      memcpy(node_ids, &nodes.ids[0], *nnodes * sizeof(int));
+      memcpy(x, &nodes.x[0], 3 * *nnodes * sizeof(double));
+    }
+    for(int i = 0;i < *nnodes;i++){
+      columns[i] = readGMSHData->columns.empty() ? -1 : readGMSHData->columns[i];
+    }
+    // Starts are numbered from one
+    for(int i = 0;i < *nelements;i++){
+      types[i] = elements.types[i];
+    }
+    for(int i = 0;i <= *nelements;i++){
+      tag_starts[i] = elements.tag_starts[i] + 1;
+      node_starts[i] = elements.node_starts[i] + 1;
+    }
+    if(*ntags > 0){
+      memcpy(tags, &elements.tags[0], *ntags * sizeof(int));
+    }
+    if(*nelement_nodes > 0){
+      memcpy(element_nodes, &elements.nodes[0], *nelement_nodes * sizeof(int));
+    }
+
+    cGMSHReaderReset();
+
+    return;
+  }
+}
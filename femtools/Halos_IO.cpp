@@ -28,151 +28,478 @@
 
 #include "Halos_IO.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace std;
 
 using namespace Fluidity;
 
-HaloReadError Fluidity::ReadHalos(const string& filename, int& process, int& nprocs, map<int, int>& npnodes, map<int, vector<vector<int> > >& send, map<int, vector<vector<int> > >& recv){ 
-  // Read the halo file
-  TiXmlDocument doc(filename);
-  if(!doc.LoadFile()){
-    doc.ErrorDesc();
-    return HALO_READ_FILE_NOT_FOUND;
-  }
-  
-  const char* charBuffer;
-  ostringstream buffer;
-   
-  // Extract the XML header
-  TiXmlNode* header = doc.FirstChild();
-  while(header != NULL and header->Type() != TiXmlNode::DECLARATION){
-    header = header->NextSibling();
-  }
+namespace{
+  // Binary halo files start with this, then int32 values in native byte
+  // order: a byte order mark (1), the format version, the process, the
+  // number of processes and the number of levels. Each level then has its
+  // level, number of private nodes, number of neighbouring processes (n),
+  // number of sends and number of receives, followed by the neighbouring
+  // processes (n), the send starts (n + 1), the receive starts (n + 1), the
+  // sends and the receives.
+  const char binaryHaloMagic[8] = {'F', 'L', 'H', 'A', 'L', 'O', 'B', '\n'};
+  const int binaryHaloVersion = 1;
 
-  // Extract the root node
-  TiXmlNode* rootNode = header->NextSiblingElement();
-  if(rootNode == NULL){
-    return HALO_READ_FILE_INVALID;
-  }
-  TiXmlElement* rootEle = rootNode->ToElement();
-  
-  // Extract process
-  charBuffer = rootEle->Attribute("process");
-  if(charBuffer == NULL){
-    return HALO_READ_FILE_INVALID;
+  HaloFormat haloWriteFormat = HALO_FORMAT_XML;
+
+  // Bounds checked reader over a binary halo file held in memory
+  class BinaryHaloReader{
+    public:
+      BinaryHaloReader(const char* data, size_t size) : data(data), size(size), pos(0){}
+
+      bool Read(int& value){
+        if(size - pos < sizeof(int)){
+          return false;
+        }
+        memcpy(&value, data + pos, sizeof(int));
+        pos += sizeof(int);
+        return true;
+      }
+
+      bool Read(vector<int>& values, int n){
+        if(n < 0 or (size - pos) / sizeof(int) < (size_t)n){
+          return false;
+        }
+        values.resize(n);
+        if(n > 0){
+          memcpy(&values[0], data + pos, n * sizeof(int));
+        }
+        pos += n * sizeof(int);
+        return true;
+      }
+
+    private:
+      const char* data;
+      size_t size, pos;
+  };
+
+  // Check that starts is a valid set of offsets into an array of size n
+  bool ValidStarts(const vector<int>& starts, int n){
+    if(starts.front() != 0 or starts.back() != n){
+      return false;
+    }
+    for(size_t i = 1;i < starts.size();i++){
+      if(starts[i] < starts[i - 1]){
+        return false;
+      }
+    }
+    return true;
   }
-  process = atoi(charBuffer);
-  if(process < 0){
-    return HALO_READ_FILE_INVALID;
+
+  HaloReadError ReadBinaryHalos(const char* data, size_t size, int& process, int& nprocs, map<int, HaloLevel>& halos){
+    BinaryHaloReader reader(data + sizeof(binaryHaloMagic), size - sizeof(binaryHaloMagic));
+
+    int byteOrder, version, nlevels;
+    if(!reader.Read(byteOrder) or byteOrder != 1){
+      cerr << "Binary .halo file written with a different byte order" << endl;
+      return HALO_READ_FILE_INVALID;
+    }
+    if(!reader.Read(version) or version != binaryHaloVersion){
+      return HALO_READ_FILE_INVALID;
+    }
+    if(!reader.Read(process) or !reader.Read(nprocs) or !reader.Read(nlevels)){
+      return HALO_READ_FILE_INVALID;
+    }
+    if(process < 0 or process >= nprocs or nlevels < 0){
+      return HALO_READ_FILE_INVALID;
+    }
+
+    halos.clear();
+    for(int i = 0;i < nlevels;i++){
+      int level, nneighbours, nsends, nreceives;
+      if(!reader.Read(level) or halos.count(level) > 0){
+        return HALO_READ_FILE_INVALID;
+      }
+      HaloLevel& halo = halos[level];
+      if(!reader.Read(halo.npnodes) or !reader.Read(nneighbours) or !reader.Read(nsends) or !reader.Read(nreceives)){
+        return HALO_READ_FILE_INVALID;
+      }
+      if(halo.npnodes < 0 or nneighbours < 0 or nneighbours > nprocs){
+        return HALO_READ_FILE_INVALID;
+      }
+      if(!reader.Read(halo.procs, nneighbours)
+        or !reader.Read(halo.send_starts, nneighbours + 1)
+        or !reader.Read(halo.recv_starts, nneighbours + 1)
+        or !reader.Read(halo.sends, nsends)
+        or !reader.Read(halo.recvs, nreceives)){
+        return HALO_READ_FILE_INVALID;
+      }
+      for(int j = 0;j < nneighbours;j++){
+        if(halo.procs[j] < 0 or halo.procs[j] >= nprocs or (j > 0 and halo.procs[j] <= halo.procs[j - 1])){
+          return HALO_READ_FILE_INVALID;
+        }
+      }
+      if(!ValidStarts(halo.send_starts, nsends) or !ValidStarts(halo.recv_starts, nreceives)){
+        return HALO_READ_FILE_INVALID;
+      }
+    }
+
+    return HALO_READ_SUCCESS;
   }
-  
-  // Extract nprocs
-  charBuffer = rootEle->Attribute("nprocs");
-  if(charBuffer == NULL){
-    return HALO_READ_FILE_INVALID;
+
+  // Append the whitespace separated integers in text to values
+  void ParseIntegers(const char* text, vector<int>& values){
+    char* end;
+    for(long value = strtol(text, &end, 10);end != text;value = strtol(text, &end, 10)){
+      values.push_back((int)value);
+      text = end;
+    }
   }
-  nprocs = atoi(charBuffer);
-  if(process >= nprocs){
-    return HALO_READ_FILE_INVALID;
+
+  // Extract the integer data of the named child of dataEle
+  void ReadHaloDataElement(TiXmlElement* dataEle, const char* name, vector<int>& values){
+    TiXmlNode* dataNode = dataEle->FirstChildElement(name);
+    if(dataNode != NULL){
+      TiXmlNode* dataTextNode = dataNode->FirstChild();
+      while(dataTextNode != NULL and dataTextNode->Type() != TiXmlNode::TEXT){
+        dataTextNode = dataTextNode->NextSibling();
+      }
+      if(dataTextNode != NULL){
+        ParseIntegers(dataTextNode->Value(), values);
+      }
+    }
   }
-  
-  // Extract halo data for each process for each level
-  npnodes.clear();
-  send.clear();
-  recv.clear();
-  // Find the next halo element
-  for(TiXmlNode* haloNode = rootEle->FirstChildElement("halo");haloNode != NULL;haloNode = haloNode->NextSiblingElement("halo")){
-    if(haloNode == NULL){
-      break;
+
+  HaloReadError ReadXMLHalos(const string& filename, int& process, int& nprocs, map<int, HaloLevel>& halos){
+    // Read the halo file
+    TiXmlDocument doc(filename);
+    if(!doc.LoadFile()){
+      doc.ErrorDesc();
+      return HALO_READ_FILE_NOT_FOUND;
     }
-    TiXmlElement* haloEle = haloNode->ToElement();
     
-    // Extract the level
-    charBuffer = haloEle->Attribute("level");
-    if(charBuffer == NULL){
-      // Backwards compatibility
-      charBuffer = haloEle->Attribute("tag");
-      if(charBuffer == NULL){
-        return HALO_READ_FILE_INVALID;
-      }
+    const char* charBuffer;
+     
+    // Extract the XML header
+    TiXmlNode* header = doc.FirstChild();
+    while(header != NULL and header->Type() != TiXmlNode::DECLARATION){
+      header = header->NextSibling();
+    }
+    if(header == NULL){
+      return HALO_READ_FILE_INVALID;
     }
-    int level = atoi(charBuffer);
-    send[level] = vector<vector<int> >(nprocs);
-    recv[level] = vector<vector<int> >(nprocs);
 
-    // Extract n_private_nodes
-    charBuffer = haloEle->Attribute("n_private_nodes");
+    // Extract the root node
+    TiXmlNode* rootNode = header->NextSiblingElement();
+    if(rootNode == NULL){
+      return HALO_READ_FILE_INVALID;
+    }
+    TiXmlElement* rootEle = rootNode->ToElement();
+    
+    // Extract process
+    charBuffer = rootEle->Attribute("process");
     if(charBuffer == NULL){
       return HALO_READ_FILE_INVALID;
     }
-    npnodes[level] = atoi(charBuffer);
-    if(npnodes[level] < 0){
+    process = atoi(charBuffer);
+    if(process < 0){
       return HALO_READ_FILE_INVALID;
     }
     
-    // Find the next halo_data element
-    for(TiXmlNode* dataNode = haloEle->FirstChildElement("halo_data");dataNode != NULL;dataNode = dataNode->NextSiblingElement("halo_data")){
-      if(dataNode == NULL){
-        break;
-      }
-      TiXmlElement* dataEle = dataNode->ToElement();
+    // Extract nprocs
+    charBuffer = rootEle->Attribute("nprocs");
+    if(charBuffer == NULL){
+      return HALO_READ_FILE_INVALID;
+    }
+    nprocs = atoi(charBuffer);
+    if(process >= nprocs){
+      return HALO_READ_FILE_INVALID;
+    }
     
-      // Extract the process
-      charBuffer = dataEle->Attribute("process");
+    // Extract halo data for each neighbouring process for each level
+    halos.clear();
+    // Find the next halo element
+    for(TiXmlNode* haloNode = rootEle->FirstChildElement("halo");haloNode != NULL;haloNode = haloNode->NextSiblingElement("halo")){
+      TiXmlElement* haloEle = haloNode->ToElement();
+      
+      // Extract the level
+      charBuffer = haloEle->Attribute("level");
       if(charBuffer == NULL){
-        return HALO_READ_FILE_INVALID;
+        // Backwards compatibility
+        charBuffer = haloEle->Attribute("tag");
+        if(charBuffer == NULL){
+          return HALO_READ_FILE_INVALID;
+        }
       }
-      int proc = atoi(charBuffer);
-      if(proc < 0 or proc >= nprocs){
+      int level = atoi(charBuffer);
+      HaloLevel& halo = halos[level];
+
+      // Extract n_private_nodes
+      charBuffer = haloEle->Attribute("n_private_nodes");
+      if(charBuffer == NULL){
         return HALO_READ_FILE_INVALID;
       }
-      
-      // Check that data for this level and process has not already been extracted
-      if(send[level][proc].size() > 0 or recv[level][proc].size() > 0){
+      halo.npnodes = atoi(charBuffer);
+      if(halo.npnodes < 0){
         return HALO_READ_FILE_INVALID;
       }
       
-      // Permit empty send and receive data elements
-      send[level][proc] = vector<int>();
-      recv[level][proc] = vector<int>();
+      // Processes need not be listed in order, so gather the data by
+      // process before flattening it
+      map<int, pair<vector<int>, vector<int> > > procData;
+      
+      // Find the next halo_data element
+      for(TiXmlNode* dataNode = haloEle->FirstChildElement("halo_data");dataNode != NULL;dataNode = dataNode->NextSiblingElement("halo_data")){
+        TiXmlElement* dataEle = dataNode->ToElement();
       
-      // Extract the send data
-      TiXmlNode* sendDataNode = dataEle->FirstChildElement("send");
-      if(sendDataNode != NULL){
-        TiXmlNode* sendDataTextNode = sendDataNode->FirstChild();
-        while(sendDataTextNode != NULL and sendDataTextNode->Type() != TiXmlNode::TEXT){
-          sendDataTextNode = sendDataTextNode->NextSibling();
+        // Extract the process
+        charBuffer = dataEle->Attribute("process");
+        if(charBuffer == NULL){
+          return HALO_READ_FILE_INVALID;
         }
-        if(sendDataTextNode != NULL){
-          vector<string> tokens;
-          Tokenize(sendDataTextNode->ValueStr(), tokens, " ");
-          for(size_t i = 0;i < tokens.size();i++){
-            send[level][proc].push_back(atoi(tokens[i].c_str()));
-          }
+        int proc = atoi(charBuffer);
+        if(proc < 0 or proc >= nprocs){
+          return HALO_READ_FILE_INVALID;
+        }
+        
+        // Check that data for this level and process has not already been extracted
+        if(procData.count(proc) > 0){
+          return HALO_READ_FILE_INVALID;
+        }
+        
+        // Permit empty send and receive data elements
+        pair<vector<int>, vector<int> >& data = procData[proc];
+        ReadHaloDataElement(dataEle, "send", data.first);
+        ReadHaloDataElement(dataEle, "receive", data.second);
+      }
+
+      halo.send_starts.push_back(0);
+      halo.recv_starts.push_back(0);
+      for(map<int, pair<vector<int>, vector<int> > >::const_iterator iter = procData.begin();iter != procData.end();iter++){
+        if(iter->second.first.empty() and iter->second.second.empty()){
+          continue;
         }
+        halo.procs.push_back(iter->first);
+        halo.sends.insert(halo.sends.end(), iter->second.first.begin(), iter->second.first.end());
+        halo.recvs.insert(halo.recvs.end(), iter->second.second.begin(), iter->second.second.end());
+        halo.send_starts.push_back(halo.sends.size());
+        halo.recv_starts.push_back(halo.recvs.size());
       }
+    }
+
+    return HALO_READ_SUCCESS;
+  }
+
+  int WriteXMLHalos(const string& filename, const unsigned int& process, const unsigned int& nprocs, const map<int, HaloLevel>& halos){
+    TiXmlDocument doc;
+    
+    ostringstream buffer;
+    
+    // XML header
+    TiXmlDeclaration* header = new TiXmlDeclaration("1.0", "utf-8", "");
+    doc.LinkEndChild(header);
+
+    // Add root node
+    TiXmlElement* rootEle = new TiXmlElement("halos");
+    doc.LinkEndChild(rootEle);
+    
+    // Add process attribute to root node
+    buffer << process;
+    rootEle->SetAttribute("process", buffer.str());
+    buffer.str("");
+    
+    // Add nprocs attribute to root node
+    buffer << nprocs;
+    rootEle->SetAttribute("nprocs", buffer.str());
+    buffer.str("");
+   
+    // Add halo data for each level
+    for(map<int, HaloLevel>::const_iterator levelIter = halos.begin();levelIter != halos.end();levelIter++){
+      const HaloLevel& halo = levelIter->second;
+
+      // Add halo element to root element
+      TiXmlElement* haloEle = new TiXmlElement("halo");
+      rootEle->LinkEndChild(haloEle);
+      
+      // Add level attribute to halo element
+      buffer << levelIter->first;
+      haloEle->SetAttribute("level", buffer.str());
+      buffer.str("");
+      
+      // Add n_private_nodes attribute to halo element
+      buffer << halo.npnodes;
+      haloEle->SetAttribute("n_private_nodes", buffer.str());
+      buffer.str("");
+      
+      // Add halo data for each process for each level. Processes that are
+      // not neighbours get empty data, as readers of old may expect them.
+      size_t k = 0;
+      for(int j = 0;j < (int)nprocs;j++){
+        // Add halo_data element to halo element
+        TiXmlElement* dataEle = new TiXmlElement("halo_data");
+        haloEle->LinkEndChild(dataEle);
       
-      // Extract the receive data
-      TiXmlNode* recvDataNode = dataEle->FirstChildElement("receive");
-      if(recvDataNode != NULL){
-      TiXmlNode* recvDataTextNode = recvDataNode->FirstChild();
-        while(recvDataTextNode != NULL and recvDataTextNode->Type() != TiXmlNode::TEXT){
-          recvDataTextNode = recvDataTextNode->NextSibling();
+        // Add process attribute to data element
+        buffer << j;
+        dataEle->SetAttribute("process", buffer.str());
+        buffer.str("");
+
+        bool neighbour = (k < halo.procs.size() and halo.procs[k] == j);
+
+        // Add send data to data element
+        TiXmlElement* sendDataEle = new TiXmlElement("send");
+        dataEle->LinkEndChild(sendDataEle);
+        if(neighbour){
+          for(int i = halo.send_starts[k];i < halo.send_starts[k + 1];i++){
+            buffer << halo.sends[i] << " ";
+          }
         }
-        if(recvDataTextNode != NULL){
-          vector<string> tokens;
-          Tokenize(recvDataTextNode->ValueStr(), tokens, " ");
-          for(size_t i = 0;i < tokens.size();i++){
-            recv[level][proc].push_back(atoi(tokens[i].c_str()));
+        TiXmlText* sendData = new TiXmlText(buffer.str());
+        sendDataEle->LinkEndChild(sendData);
+        buffer.str("");
+
+        // Add receive data to data element
+        TiXmlElement* recvDataEle = new TiXmlElement("receive");
+        dataEle->LinkEndChild(recvDataEle);
+        if(neighbour){
+          for(int i = halo.recv_starts[k];i < halo.recv_starts[k + 1];i++){
+            buffer << halo.recvs[i] << " ";
           }
+          k++;
         }
+        TiXmlText* recvData = new TiXmlText(buffer.str());
+        recvDataEle->LinkEndChild(recvData);
+        buffer.str("");
       }
     }
+    
+    return doc.SaveFile(filename) ? 0 : -1;
+  }
+
+  int WriteBinaryHalos(const string& filename, const unsigned int& process, const unsigned int& nprocs, const map<int, HaloLevel>& halos){
+    vector<int> data;
+    data.push_back(1);
+    data.push_back(binaryHaloVersion);
+    data.push_back(process);
+    data.push_back(nprocs);
+    data.push_back(halos.size());
+    for(map<int, HaloLevel>::const_iterator levelIter = halos.begin();levelIter != halos.end();levelIter++){
+      const HaloLevel& halo = levelIter->second;
+      data.push_back(levelIter->first);
+      data.push_back(halo.npnodes);
+      data.push_back(halo.procs.size());
+      data.push_back(halo.sends.size());
+      data.push_back(halo.recvs.size());
+      data.insert(data.end(), halo.procs.begin(), halo.procs.end());
+      data.insert(data.end(), halo.send_starts.begin(), halo.send_starts.end());
+      data.insert(data.end(), halo.recv_starts.begin(), halo.recv_starts.end());
+      data.insert(data.end(), halo.sends.begin(), halo.sends.end());
+      data.insert(data.end(), halo.recvs.begin(), halo.recvs.end());
+    }
+
+    FILE* file = fopen(filename.c_str(), "wb");
+    if(file == NULL){
+      return -1;
+    }
+    bool written = fwrite(binaryHaloMagic, sizeof(binaryHaloMagic), 1, file) == 1
+      and fwrite(&data[0], sizeof(int), data.size(), file) == data.size();
+    return (fclose(file) == 0 and written) ? 0 : -1;
+  }
+
+  // Convert from sends and receives for every process
+  void DenseToHaloLevel(int npnodes, const vector<vector<int> >& send, const vector<vector<int> >& recv, unsigned int nprocs, HaloLevel& halo){
+    halo.npnodes = npnodes;
+    halo.procs.clear();
+    halo.sends.clear();
+    halo.recvs.clear();
+    halo.send_starts.assign(1, 0);
+    halo.recv_starts.assign(1, 0);
+    for(size_t i = 0;i < send.size() and i < recv.size() and i < nprocs;i++){
+      if(send[i].empty() and recv[i].empty()){
+        continue;
+      }
+      halo.procs.push_back(i);
+      halo.sends.insert(halo.sends.end(), send[i].begin(), send[i].end());
+      halo.recvs.insert(halo.recvs.end(), recv[i].begin(), recv[i].end());
+      halo.send_starts.push_back(halo.sends.size());
+      halo.recv_starts.push_back(halo.recvs.size());
+    }
+  }
+}
+
+HaloReadError Fluidity::ReadHalos(const string& filename, int& process, int& nprocs, map<int, HaloLevel>& halos){
+  int fd = open(filename.c_str(), O_RDONLY);
+  if(fd < 0){
+    return HALO_READ_FILE_NOT_FOUND;
+  }
+  struct stat fileStat;
+  if(fstat(fd, &fileStat) != 0){
+    close(fd);
+    return HALO_READ_FILE_NOT_FOUND;
+  }
+  size_t size = fileStat.st_size;
+
+  // Anything that does not start with the binary magic number is taken to
+  // be XML
+  char magic[sizeof(binaryHaloMagic)];
+  if(size < sizeof(binaryHaloMagic) or pread(fd, magic, sizeof(magic), 0) != (ssize_t)sizeof(magic)
+    or memcmp(magic, binaryHaloMagic, sizeof(magic)) != 0){
+    close(fd);
+    return ReadXMLHalos(filename, process, nprocs, halos);
+  }
+
+  HaloReadError ret;
+  void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(data != MAP_FAILED){
+    ret = ReadBinaryHalos((const char*)data, size, process, nprocs, halos);
+    munmap(data, size);
+  }else{
+    // Fall back to a single read
+    vector<char> buffer(size);
+    if(pread(fd, &buffer[0], size, 0) == (ssize_t)size){
+      ret = ReadBinaryHalos(&buffer[0], size, process, nprocs, halos);
+    }else{
+      ret = HALO_READ_FILE_INVALID;
+    }
+  }
+  close(fd);
+
+  return ret;
+}
+
+HaloReadError Fluidity::ReadHalos(const string& filename, int& process, int& nprocs, map<int, int>& npnodes, map<int, vector<vector<int> > >& send, map<int, vector<vector<int> > >& recv){ 
+  map<int, HaloLevel> halos;
+  HaloReadError ret = ReadHalos(filename, process, nprocs, halos);
+
+  npnodes.clear();
+  send.clear();
+  recv.clear();
+  if(ret != HALO_READ_SUCCESS){
+    return ret;
+  }
+
+  for(map<int, HaloLevel>::const_iterator levelIter = halos.begin();levelIter != halos.end();levelIter++){
+    const HaloLevel& halo = levelIter->second;
+    npnodes[levelIter->first] = halo.npnodes;
+    send[levelIter->first] = vector<vector<int> >(nprocs);
+    recv[levelIter->first] = vector<vector<int> >(nprocs);
+    for(size_t i = 0;i < halo.procs.size();i++){
+      send[levelIter->first][halo.procs[i]].assign(halo.sends.begin() + halo.send_starts[i], halo.sends.begin() + halo.send_starts[i + 1]);
+      recv[levelIter->first][halo.procs[i]].assign(halo.recvs.begin() + halo.recv_starts[i], halo.recvs.begin() + halo.recv_starts[i + 1]);
+    }
   }
 
   return HALO_READ_SUCCESS;
 }
 
+int Fluidity::WriteHalos(const string& filename, const unsigned int& process, const unsigned int& nprocs, const map<int, HaloLevel>& halos, HaloFormat format){
+  assert(process < nprocs);
+
+  if(format == HALO_FORMAT_BINARY){
+    return WriteBinaryHalos(filename, process, nprocs, halos);
+  }else{
+    return WriteXMLHalos(filename, process, nprocs, halos);
+  }
+}
+
 int Fluidity::WriteHalos(const string& filename, const unsigned int& process, const unsigned int& nprocs, const map<int, int>& npnodes, const map<int, vector<vector<int> > >& send, const map<int, vector<vector<int> > >& recv){
 #ifdef DDEBUG
   // Input check
@@ -184,89 +511,18 @@ int Fluidity::WriteHalos(const string& filename, const unsigned int& process, co
     assert(sendIter->second.size() == recvIter->second.size());
   }
 #endif
-  
-  TiXmlDocument doc;
-  
-  ostringstream buffer;
-  
-  // XML header
-  TiXmlDeclaration* header = new TiXmlDeclaration("1.0", "utf-8", "");
-  doc.LinkEndChild(header);
 
-  // Add root node
-  TiXmlElement* rootEle = new TiXmlElement("halos");
-  doc.LinkEndChild(rootEle);
-  
-  // Add process attribute to root node
-  buffer << process;
-  rootEle->SetAttribute("process", buffer.str());
-  buffer.str("");
-  
-  // Add nprocs attribute to root node
-  buffer << nprocs;
-  rootEle->SetAttribute("nprocs", buffer.str());
-  buffer.str("");
- 
-  // Add halo data for each level
+  map<int, HaloLevel> halos;
   map<int, int>::const_iterator npnodesIter = npnodes.begin();
   for(map<int, vector<vector<int> > >::const_iterator sendLevelIter = send.begin(), recvLevelIter = recv.begin();sendLevelIter != send.end() and recvLevelIter != recv.end() and npnodesIter != npnodes.end();sendLevelIter++, recvLevelIter++, npnodesIter++){
-    // Add halo element to root element
-    TiXmlElement* haloEle = new TiXmlElement("halo");
-    rootEle->LinkEndChild(haloEle);
-    
-    // Add level attribute to halo element
-    buffer << sendLevelIter->first;
-    haloEle->SetAttribute("level", buffer.str());
-    buffer.str("");
-    
-    // Add n_private_nodes attribute to halo element
-    buffer << npnodesIter->second;
-    haloEle->SetAttribute("n_private_nodes", buffer.str());
-    buffer.str("");
-    
-    // Add halo data for each process for each level
-    int j = 0;
-    for(vector<vector<int> >::const_iterator sendProcIter = sendLevelIter->second.begin(), recvProcIter = recvLevelIter->second.begin();sendProcIter != sendLevelIter->second.end() and recvProcIter != recvLevelIter->second.end();sendProcIter++, recvProcIter++, j++){
-      if(j == (int)nprocs){
-        break;
-      }
-
-      // Add halo_data element to halo element
-      TiXmlElement* dataEle = new TiXmlElement("halo_data");
-      haloEle->LinkEndChild(dataEle);
-    
-      // Add process attribute to data element
-      buffer << j;
-      dataEle->SetAttribute("process", buffer.str());
-      buffer.str("");
-
-      // Add send data to data element
-      TiXmlElement* sendDataEle = new TiXmlElement("send");
-      dataEle->LinkEndChild(sendDataEle);
+    DenseToHaloLevel(npnodesIter->second, sendLevelIter->second, recvLevelIter->second, nprocs, halos[sendLevelIter->first]);
+  }
 
-      // Add data to send data element
-      for(vector<int>::const_iterator sendDataIter = sendProcIter->begin();sendDataIter != sendProcIter->end();sendDataIter++){
-        buffer << *sendDataIter << " ";
-      }
-      TiXmlText* sendData = new TiXmlText(buffer.str());
-      sendDataEle->LinkEndChild(sendData);
-      buffer.str("");
+  return WriteHalos(filename, process, nprocs, halos, haloWriteFormat);
+}
 
-      // Add receive data to data element
-      TiXmlElement* recvDataEle = new TiXmlElement("receive");
-      dataEle->LinkEndChild(recvDataEle);
-      
-      // Add data to receive data element
-      for(vector<int>::const_iterator recvDataIter = recvProcIter->begin();recvDataIter != recvProcIter->end();recvDataIter++){
-        buffer << *recvDataIter << " ";
-      }
-      TiXmlText* recvData = new TiXmlText(buffer.str());
-      recvDataEle->LinkEndChild(recvData);
-      buffer.str("");
-    }
-  }
-  
-  return doc.SaveFile(filename) ? 0 : -1;
+void Fluidity::SetHaloWriteFormat(HaloFormat format){
+  haloWriteFormat = format;
 }
 
 HaloData* readHaloData = NULL;
@@ -292,8 +548,7 @@ extern "C"{
     ostringstream buffer;
     buffer << string(filename, *filename_len) << "_" << *process << ".halo";
     HaloReadError ret = ReadHalos(buffer.str(), 
-      readHaloData->process, readHaloData->nprocs,
-      readHaloData->npnodes, readHaloData->send, readHaloData->recv);
+      readHaloData->process, readHaloData->nprocs, readHaloData->halos);
   
     int errorCount = 0;
     if(ret == HALO_READ_FILE_NOT_FOUND){
@@ -304,9 +559,7 @@ extern "C"{
       }else{
         readHaloData->process = *process;
         readHaloData->nprocs = *nprocs;
-        readHaloData->npnodes.clear();
-        readHaloData->send.clear();
-        readHaloData->recv.clear();
+        readHaloData->halos.clear();
       }
     }else if(ret != HALO_READ_SUCCESS){
       cerr << "Error reading halo file " << buffer.str() << "\n";
@@ -339,23 +592,17 @@ extern "C"{
     assert(readHaloData);
     assert(*nprocs >= readHaloData->nprocs);
     
-    if(readHaloData->send.count(*level) == 0){
-      assert(readHaloData->recv.count(*level) == 0);
-      
-      for(int i = 0;i < *nprocs;i++){
-        nsends[i] = 0;
-        nreceives[i] = 0;
-      }
-    }else{
-      assert(readHaloData->recv.count(*level) > 0);
-      
-      for(int i = 0;i < readHaloData->nprocs;i++){
-        nsends[i] = readHaloData->send[*level][i].size();
-        nreceives[i] = readHaloData->recv[*level][i].size();
-      }
-      for(int i = readHaloData->nprocs;i < *nprocs;i++){
-        nsends[i] = 0;
-        nreceives[i] = 0;
+    for(int i = 0;i < *nprocs;i++){
+      nsends[i] = 0;
+      nreceives[i] = 0;
+    }
+    
+    map<int, HaloLevel>::const_iterator haloIter = readHaloData->halos.find(*level);
+    if(haloIter != readHaloData->halos.end()){
+      const HaloLevel& halo = haloIter->second;
+      for(size_t i = 0;i < halo.procs.size();i++){
+        nsends[halo.procs[i]] = halo.send_starts[i + 1] - halo.send_starts[i];
+        nreceives[halo.procs[i]] = halo.recv_starts[i + 1] - halo.recv_starts[i];
       }
     }
     
@@ -381,32 +628,28 @@ extern "C"{
     free(lnreceives);
 #endif
 
-    if(readHaloData->send.count(*level) == 0){
+    map<int, HaloLevel>::const_iterator haloIter = readHaloData->halos.find(*level);
+    if(haloIter == readHaloData->halos.end()){
 #ifdef DDEBUG
-      assert(readHaloData->recv.count(*level) == 0);
       for(int i = 0;i < *nprocs;i++){
         assert(nsends[i] == 0);
         assert(nreceives[i] == 0);
       }
 #endif
+      *npnodes = 0;
     }else{
-      assert(readHaloData->recv.count(*level) > 0);
-      
-      int sendIndex = 0, recvIndex = 0;;
-      for(int i = 0;i < readHaloData->nprocs;i++){
-        for(int j = 0;j < nsends[i];j++){
-          send[sendIndex] = readHaloData->send[*level][i][j];
-          sendIndex++;
-        }
-        for(int j = 0;j < nreceives[i];j++){
-          recv[recvIndex] = readHaloData->recv[*level][i][j];
-          recvIndex++;
-        }
+      // Neighbours are stored in increasing order, so the stored sends and
+      // receives are already concatenated by process
+      const HaloLevel& halo = haloIter->second;
+      if(!halo.sends.empty()){
+        memcpy(send, &halo.sends[0], halo.sends.size() * sizeof(int));
+      }
+      if(!halo.recvs.empty()){
+        memcpy(recv, &halo.recvs[0], halo.recvs.size() * sizeof(int));
       }
+      *npnodes = halo.npnodes;
     }
     
-    *npnodes = readHaloData->npnodes[*level];
-    
     return;
     }
     
@@ -438,23 +681,24 @@ extern "C"{
     assert(writeHaloData);
     assert(writeHaloData->nprocs == *nprocs);
 
-    writeHaloData->send[*level].clear();  writeHaloData->send[*level].resize(*nprocs);
-    writeHaloData->recv[*level].clear();  writeHaloData->recv[*level].resize(*nprocs);   
+    HaloLevel& halo = writeHaloData->halos[*level];
+    halo.npnodes = *npnodes;
+    halo.procs.clear();
+    halo.send_starts.assign(1, 0);
+    halo.recv_starts.assign(1, 0);
     int send_index = 0, recv_index = 0;
     for(int i = 0;i < *nprocs;i++){
-      writeHaloData->send[*level][i].resize(nsends[i]);
-      for(int j = 0;j < nsends[i];j++){
-        writeHaloData->send[*level][i][j] = send[send_index];
-        send_index++;
-      }
-      writeHaloData->recv[*level][i].resize(nreceives[i]);
-      for(int j = 0;j < nreceives[i];j++){
-        writeHaloData->recv[*level][i][j] = recv[recv_index];
-        recv_index++;
+      if(nsends[i] == 0 and nreceives[i] == 0){
+        continue;
       }
+      halo.procs.push_back(i);
+      send_index += nsends[i];
+      recv_index += nreceives[i];
+      halo.send_starts.push_back(send_index);
+      halo.recv_starts.push_back(recv_index);
     }
-    
-    writeHaloData->npnodes[*level] = *npnodes;
+    halo.sends.assign(send, send + send_index);
+    halo.recvs.assign(recv, recv + recv_index);
     
     return;
   }
@@ -468,6 +712,12 @@ extern "C"{
     
     return WriteHalos(buffer.str(),
                       writeHaloData->process, writeHaloData->nprocs,
-                      writeHaloData->npnodes, writeHaloData->send, writeHaloData->recv);
+                      writeHaloData->halos, haloWriteFormat);
+  }
+  
+  void cHaloWriterSetFormat(int* format){
+    SetHaloWriteFormat(*format == HALO_FORMAT_BINARY ? HALO_FORMAT_BINARY : HALO_FORMAT_XML);
+  
+    return;
   }
 }
@@ -35,6 +35,10 @@ Profiler::Profiler(){
 
 Profiler::~Profiler(){}
 
+void Profiler::add(const std::string &key, double time){
+  timings[key].second += time;
+}
+
 double Profiler::get(const std::string &key) const{
   double time = timings.find(key)->second.second;
   int init_flag;
@@ -142,6 +146,11 @@ extern "C" {
     *time = flprofiler.get(string(key, *key_len));
   }
 
+#define cprofiler_add_fc F77_FUNC(cprofiler_add, CPROFILER_ADD)
+  void cprofiler_add_fc(const char *key, const int *key_len, const double *time){
+    flprofiler.add(string(key, *key_len), *time);
+  }
+
 #define cprofiler_tic_fc F77_FUNC(cprofiler_tic, CPROFILER_TIC)
   void cprofiler_tic_fc(const char *key, const int *key_len){
     flprofiler.tic(string(key, *key_len));
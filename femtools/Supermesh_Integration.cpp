@@ -0,0 +1,176 @@
+/*  Copyright (C) 2006 Imperial College London and others.
+
+    Please see the AUTHORS file in the main source directory for a full list
+    of copyright holders.
+
+    Prof. C Pain
+    Applied Modelling and Computation Group
+    Department of Earth Science and Engineering
+    Imperial College London
+
+    amcgsoftware@imperial.ac.uk
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation,
+    version 2.1 of the License.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+    USA
+*/
+
+#include "confdefs.h"
+#include "Simplex_Clipping.h"
+
+#include <cmath>
+
+using namespace Fluidity;
+
+namespace
+{
+  // Add the integral over the simplex with the given vertices and
+  // measure of the product of each pair of linear functions with
+  // values lambdaB and lambdaA (nloc x nvertices, Fortran order) at the
+  // vertices:
+  //   mass(k, l) += int lambdaB_k lambdaA_l
+  // This is exact: for linear f and g on a simplex T of dimension d,
+  //   int_T f g = |T| (sum_a f_a g_a + sum_a f_a sum_a g_a) / ((d + 1)(d + 2))
+  void AddSimplexMass(int dim, const int* vertices, double measure,
+                      const double* lambdaA, const double* lambdaB, double* mass)
+  {
+    const int nloc = dim + 1;
+    const double scale = measure / ((dim + 1) * (dim + 2));
+
+    double sumA[4] = {0.0, 0.0, 0.0, 0.0}, sumB[4] = {0.0, 0.0, 0.0, 0.0};
+    for(int a = 0;a < nloc;a++){
+      for(int k = 0;k < nloc;k++){
+        sumA[k] += lambdaA[vertices[a] * nloc + k];
+        sumB[k] += lambdaB[vertices[a] * nloc + k];
+      }
+    }
+
+    for(int l = 0;l < nloc;l++){
+      for(int k = 0;k < nloc;k++){
+        double product = sumB[k] * sumA[l];
+        for(int a = 0;a < nloc;a++){
+          product += lambdaB[vertices[a] * nloc + k] * lambdaA[vertices[a] * nloc + l];
+        }
+        mass[l * nloc + k] += scale * product;
+      }
+    }
+  }
+
+  // Local coordinates, as given by local_coords_matrix, of npoints points
+  void LocalCoordinates(int dim, const double* matrix, const double* points, int npoints, double* lambda)
+  {
+    const int nloc = dim + 1;
+    for(int p = 0;p < npoints;p++){
+      for(int k = 0;k < nloc;k++){
+        double value = matrix[dim * nloc + k];
+        for(int i = 0;i < dim;i++){
+          value += matrix[i * nloc + k] * points[p * dim + i];
+        }
+        lambda[p * nloc + k] = value;
+      }
+    }
+  }
+}
+
+extern "C"
+{
+#define cIntersectAndIntegrate F77_FUNC(cintersect_and_integrate, CINTERSECT_AND_INTEGRATE)
+  // Intersect the linear simplices A and B (dim x (dim + 1) vertex
+  // positions) and integrate over the intersection without ever building a
+  // supermesh: on return mass(k, l) is the integral of the k-th P1 basis
+  // function of B times the l-th P1 basis function of A, and volume is the
+  // measure of the intersection (also the P0 mixed mass). matrixA and
+  // matrixB are the local_coords_matrix of each element. nsimplices is the
+  // number of simplices the intersection was divided into, or -1 if the
+  // clipping buffers overflowed.
+  void cIntersectAndIntegrate(const int* dim, const double* positionsA, const double* positionsB,
+                              const double* matrixA, const double* matrixB,
+                              double* mass, double* volume, int* nsimplices)
+  {
+    const int nloc = *dim + 1;
+    for(int i = 0;i < nloc * nloc;i++){
+      mass[i] = 0.0;
+    }
+    *volume = 0.0;
+    *nsimplices = 0;
+
+    double lambdaA[4 * maxClippedTetrahedra * 4], lambdaB[4 * maxClippedTetrahedra * 4];
+
+    switch(*dim){
+      case 1:{
+        double interval[2];
+        if(ClipIntervals(positionsA, positionsB, interval) == 0){
+          return;
+        }
+        LocalCoordinates(1, matrixA, interval, 2, lambdaA);
+        LocalCoordinates(1, matrixB, interval, 2, lambdaB);
+        const int vertices[2] = {0, 1};
+        *volume = interval[1] - interval[0];
+        AddSimplexMass(1, vertices, *volume, lambdaA, lambdaB, mass);
+        *nsimplices = 1;
+        break;
+      }
+      case 2:{
+        double polygon[2 * (maxClippedPolygonSize + 3)];
+        int nvertices = ClipTriangles(positionsA, positionsB, polygon);
+        if(nvertices == 0){
+          return;
+        }
+        LocalCoordinates(2, matrixA, polygon, nvertices, lambdaA);
+        LocalCoordinates(2, matrixB, polygon, nvertices, lambdaB);
+        // The polygon is convex and anticlockwise, so fan it from vertex 0
+        for(int i = 1;i < nvertices - 1;i++){
+          const int vertices[3] = {0, i, i + 1};
+          const double* p0 = polygon;
+          const double* p1 = polygon + 2 * i;
+          const double* p2 = polygon + 2 * (i + 1);
+          double area = 0.5 * ((p1[0] - p0[0]) * (p2[1] - p0[1]) - (p1[1] - p0[1]) * (p2[0] - p0[0]));
+          if(area <= 0.0){
+            continue;
+          }
+          AddSimplexMass(2, vertices, area, lambdaA, lambdaB, mass);
+          *volume += area;
+          (*nsimplices)++;
+        }
+        break;
+      }
+      case 3:{
+        if(!BoundingBoxesOverlap(3, 4, positionsA, positionsB)){
+          return;
+        }
+        ClipPlane planesB[4];
+        TetrahedronPlanes(positionsB, planesB);
+        double tets[12 * maxClippedTetrahedra], work[12 * maxClippedTetrahedra];
+        int ntets = ClipTetrahedra(positionsA, planesB, tets, work);
+        if(ntets <= 0){
+          *nsimplices = ntets;
+          return;
+        }
+        LocalCoordinates(3, matrixA, tets, 4 * ntets, lambdaA);
+        LocalCoordinates(3, matrixB, tets, 4 * ntets, lambdaB);
+        for(int t = 0;t < ntets;t++){
+          const int vertices[4] = {4 * t, 4 * t + 1, 4 * t + 2, 4 * t + 3};
+          double vol = TetrahedronVolume(tets + 12 * t);
+          AddSimplexMass(3, vertices, vol, lambdaA, lambdaB, mass);
+          *volume += vol;
+        }
+        *nsimplices = ntets;
+        break;
+      }
+      default:
+        *nsimplices = -1;
+        break;
+    }
+  }
+}
@@ -92,27 +92,55 @@ int vtk_read_file_fc(char *fortname, int *namelen,
 }
 
 
-int vtk_get_sizes_fc(char *fortname, int *namelen,
-  // number of nodes, elements and entries in the returned enls (ndglno):
-                  int *NNOD, int *NELM, int *SZENLS, 
-  // total number of components over pointwise and cell-wise fields
-  // i.e. no_scalar_field+ndim*no_vector_fields+ndim**2*no_tensor_fields
-  // NOTE that the vtus usually contain 3 and 9 dimensional vector and tensor fields
-  // even for 2 and 1 dimensional grids (so ndim here is typically 3,
-  // whereas *NDIM below might be different)
-                  int *nfield_components, int *nprop_components,
-  // number of point-wise (nfields) and cell-wise fields (nprops):
-                  int *nfields, int *nprops,
-  // dimension of the vtu mesh and maximum length of 
-                  int *NDIM, int *maxlen ) 
-{
 #ifdef HAVE_VTK
-  int status=0;
-  int *ENLBAS=NULL, *ENLIST=NULL;
-  flfloat_t *X=NULL, *Y=NULL, *Z=NULL, *F=NULL, *P=NULL;
-  
+// vtk_get_sizes_fc reads the whole file, not just its sizes, and keeps
+// everything here so that the vtk_read_file_fc call that follows it only
+// has to copy the arrays out rather than parse the same file again.
+struct VTK_Read_Cache{
+  char *filename;
+  int request_ndim;
+  int nnod, nelm, szenls, nfield_components, nprop_components, ndim;
+  Field_Info *fieldlst;
+  flfloat_t *X, *Y, *Z, *FIELDS, *PROPS;
+  int *ENLBAS, *ENLIST;
+};
+
+static VTK_Read_Cache read_cache = {NULL, 0, 0, 0, 0, 0, 0, 0,
+                                    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+
+static void vtk_release_read_cache()
+{
+  while( read_cache.fieldlst != NULL ) {
+    Field_Info *newfld = read_cache.fieldlst;
+    read_cache.fieldlst = newfld->next;
+    free(newfld->name);
+    free(newfld);
+  }
+  free(read_cache.filename);
+  free(read_cache.X);
+  free(read_cache.Y);
+  free(read_cache.Z);
+  free(read_cache.FIELDS);
+  free(read_cache.PROPS);
+  free(read_cache.ENLBAS);
+  free(read_cache.ENLIST);
+  memset(&read_cache, 0, sizeof(VTK_Read_Cache));
+}
+
+// Make read_cache hold the file fortname, read with dimension *NDIM
+// (0 to work it out from the cells), unless it already does.
+static int vtk_fill_read_cache(char *fortname, int *namelen, int *NDIM)
+{
+  if( read_cache.filename != NULL &&
+      (int) strlen(read_cache.filename) == *namelen &&
+      strncmp(read_cache.filename, fortname, *namelen) == 0 &&
+      (*NDIM == read_cache.request_ndim || *NDIM == read_cache.ndim) )
+    return 0;
+
+  vtk_release_read_cache();
+
   // the filename string passed down from Fortran needs terminating,
-  // so make a copy and fiddle with it (remember to free it)
+  // so make a copy and fiddle with it (freed with the cache)
   char *filename = (char *)malloc(*namelen+3);
   memcpy( filename, fortname, *namelen );
   filename[*namelen] = 0;
@@ -124,44 +152,99 @@ int vtk_get_sizes_fc(char *fortname, int *namelen,
   fieldlst->ncomponents = -1;
   fieldlst->next = NULL;
 
-  // read VTK file, placing required info into appropriate arrays
-  status = readVTKFile( filename, NNOD, NELM, nfield_components, nprop_components,
-                        SZENLS, NDIM, fieldlst,
-                        &X, &Y, &Z, &ENLBAS, &ENLIST, &F, &P, 2, 0 );
-
-  free( filename );
+  // read VTK file, letting readVTKFile allocate all the arrays
+  int ndim = *NDIM;
+  int status = readVTKFile( filename, &read_cache.nnod, &read_cache.nelm,
+                            &read_cache.nfield_components, &read_cache.nprop_components,
+                            &read_cache.szenls, &ndim, fieldlst,
+                            &read_cache.X, &read_cache.Y, &read_cache.Z,
+                            &read_cache.ENLBAS, &read_cache.ENLIST,
+                            &read_cache.FIELDS, &read_cache.PROPS, 0, 0 );
 
   // we remove the leading record (created before readVTKFile),
   if( fieldlst->ncomponents==-1 ) {
     Field_Info *newfld = fieldlst;
     fieldlst = newfld->next;
     free(newfld);
-    newfld = fieldlst;
   }
+  read_cache.fieldlst = fieldlst;
+  read_cache.filename = filename;
 
+  if( status ) {
+    vtk_release_read_cache();
+    return status;
+  }
+
+  read_cache.request_ndim = *NDIM;
+  read_cache.ndim = ndim;
+  return 0;
+}
+
+// Copy the names of the fields in fieldlst, up to and excluding stop,
+// into names (truncating or space padding each to maxlen) and their
+// component counts into components. Returns the number of fields.
+static int vtk_copy_field_names(Field_Info *fieldlst, Field_Info *stop,
+                                int maxlen, char *names, int *components)
+{
+  int nfields = 0, ipos = 0;
+  for(Field_Info *fld=fieldlst; fld!=stop; fld=fld->next) {
+    int l = strlen(fld->name);
+    if( l>maxlen )
+      l = maxlen;
+    for( int i=0; i<l; i++ )
+      names[ipos+i] = fld->name[i];
+    // pad with spaces up to maxlen
+    for( int i=l; i<maxlen; i++ )
+      names[ipos+i] = 32;
+    ipos += maxlen;
+    components[nfields] = fld->ncomponents;
+    nfields++;
+  }
+  return nfields;
+}
+#endif
+
+int vtk_get_sizes_fc(char *fortname, int *namelen,
+  // number of nodes, elements and entries in the returned enls (ndglno):
+                  int *NNOD, int *NELM, int *SZENLS, 
+  // total number of components over pointwise and cell-wise fields
+  // i.e. no_scalar_field+ndim*no_vector_fields+ndim**2*no_tensor_fields
+  // NOTE that the vtus usually contain 3 and 9 dimensional vector and tensor fields
+  // even for 2 and 1 dimensional grids (so ndim here is typically 3,
+  // whereas *NDIM below might be different)
+                  int *nfield_components, int *nprop_components,
+  // number of point-wise (nfields) and cell-wise fields (nprops):
+                  int *nfields, int *nprops,
+  // dimension of the vtu mesh and maximum length of 
+                  int *NDIM, int *maxlen ) 
+{
+#ifdef HAVE_VTK
+  int status = vtk_fill_read_cache(fortname, namelen, NDIM);
   if( status ) {
     return status;
   }
 
+  *NNOD = read_cache.nnod;
+  *NELM = read_cache.nelm;
+  *SZENLS = read_cache.szenls;
+  *nfield_components = read_cache.nfield_components;
+  *nprop_components = read_cache.nprop_components;
+  *NDIM = read_cache.ndim;
+
   *maxlen = 0;
   int ncomponents=0;
   *nfields=0;
   *nprops=0;
-  // now check lengths of field names, and free the field info list
-  while( fieldlst != NULL ) {
-    Field_Info *newfld = fieldlst;
-    fieldlst = newfld->next;
-    char *thisname=newfld->name;
-    int l = strlen(thisname);
+  // now check lengths of field names
+  for(Field_Info *fld=read_cache.fieldlst; fld!=NULL; fld=fld->next) {
+    int l = strlen(fld->name);
     if( l > *maxlen )  *maxlen = l;
     if (ncomponents<*nfield_components) {
       (*nfields)++;
     } else {
       (*nprops)++;
     }
-    ncomponents += newfld->ncomponents;
-    free(newfld->name);
-    free(newfld);
+    ncomponents += fld->ncomponents;
   }
 
   return status;
@@ -200,89 +283,43 @@ int vtk_read_file_fc(char *fortname, int *namelen,
                   char *field_names, char *prop_names)
 {
 #ifdef HAVE_VTK
-  int status=0;
-  
-  // the filename string passed down from Fortan needs terminating
-  // so make a copy and fiddle with it (remember to free it)
-  char *filename = (char *)malloc(*namelen+3);
-  memcpy( filename, fortname, *namelen );
-  filename[*namelen] = 0;
-
-  // we must create an empty Field_Info record for readVTKFile,
-  // so that it can append all the fields after it.
-  Field_Info *fieldlst = (Field_Info *)malloc(sizeof(Field_Info));
-  assert( fieldlst!=NULL );
-  fieldlst->ncomponents = -1;
-  fieldlst->next = NULL;
+  // normally a no-op, as vtk_get_sizes_fc has just read this file
+  int status = vtk_fill_read_cache(fortname, namelen, NDIM);
+  if( status ) {
+    return status;
+  }
 
-  // read VTK file, placing required info into appropriate arrays
-  status = readVTKFile( filename, NNOD, NELM, nfield_components, nprop_components,
-                        SZENLS, NDIM, fieldlst,
-                        &X, &Y, &Z, &ENLBAS, &ENLIST, &FIELDS, &PROPS,
-                        0, 0 );
+  *NNOD = read_cache.nnod;
+  *NELM = read_cache.nelm;
+  *SZENLS = read_cache.szenls;
+  *nfield_components = read_cache.nfield_components;
+  *nprop_components = read_cache.nprop_components;
+  *NDIM = read_cache.ndim;
 
-  free( filename );
+  memcpy(X, read_cache.X, *NNOD*sizeof(flfloat_t));
+  memcpy(Y, read_cache.Y, *NNOD*sizeof(flfloat_t));
+  memcpy(Z, read_cache.Z, *NNOD*sizeof(flfloat_t));
+  if( *nfield_components > 0 )
+    memcpy(FIELDS, read_cache.FIELDS, (size_t) *NNOD * *nfield_components*sizeof(flfloat_t));
+  if( *nprop_components > 0 )
+    memcpy(PROPS, read_cache.PROPS, (size_t) *NELM * *nprop_components*sizeof(flfloat_t));
+  memcpy(ENLBAS, read_cache.ENLBAS, (*NELM+1)*sizeof(int));
+  memcpy(ENLIST, read_cache.ENLIST, *SZENLS*sizeof(int));
 
-  // we remove the leading record (created before readVTKFile),
-  if( fieldlst->ncomponents==-1 ) {
-    Field_Info *newfld = fieldlst;
-    fieldlst = newfld->next;
-    free(newfld);
-    newfld = fieldlst;
-  }
+  // the point-wise fields come first in the field list, then the
+  // cell-wise ones
+  Field_Info *first_prop = read_cache.fieldlst;
+  for(int ncomponents=0; ncomponents<*nfield_components; first_prop=first_prop->next)
+    ncomponents += first_prop->ncomponents;
 
-  if( status ) {
-    return status;
-  }
+  *nfields = vtk_copy_field_names(read_cache.fieldlst, first_prop, *maxlen,
+                                  field_names, field_components);
+  *nprops = vtk_copy_field_names(first_prop, NULL, *maxlen,
+                                 prop_names, prop_components);
 
-  int ncomponents=0;
-  // now put field names into field_names (truncating at maxlen if needed),
-  // and free up the field info list
-  *nfields = 0;
-  int ipos = 0;
-  while( ncomponents<*nfield_components ) {
-    Field_Info *newfld = fieldlst;
-    fieldlst = newfld->next;
-    char *thisname=newfld->name;
-    int l = strlen(thisname);
-    if( l>*maxlen )
-      l = *maxlen;
-    for( int i=0; i<l; i++ )
-      field_names[ipos+i] = thisname[i];
-    // pad with spaces up to maxlen
-    for( int i=l; i<*maxlen; i++ )
-      field_names[ipos+i] = 32;
-    ipos += *maxlen;
-    ncomponents += newfld->ncomponents;
-    field_components[*nfields] = newfld->ncomponents;
-    free(newfld->name);
-    free(newfld);
-    (*nfields)++;
-  }
+  // everything has been handed over, so don't hang on to the copy
+  vtk_release_read_cache();
 
-  // now put field names into field_names (truncating at maxlen if needed),
-  // and free up the field info list
-  *nprops=0;
-  ipos = 0;
-  while( fieldlst != NULL ) {
-    Field_Info *newfld = fieldlst;
-    fieldlst = newfld->next;
-    char *thisname=newfld->name;
-    int l = strlen(thisname);
-    if( l>*maxlen )
-      l = *maxlen;
-    for( int i=0; i<l; i++ )
-      prop_names[ipos+i] = thisname[i];
-    // pad with spaces up to maxlen
-    for( int i=l; i<*maxlen; i++ )
-      prop_names[ipos+i] = 32;
-    ipos += *maxlen;
-    prop_components[*nprops] = newfld->ncomponents;
-    (*nprops)++;
-    free(newfld->name);
-    free(newfld);
-  }
-  
   return status;
 #else
   cerr<<"ERROR: No VTK support compiled\n";
@@ -31,62 +31,6 @@
 #include "fldecomp.h"
 
 
-// Matches element type with number of nodes.
-int elemNumNodes[] = 
-  {2, 2, 3, 4, 4, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
-
-
-
-// ----------------------------------------------------------------------------
-// ----------------------------------------------------------------------------
-
-
-
-// Element class to make things easier.
-
-class Element
-{
-public:
-  int ID, type, numTags, numNodes;
-  vector <int> nodeIDs, tags;
-  int physicalID, elementary;
-  
-  // Read method
-  int read(fstream *efile, int _elemType, int _numNodes, int _numTags)
-  {
-    int n, t;
-    
-    type = _elemType;
-    numNodes = _numNodes;
-    numTags = _numTags;
-
-    nodeIDs.resize(numNodes);
-    tags.resize(numTags);
-    
-    efile->read( (char *)&ID, sizeof(int) );
-    
-    for(t=0; t<numTags; t++)
-      efile->read( (char *)&tags[t], sizeof(int) );
-
-    for(n=0; n<numNodes; n++)
-      efile->read( (char *)&nodeIDs[n], sizeof(int) );
-    
-    // Standard tags
-    if(numTags >= 2)
-      {
-        physicalID = tags[0];
-        elementary = tags[1];
-      }
-    
-    return 0;
-  };  
-
-};
-
-
-
-
-
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 
@@ -634,237 +578,51 @@ void write_partitions_gmsh(bool verbose,
 // ----------------------------------------------------------------------------
 
 
-/* Read in GMSH header from open file.
-   This is more format error checking than anything.
+/* Decide which GMSH element types are faces, and which are regular
+   elements, from the elements read from a GMSH file.
 */
 
 
-
-void read_gmsh_header(fstream &gmshfile)
-{
-  int errorCode=1;
-
-  // Prelimary format checking
-
-  string beginTag;
-  float gmshVersion;
-  int gmshFormat, doubleFloatLen;
-
-  gmshfile >> beginTag >> gmshVersion >> gmshFormat >> doubleFloatLen;
-
-
-  if( beginTag != "$MeshFormat" ) {
-    cerr << "Can't find $MeshFormat tag\n";
-    exit(errorCode);
-  }
-
-  if( gmshVersion < 2 || gmshVersion >= 3 ) {
-    cerr << "Currently only GMSH format v2.x is supported\n";
-    exit(errorCode);
-  }
-
-  if( doubleFloatLen != sizeof(double) ) {
-    cerr << "Double float size in GMSH file differs from system double\n";
-    exit(errorCode);
-  }
-
-  // For performance reasons only binary GMSH files are permitted with fldecomp
-  if( gmshFormat == 0 ) {
-    cerr << "** GMSH ASCII files are verboten:\n"
-         << "** please use 'gmsh -bin' to generate binary format.\n";
-    exit(errorCode);
-  }
-
-  // Skip newline character
-  char newLineChar[2];
-  gmshfile.read( newLineChar, 1 );
-
-  // Read in integer '1' written in binary format: check for endianness
-  int oneInt;
-  gmshfile.read( (char *)&oneInt, sizeof(int) );
-  gmshfile.read( newLineChar, 1 );
-
-
-  if( oneInt != 1 ){
-    cerr << "** Oh dear: internal and file binary formats for integers differ (endianness?)\n";
-    exit(errorCode);
-  }
-
-
-  char sectionTag[80];
-  gmshfile.getline( sectionTag, sizeof("$EndMeshFormat") );
-
-  // Check for end of formatting section
-  if( string(sectionTag) != "$EndMeshFormat" ) {
-    cerr << "Can't find $EndMeshFormat tag\n";
-    exit(errorCode);
-  }
-}
-
-
-
-
-// ----------------------------------------------------------------------------
-// ----------------------------------------------------------------------------
-
-/* Read in mesh section from an already open GMSH file */
-
-
-int read_gmsh_nodes(fstream &gmshfile, vector<int> &nodeIDs, vector<double> &x)
-{
-  int errorCode=1;
-  char sectionTag[80];
-  char newLineChar[2]="\n";
-
-  // Start of nodes section
-  gmshfile.getline( sectionTag, sizeof("$Nodes") );
-
-  if( string(sectionTag) != "$Nodes" ) {
-    cerr << "Can't find $Nodes tag\n";
-    exit(errorCode);
-  }
-
-  int numNodes;
-  gmshfile >> numNodes;
-  gmshfile.read( newLineChar, 1 );
-
-  // Read in binary node data
-  nodeIDs.resize(numNodes);
-  x.resize(numNodes*3);
-  //vector<int> surface_nids;
-
-  int n;
-  for(n=0; n<numNodes; n++)
-    {
-      gmshfile.read( (char *)&nodeIDs[n], sizeof(int) );
-      gmshfile.read( (char *)&x[n*3], sizeof(double) );
-      gmshfile.read( (char *)&x[n*3+1], sizeof(double) );
-      gmshfile.read( (char *)&x[n*3+2], sizeof(double) );
-    }
-  gmshfile.read( newLineChar, 1 );
-
-
-  // End of nodes section
-  gmshfile.getline( sectionTag, sizeof("$EndNodes") );
-
-  if( string(sectionTag) != "$EndNodes" )
-    {
-      cerr << "Can't find $EndNodes tag\n";
-      exit(errorCode);
-    }
-
-  return numNodes;
-}
-
-
-
-
-
-// ----------------------------------------------------------------------------
-// ----------------------------------------------------------------------------
-
-/* Read in elements section of element file, 
-   returning a pointer to an array of Element objects */
-
-
-
-
-Element *read_gmsh_elements(fstream &gmshfile,
+void classify_gmsh_elements(const GMSHElements &gmshElements,
                             int &numDimen,
                             int &numElements, int &elemType, int &nloc,
                             int &numFaces, int &faceType, int &snloc)
 {
   int errorCode=1;
-  char sectionTag[80];
-
-  char newLineChar[2]="\n";
-
-  // Elements section
-  gmshfile.getline( sectionTag, sizeof("$Elements") );
-  int totalElements;
-
-  if( string(sectionTag) != "$Elements" ){
-    cerr << "Can't find $Elements tag\n";
-    exit(errorCode);
-  }
-
-  gmshfile >> totalElements;
 
-  gmshfile.read( newLineChar, 1 );
-
-  int eIx=0;
-
-  // Element array
-  Element *gmshElements = new Element[totalElements];
-
-  // Read in all elements, including faces
+  // Count up the number of different types of elements. This allows us
+  // to decide what are faces, and what are internal elements.
   int numEdges=0, numTriangles=0, numQuads=0, numTets=0, numHexes=0;
 
-  while( eIx < totalElements )
+  for(size_t e=0; e<gmshElements.types.size(); e++)
     {
-      int numBlockElems, numTags;
-
-      gmshfile.read( (char *)&elemType, sizeof(int) );
-      gmshfile.read( (char *)&numBlockElems, sizeof(int) );
-      gmshfile.read( (char *)&numTags, sizeof(int) );
-
-      // Do we know about this type of element?
-      if( elemNumNodes[elemType] == -1 )
+      switch( gmshElements.types[e] )
         {
-          cerr << "Element type not supported by fldecomp\n";
+        case 1:
+          numEdges++;
+          break;
+        case 2:
+          numTriangles++;
+          break;
+        case 3:
+          numQuads++;
+          break;
+        case 4:
+          numTets++;
+          break;
+        case 5:
+          numHexes++;
+          break;
+        case 15:
+          break;
+        default:
+          cerr << "Unsupported element type in GMSH mesh\n";
+          cerr << "type: "<< gmshElements.types[e] << "\n";
           exit(errorCode);
-        }
-
-      // Read in all the elements of this type
-      for(int e=0; e<numBlockElems; e++)
-        {
-          gmshElements[eIx].read(&gmshfile, elemType,
-                                 elemNumNodes[elemType], numTags);
-
-          // Here, we count up the number of different types of elements.
-          // This allows us to decide what are faces, and what are internal
-          // elements.
-          switch( gmshElements[eIx].type )
-            {
-            case 1:
-              numEdges++;
-              break;
-            case 2:
-              numTriangles++;
-              break;
-            case 3:
-              numQuads++;
-              break;
-            case 4:
-              numTets++;
-              break;
-            case 5:
-              numHexes++;
-              break;
-            case 15:
-              break;
-            default:
-              cerr << "Unsupported element type in GMSH mesh\n";
-              cerr << "type: "<< gmshElements[eIx].type << "\n";
-              exit(errorCode);
-              break;
-            }
-
-          eIx++;
+          break;
         }
     }
 
-  gmshfile.read( newLineChar, 1 );
-
-  // End of Elements section
-  gmshfile.getline( sectionTag, sizeof("$EndElements") );
-
-
-  if( string(sectionTag) != "$EndElements" ) {
-      cerr << "Can't find $EndElements tag\n";
-      exit(errorCode);
-    }
-
   // Make some calculations based on the different types of elements
   // collected.
 
@@ -899,13 +657,10 @@ Element *read_gmsh_elements(fstream &gmshfile,
   }
 
   // Set some handy variables to be used elsewhere
-  numElements = totalElements-numFaces;
+  numElements = gmshElements.types.size()-numFaces;
 
-  nloc = elemNumNodes[elemType];
-  snloc = elemNumNodes[faceType];
-
-  // Return list of GMSH elements (eg. normal elements and faces)
-  return gmshElements;
+  nloc = GMSHElementNodeCount(elemType);
+  snloc = GMSHElementNodeCount(faceType);
 }
 
 
@@ -932,37 +687,49 @@ int decomp_gmsh( map<char, string> flArgs, bool verbose,
   // base name + file extension
   string lfilename = filename+".msh";
 
-  fstream gmshfile;
-
-  // Open the GMSH file.
-  gmshfile.open(lfilename.c_str(), ios::in | ios::binary);
-  if(!gmshfile.is_open()){
+  // Open the GMSH file. It is memory mapped, and ASCII and binary files are
+  // both parsed in parallel chunks.
+  GMSHReader gmshfile;
+  GMSHReadError ret = gmshfile.Open(lfilename);
+  switch(ret){
+  case GMSH_READ_SUCCESS:
+    break;
+  case GMSH_READ_FILE_NOT_FOUND:
     cerr<<"ERROR: GMSH file, "<< lfilename
         <<", cannot be opened. Does it exist? Have you read permission?\n";
     exit(-1);
+  case GMSH_READ_UNSUPPORTED_VERSION:
+    cerr << "Currently only GMSH format v2.x is supported\n";
+    exit(errorCode);
+  case GMSH_READ_UNSUPPORTED_ELEMENT:
+    cerr << "Element type not supported by fldecomp\n";
+    exit(errorCode);
+  default:
+    cerr << "ERROR: " << lfilename << " is not a valid GMSH mesh file\n";
+    exit(errorCode);
   }
 
 
   // Read in data from GMSH file, eg. node and element data.
-  vector<int> nodeIDs;
-  vector<double> x;
-  int numDimen, numElements, elemType, nloc, numFaces, faceType, snloc;
+  GMSHNodes gmshNodes;
+  GMSHElements gmshElements;
+  if(gmshfile.ReadNodes(gmshNodes) != GMSH_READ_SUCCESS or
+     gmshfile.ReadElements(gmshElements) != GMSH_READ_SUCCESS){
+    cerr << "ERROR: failed to read the nodes and elements of " << lfilename
+         << "\nUnsupported element types, or a corrupt file?\n";
+    exit(errorCode);
+  }
+  gmshfile.Close();
 
-  read_gmsh_header(gmshfile);
-  int numNodes = read_gmsh_nodes(gmshfile, nodeIDs, x);
-  Element *gmshElements = read_gmsh_elements(gmshfile, numDimen, numElements, elemType, nloc, numFaces, faceType, snloc);
+  int numNodes = gmshNodes.ids.size();
+  vector<double> &x = gmshNodes.x;
+  int numDimen, numElements, elemType, nloc, numFaces, faceType, snloc;
+  classify_gmsh_elements(gmshElements, numDimen, numElements, elemType, nloc, numFaces, faceType, snloc);
   // Every GMSH mesh is 3D, with a zeroed z-coordinate. We just keep this
   // to 3D (for now) to keep the parition routines etc. happy.
   numDimen=3;
 
 
-  // Close the GMSH file.
-  gmshfile.close();
-  
-
-
-
-
   vector<int> ENList, regionIds;
   ENList.resize(numElements*nloc);
   regionIds.resize(numElements);
@@ -982,24 +749,29 @@ int decomp_gmsh( map<char, string> flArgs, bool verbose,
   int elepos=0, enlistpos=0, facepos=0;
   for(int g=0; g<numFaces+numElements; g++)
     {
+      const int *nodeIDs = &gmshElements.nodes[gmshElements.node_starts[g]];
+      const int numTags = gmshElements.tag_starts[g+1]-gmshElements.tag_starts[g];
+      // Standard tags
+      const int physicalID = numTags>0 ? gmshElements.tags[gmshElements.tag_starts[g]] : 0;
+
       // If we have a regular element
-      if(gmshElements[g].type==elemType)
+      if(gmshElements.types[g]==elemType)
         {
           for(int j=0; j<nloc; j++)
-            ENList[enlistpos++] = gmshElements[g].nodeIDs[j];
+            ENList[enlistpos++] = nodeIDs[j];
 
-          regionIds[elepos] = gmshElements[g].physicalID;
+          regionIds[elepos] = physicalID;
           elepos++;
 
-        } else if(gmshElements[g].type==faceType)
+        } else if(gmshElements.types[g]==faceType)
         {
           // This is a face
 
           for(int j=0; j<snloc; j++)
-            facet[j] = gmshElements[g].nodeIDs[j];
+            facet[j] = nodeIDs[j];
 
           SENList[facepos] = facet;
-          boundaryIds[facepos] = gmshElements[g].physicalID;
+          boundaryIds[facepos] = physicalID;
 
           facepos++;
         } else {
@@ -1031,19 +803,29 @@ int decomp_gmsh( map<char, string> flArgs, bool verbose,
     npartitions.push_back(nparts);
   }
   
-  int edgecut=0;
-
-
-    
   // Partition the mesh. Generates a map "decomp" from node number
   // (numbered from zero) to partition number (numbered from
   // zero).
 
-  edgecut = partition( ENList, numDimen, nloc, numNodes, npartitions,
-                       partition_method, decomp );
+  if(flArgs.count('g')){
+    if(verbose)
+      cout<<"Partitioning the mesh along a space-filling curve\n";
+    sfc_partition( x, numDimen, vector<double>(), nparts, decomp );
+  }else{
+    partition( ENList, numDimen, nloc, numNodes, npartitions,
+               partition_method, decomp );
+  }
 
   if(flArgs.count('d')){
-    cout<<"Edge-cut: "<<edgecut<<endl;
+    print_partition_quality( flArgs.count('g') ? "SFC" : "METIS", ENList,
+                             numDimen, nloc, numNodes, decomp, nparts );
+    if(flArgs.count('g')){
+      vector<int> metis_decomp;
+      partition( ENList, numDimen, nloc, numNodes, npartitions,
+                 partition_method, metis_decomp );
+      print_partition_quality( "METIS", ENList, numDimen, nloc, numNodes,
+                               metis_decomp, nparts );
+    }
   }
   
   // Process the partitioning
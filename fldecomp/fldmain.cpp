@@ -33,10 +33,16 @@
 
 void usage(char *binary){
   cerr<<"Usage: "<<binary<<" [OPTIONS] -n nparts file\n"
+      <<"\t-b,--binary-halos\n\t\tWrite the halo files in the binary format, which loads faster "
+      <<"than XML at large process counts.\n"
       <<"\t-c,--cores <number of cores per node>\n\t\tApplies hierarchical partitioning.\n"
       <<"\t-d,--diagnostics\n\t\tPrint out partition diagnostics.\n"
       <<"\t-f,--file <file name>\n\t\tInput file (can alternatively specify as final "
       <<"argument)\n"
+      <<"\t-g,--sfc\n\t\tPartition geometrically, by cutting a Hilbert space-filling curve through "
+      <<"the nodes into pieces of equal weight. This is fast and needs no graph library, "
+      <<"but usually gives a larger edge-cut than METIS. With -d the METIS partitioning "
+      <<"is also computed, and its diagnostics printed for comparison.\n"
       <<"\t-h,--help\n\t\tPrints out this message\n"
       <<"\t-k.--kway\n\t\tPartition a graph into k equal-size parts using the "
       <<"multilevel k-way partitioning algorithm (METIS PartGraphKway). This "
@@ -64,9 +70,11 @@ int main(int argc, char **argv){
   // reset optarg so we can detect changes
 #ifndef _AIX
   struct option longOptions[] = {
+    {"binary-halos", 0, 0, 'b'},
     {"cores", 0, 0, 'c'},
     {"diagnostics", 0, 0, 'd'},
     {"file", 0, 0, 'f'},
+    {"sfc", 0, 0, 'g'},
     {"help", 0, 0, 'h'},
     {"kway", 0, 0, 'k'},
     {"nparts", 0, 0, 'n'},
@@ -108,9 +116,9 @@ int main(int argc, char **argv){
   map<char, string> flArgs;
   while (true){
 #ifndef _AIX
-    c = getopt_long(argc, argv, "c:df:hkn:rt::s::vm:", longOptions, &optionIndex);
+    c = getopt_long(argc, argv, "bc:df:ghkn:rt::s::vm:", longOptions, &optionIndex);
 #else
-    c = getopt(argc, argv, "c:df:hkn:rt::s::vm:");
+    c = getopt(argc, argv, "bc:df:ghkn:rt::s::vm:");
 #endif
     if (c == -1) break;
 
@@ -149,6 +157,10 @@ int main(int argc, char **argv){
     val = 0;
   }
   set_global_debug_level_fc(&val);
+
+  if(flArgs.count('b')){
+    SetHaloWriteFormat(HALO_FORMAT_BINARY);
+  }
   
   if(!flArgs.count('f')){
     if(argc>optind+1){
@@ -610,7 +610,8 @@ int decomp_triangle( map<char, string> flArgs, bool verbose,
     npartitions.push_back(nparts);
   }
   
-  int edgecut=0;
+  vector<int> metis_decomp;
+  bool compare_metis = flArgs.count('g') && flArgs.count('d');
   if(surface_nids.size()){
     // Partition the mesh
     if(verbose)
@@ -619,7 +620,28 @@ int decomp_triangle( map<char, string> flArgs, bool verbose,
     // Partition the mesh. Generates a map "decomp" from node number
     // (numbered from zero) to partition number (numbered from
     // zero).
-    edgecut = partition(topSENList, 2, snloc, snnodes, npartitions, partition_method, decomp);
+    if(flArgs.count('g')){
+      // Cut a curve through the horizontal positions of the columns,
+      // weighted by the number of nodes in each column
+      vector<double> column_x(snnodes*2, 0.0), column_weights(snnodes, 0.0);
+      for(int i=0;i<nnodes;i++){
+        int column = surface_nids[i]-1;
+        column_x[column*2] += x[i*no_coords];
+        column_x[column*2+1] += x[i*no_coords+1];
+        column_weights[column] += 1.0;
+      }
+      for(int i=0;i<snnodes;i++){
+        if(column_weights[i]>0.0){
+          column_x[i*2] /= column_weights[i];
+          column_x[i*2+1] /= column_weights[i];
+        }
+      }
+      sfc_partition(column_x, 2, column_weights, nparts, decomp);
+    }else{
+      partition(topSENList, 2, snloc, snnodes, npartitions, partition_method, decomp);
+    }
+    if(compare_metis)
+      partition(topSENList, 2, snloc, snnodes, npartitions, partition_method, metis_decomp);
     topSENList.clear();
     decomp.resize(nnodes);
     vector<int> decomp_temp;
@@ -628,6 +650,12 @@ int decomp_triangle( map<char, string> flArgs, bool verbose,
       decomp_temp[i] = decomp[surface_nids[i]-1]; // surface_nids=column number
     }
     decomp=decomp_temp;
+    if(compare_metis){
+      for(int i=0;i<nnodes;i++){
+        decomp_temp[i] = metis_decomp[surface_nids[i]-1];
+      }
+      metis_decomp=decomp_temp;
+    }
     decomp_temp.clear();
   }else{
     // Partition the mesh
@@ -637,12 +665,21 @@ int decomp_triangle( map<char, string> flArgs, bool verbose,
     // Partition the mesh. Generates a map "decomp" from node number
     // (numbered from zero) to partition number (numbered from
     // zero).
-    edgecut = partition( ENList, dim, nloc, nnodes, npartitions, 
-                         partition_method, decomp );
+    if(flArgs.count('g')){
+      sfc_partition(x, no_coords, vector<double>(), nparts, decomp);
+    }else{
+      partition( ENList, dim, nloc, nnodes, npartitions, 
+                 partition_method, decomp );
+    }
+    if(compare_metis)
+      partition( ENList, dim, nloc, nnodes, npartitions, 
+                 partition_method, metis_decomp );
   }
   
   if(flArgs.count('d')){
-    cout<<"Edge-cut: "<<edgecut<<endl;
+    print_partition_quality(flArgs.count('g') ? "SFC" : "METIS", ENList, dim, nloc, nnodes, decomp, nparts);
+    if(compare_metis)
+      print_partition_quality("METIS", ENList, dim, nloc, nnodes, metis_decomp, nparts);
   }
   
   // Process the partitioning
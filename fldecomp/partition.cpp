@@ -26,12 +26,18 @@
     USA
 */
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <iostream>
 #include <map>
 #include <vector>
 #include <set>
+#include <stdint.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "fmangle.h"
 
@@ -58,6 +64,68 @@ extern "C" { // This is the glue between METIS and fluidity
 #endif
 }
 
+namespace{
+  // Hilbert key of a point with n coordinates of b bits each, using
+  // Skilling's transform of the axes to the transposed Hilbert index
+  // (AIP Conf. Proc. 707, 381 (2004)), with the bits of the transposed
+  // index interleaved into a single key.
+  uint64_t HilbertKey(uint64_t* X, int b, int n){
+    const uint64_t M = ((uint64_t) 1) << (b - 1);
+    for(uint64_t Q = M;Q > 1;Q >>= 1){
+      const uint64_t P = Q - 1;
+      for(int i = 0;i < n;i++){
+        if(X[i] & Q){
+          X[0] ^= P;
+        }else{
+          const uint64_t t = (X[0] ^ X[i]) & P;
+          X[0] ^= t;
+          X[i] ^= t;
+        }
+      }
+    }
+    for(int i = 1;i < n;i++)
+      X[i] ^= X[i - 1];
+    uint64_t t = 0;
+    for(uint64_t Q = M;Q > 1;Q >>= 1){
+      if(X[n - 1] & Q)
+        t ^= Q - 1;
+    }
+    for(int i = 0;i < n;i++)
+      X[i] ^= t;
+
+    uint64_t key = 0;
+    for(int j = b - 1;j >= 0;j--){
+      for(int i = 0;i < n;i++)
+        key = (key << 1) | ((X[i] >> j) & 1);
+    }
+    return key;
+  }
+
+  // Sort (key, node) pairs. With OpenMP each thread sorts a block and the
+  // sorted blocks are merged pairwise.
+  void SortKeys(vector< pair<uint64_t, int> >& keys){
+#ifdef _OPENMP
+    const int nblocks = omp_get_max_threads();
+    if(nblocks > 1 && keys.size() > (size_t) 16*nblocks){
+      vector<size_t> bounds(nblocks + 1);
+      for(int i = 0;i <= nblocks;i++)
+        bounds[i] = (keys.size()*i)/nblocks;
+#pragma omp parallel for schedule(static, 1)
+      for(int i = 0;i < nblocks;i++)
+        sort(keys.begin() + bounds[i], keys.begin() + bounds[i + 1]);
+      for(int width = 1;width < nblocks;width *= 2){
+#pragma omp parallel for schedule(static, 1)
+        for(int i = 0;i < nblocks - width;i += 2*width)
+          inplace_merge(keys.begin() + bounds[i], keys.begin() + bounds[i + width],
+                        keys.begin() + bounds[min(i + 2*width, nblocks)]);
+      }
+      return;
+    }
+#endif
+    sort(keys.begin(), keys.end());
+  }
+}
+
 namespace Fluidity{
   int FormGraph(const vector<int>& ENList, const int& dim, const int& nloc, const int& nnodes,
                 vector<set<int> >& graph){
@@ -349,4 +417,106 @@ namespace Fluidity{
                 
     return partition(ENList, surface_nids, 3, nloc, nnodes, npartitions, partition_method, decomp);
   }
+
+  int sfc_partition(const vector<double> &x, int dim, const vector<double> &weights, int npartitions, vector<int> &decomp){
+    int nnodes = x.size()/dim;
+    assert(weights.empty() || (int) weights.size() == nnodes);
+
+    // Only curve through the directions the mesh spans, so that a planar
+    // mesh with a zeroed z-coordinate gets a 2D curve
+    double lower[3], width[3];
+    int axes[3], naxes=0;
+    for(int i=0;i<dim;i++){
+      double upper=x[i];
+      lower[i]=x[i];
+      for(int n=1;n<nnodes;n++){
+        lower[i] = min(lower[i], x[n*dim+i]);
+        upper = max(upper, x[n*dim+i]);
+      }
+      width[i] = upper-lower[i];
+      if(width[i]>0.0)
+        axes[naxes++] = i;
+    }
+
+    vector< pair<uint64_t, int> > keys(nnodes);
+    const int bits = naxes>0 ? min(63/naxes, 31) : 1;
+    const double cells = (double) ((((uint64_t) 1) << bits) - 1);
+#pragma omp parallel for schedule(static)
+    for(int n=0;n<nnodes;n++){
+      uint64_t X[3];
+      for(int i=0;i<naxes;i++)
+        X[i] = (uint64_t) ((x[n*dim+axes[i]]-lower[axes[i]])/width[axes[i]]*cells);
+      keys[n].first = naxes>0 ? HilbertKey(X, bits, naxes) : 0;
+      keys[n].second = n;
+    }
+    SortKeys(keys);
+
+    // Cut the curve into npartitions pieces of equal weight, assigning each
+    // node by the weight at its middle
+    double total_weight=0.0;
+    for(int n=0;n<nnodes;n++)
+      total_weight += weights.empty() ? 1.0 : weights[n];
+    decomp.resize(nnodes);
+    double weight=0.0;
+    for(int k=0;k<nnodes;k++){
+      int n = keys[k].second;
+      double w = weights.empty() ? 1.0 : weights[n];
+      decomp[n] = min((int) (npartitions*(weight+0.5*w)/total_weight), npartitions-1);
+      weight += w;
+    }
+
+    return 0;
+  }
+
+  int partition_quality(const vector<int> &ENList, const int& dim, int nloc, int nnodes, const vector<int> &decomp,
+                        int npartitions, int &halo_nodes, int &max_halo_nodes, double &imbalance){
+    vector< set<int> > graph;
+    int ret = FormGraph(ENList, dim, nloc, nnodes, graph);
+    if(ret != 0){
+      return ret;
+    }
+
+    // Each node is in the halo of every other partition that it neighbours
+    int edgecut=0;
+    vector<int> nodes(npartitions, 0), halo(npartitions, 0);
+    for(int i=0;i<nnodes;i++){
+      nodes[decomp[i]]++;
+      set<int> neighbour_partitions;
+      for(set<int>::const_iterator jt=graph[i].begin();jt!=graph[i].end();++jt){
+        int p = decomp[*jt-1];
+        if(p!=decomp[i]){
+          if(*jt-1>i)
+            edgecut++;
+          neighbour_partitions.insert(p);
+        }
+      }
+      for(set<int>::const_iterator jt=neighbour_partitions.begin();jt!=neighbour_partitions.end();++jt)
+        halo[*jt]++;
+    }
+
+    halo_nodes=0;
+    max_halo_nodes=0;
+    int max_nodes=0;
+    for(int p=0;p<npartitions;p++){
+      halo_nodes += halo[p];
+      max_halo_nodes = max(max_halo_nodes, halo[p]);
+      max_nodes = max(max_nodes, nodes[p]);
+    }
+    imbalance = ((double) max_nodes*npartitions)/nnodes;
+
+    return edgecut;
+  }
+
+  void print_partition_quality(const char *name, const vector<int> &ENList, const int& dim, int nloc, int nnodes,
+                               const vector<int> &decomp, int npartitions){
+    int halo_nodes, max_halo_nodes;
+    double imbalance;
+    int edgecut = partition_quality(ENList, dim, nloc, nnodes, decomp, npartitions, halo_nodes, max_halo_nodes, imbalance);
+    if(edgecut<0)
+      return;
+
+    cout<<name<<" edge-cut: "<<edgecut<<endl
+        <<name<<" halo nodes: "<<halo_nodes<<" (largest partition halo "<<max_halo_nodes<<")"<<endl
+        <<name<<" imbalance: "<<imbalance<<endl;
+  }
 }
@@ -0,0 +1,84 @@
+/*  Copyright (C) 2006 Imperial College London and others.
+    
+    Please see the AUTHORS file in the main source directory for a full list
+    of copyright holders.
+
+    Prof. C Pain
+    Applied Modelling and Computation Group
+    Department of Earth Science and Engineering
+    Imperial College London
+
+    amcgsoftware@imperial.ac.uk
+    
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation,
+    version 2.1 of the License.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+    USA
+*/
+
+#ifndef DETECTOR_MOTION_INDEX_H
+#define DETECTOR_MOTION_INDEX_H
+
+#include <map>
+#include <vector>
+
+#include "Element_Intersection.h"
+
+namespace Fluidity {
+
+  // Interface to the spatialindex time parameterised R-tree (TPR-tree), to
+  // index moving points. Each point has a position at time zero and a
+  // velocity interval, so that at time t it lies in the box
+  // [position + vlow * t, position + vhigh * t]. Queries return the points
+  // whose boxes intersect a fixed box at some time in a time window within
+  // [0, horizon]. Only two and three dimensions are supported.
+  class DetectorMotionIndex
+  {
+    public:
+      DetectorMotionIndex(const int& dim, const double& horizon);
+      ~DetectorMotionIndex();
+
+      // Insert npoints points with ids 1 to npoints. positions, vlow and
+      // vhigh are dim x npoints.
+      void SetInput(const double* positions, const double* vlow, const double* vhigh, const int& npoints);
+      void Query(const double* low, const double* high, const double& tStart, const double& tEnd);
+      void QueryOutput(int& npoints) const;
+      void GetOutput(int* ids) const;
+    protected:
+      int dim;
+      double horizon;
+      SpatialIndex::IStorageManager* storageManager;
+      SpatialIndex::StorageManager::IBuffer* storage;
+      SpatialIndex::ISpatialIndex* tprTree;
+      ElementListVisitor visitor;
+  };
+
+}
+
+extern std::map<int, Fluidity::DetectorMotionIndex*> detectorMotionIndex;
+
+extern "C" {
+#define cDetectorMotionIndexSetInput F77_FUNC(cdetector_motion_index_set_input, CDETECTOR_MOTION_INDEX_SET_INPUT)
+  void cDetectorMotionIndexSetInput(int* id, const int* dim, const double* horizon, const double* positions, const double* vlow, const double* vhigh, const int* npoints);
+
+#define cDetectorMotionIndexReset F77_FUNC(cdetector_motion_index_reset, CDETECTOR_MOTION_INDEX_RESET)
+  void cDetectorMotionIndexReset(const int* id);
+
+#define cDetectorMotionIndexQuery F77_FUNC(cdetector_motion_index_query, CDETECTOR_MOTION_INDEX_QUERY)
+  void cDetectorMotionIndexQuery(const int* id, const double* low, const double* high, const double* tStart, const double* tEnd, int* npoints);
+
+#define cDetectorMotionIndexGetOutput F77_FUNC(cdetector_motion_index_get_output, CDETECTOR_MOTION_INDEX_GET_OUTPUT)
+  void cDetectorMotionIndexGetOutput(const int* id, int* ids);
+}
+
+#endif
@@ -76,6 +76,7 @@
 
 #include "MeshDataStream.h"
 #include "Precision.h"
+#include "Simplex_Clipping.h"
 
 #define GEOM_REAL double
 
@@ -93,6 +94,9 @@ namespace Fluidity
   const unsigned long indexCapacity = 10;
   // Node leaf capacity in the rtree
   const unsigned long leafCapacity = 10;
+
+  // Largest number of nodes in an intersector input element
+  const int maxIntersectorLoc = 4;
   
   // Customised version of PyListVisitor class in
   // wrapper.cc in Rtree 0.4.1
@@ -156,6 +160,9 @@ namespace Fluidity
       void SetInput(const double*& positions, const int& nnodes, const int& dim,
                     const int*& enlist, const int& nelements, const int& loc);
       void SetTestElement(const double*& positions, const int& dim, const int& loc);
+      // As SetTestElement, but returns the intersecting elements in the
+      // caller's visitor. Safe to call from several threads at once.
+      void Find(const double* positions, const int& dim, const int& loc, ElementListVisitor& found) const;
       void QueryOutput(int& nelms) const;
       void GetOutput(int& id, const int& index) const;
     protected:
@@ -186,8 +193,10 @@ namespace Fluidity
     protected:
       ElementIntersector();
       
-      double* positionsA;
-      double* positionsB;
+      // Each intersector keeps its own copy of its input, so distinct
+      // intersectors may be driven concurrently
+      double positionsA[3 * maxIntersectorLoc];
+      double positionsB[3 * maxIntersectorLoc];
       int loc;
       int dim;
       int exactness;
@@ -252,6 +261,10 @@ namespace Fluidity
       typedef Wm4::Intersector<GEOM_REAL, Vector2> Intersector2d;
 
     protected:
+       // Triangles are clipped into polygon, without any allocation.
+       // intersection is only used for quads.
+       double polygon[2 * (maxClippedPolygonSize + 3)];
+       int nvertices;
        Intersector2d* intersection;
   };
 
@@ -343,6 +356,9 @@ namespace Fluidity
       typedef Wm4::Tetrahedron3<GEOM_REAL> Tetrahedron3;
       typedef Wm4::Vector3<GEOM_REAL> Vector3;
     protected:
+      // The tetrahedra are clipped into tets, without any allocation.
+      // intersection and volumes are only used if tets overflows.
+      double tets[12 * maxClippedTetrahedra], work[12 * maxClippedTetrahedra];
       IntrTetrahedron3Tetrahedron3* intersection;
       std::vector<GEOM_REAL>* volumes;
       int nodes, elements;
@@ -388,6 +404,37 @@ namespace Fluidity
   };
 }
 
+namespace Fluidity
+{
+  // Create an intersector for elements of dimension dim, using CGAL if
+  // exact is 1. The caller owns the result.
+  ElementIntersector* NewElementIntersector(const int& dim, const int& exact);
+
+  // Supermesh built by SupermeshElements: positions are dim x nnodes,
+  // node-major, and enlist counts from one. Each supermesh element
+  // records the elements of A and B (counting from one) it lies in.
+  struct SupermeshOutput
+  {
+    std::vector<double> positions;
+    std::vector<int> enlist;
+    std::vector<int> parentsA, parentsB;
+  };
+
+  // Intersect each element of mesh B with the elements of mesh A listed
+  // for it in the CSR map (mapStarts has nelementsB + 1 entries and, like
+  // map, counts from one). Positions are dim x nnodes, node-major, and
+  // enlists count from one. The elements of B are shared out between
+  // OpenMP threads, each with its own intersector, and the pieces are
+  // concatenated in element order, so the output does not depend on the
+  // number of threads. Exact intersection is always done serially, as
+  // CGAL is not thread safe.
+  void SupermeshElements(const int& dim, const int& exact,
+                         const double* positionsA, const int* enlistA, const int& locA,
+                         const double* positionsB, const int* enlistB, const int& locB, const int& nelementsB,
+                         const int* mapStarts, const int* map,
+                         SupermeshOutput& output);
+}
+
 extern Fluidity::ElementIntersector* elementIntersector;
 
 extern Fluidity::ElementIntersectionFinder elementIntersectionFinder;
@@ -415,6 +462,37 @@ extern "C"
 #define cIntersectorGetOutput F77_FUNC(cintersector_get_output, CINTERSECTOR_GET_OUTPUT)
   void cIntersectorGetOutput(const int* nnodes, const int* nelms, const int* dim, const int* loc, double* positions, int* enlist);
 
+  // Handle-based versions of the above, each handle owning its own
+  // intersector so that several may be used at once, e.g. one per thread
+
+#define cIntersectorCreate F77_FUNC(cintersector_create, CINTERSECTOR_CREATE)
+  void cIntersectorCreate(void** handle, const int* dim, const int* exact);
+
+#define cIntersectorDestroy F77_FUNC(cintersector_destroy, CINTERSECTOR_DESTROY)
+  void cIntersectorDestroy(void** handle);
+
+#define cIntersectorHandleSetInput F77_FUNC(cintersector_handle_set_input, CINTERSECTOR_HANDLE_SET_INPUT)
+  void cIntersectorHandleSetInput(void** handle, double* positionsA, double* positionsB, const int* dim, const int* loc);
+
+#define cIntersectorHandleDrive F77_FUNC(cintersector_handle_drive, CINTERSECTOR_HANDLE_DRIVE)
+  void cIntersectorHandleDrive(void** handle);
+
+#define cIntersectorHandleQuery F77_FUNC(cintersector_handle_query, CINTERSECTOR_HANDLE_QUERY)
+  void cIntersectorHandleQuery(void** handle, int* nnodes, int* nelms);
+
+#define cIntersectorHandleGetOutput F77_FUNC(cintersector_handle_get_output, CINTERSECTOR_HANDLE_GET_OUTPUT)
+  void cIntersectorHandleGetOutput(void** handle, const int* nnodes, const int* nelms, const int* dim, const int* loc, double* positions, int* enlist);
+
+#define cSupermeshElements F77_FUNC(csupermesh_elements, CSUPERMESH_ELEMENTS)
+  void cSupermeshElements(const int* dim, const int* exact,
+                          const double* positionsA, const int* enlistA, const int* locA,
+                          const double* positionsB, const int* enlistB, const int* locB, const int* nelementsB,
+                          const int* mapStarts, const int* map,
+                          void** handle, int* nnodes, int* nelms);
+
+#define cSupermeshElementsGetOutput F77_FUNC(csupermesh_elements_get_output, CSUPERMESH_ELEMENTS_GET_OUTPUT)
+  void cSupermeshElementsGetOutput(void** handle, double* positions, int* enlist, int* parentsA, int* parentsB);
+
 #define cIntersectionFinderReset F77_FUNC(cintersection_finder_reset, CINTERSECTION_FINDER_RESET)
   void cIntersectionFinderReset(int* ntests);
 
@@ -429,6 +507,24 @@ extern "C"
 
 #define cIntersectionFinderGetOutput F77_FUNC(cintersection_finder_get_output, CINTSERSECTION_FINDER_GET_OUTPUT)
   void cIntersectionFinderGetOutput(int* id, const int* index);
+
+#define cIntersectionFinderCreate F77_FUNC(cintersection_finder_create, CINTERSECTION_FINDER_CREATE)
+  void cIntersectionFinderCreate(void** handle);
+
+#define cIntersectionFinderDestroy F77_FUNC(cintersection_finder_destroy, CINTERSECTION_FINDER_DESTROY)
+  void cIntersectionFinderDestroy(void** handle);
+
+#define cIntersectionFinderHandleSetInput F77_FUNC(cintersection_finder_handle_set_input, CINTERSECTION_FINDER_HANDLE_SET_INPUT)
+  void cIntersectionFinderHandleSetInput(void** handle, const double* positions, const int* enlist, const int* dim, const int* loc, const int* nnodes, const int* nelements);
+
+#define cIntersectionFinderHandleFind F77_FUNC(cintersection_finder_handle_find, CINTERSECTION_FINDER_HANDLE_FIND)
+  void cIntersectionFinderHandleFind(void** handle, const double* positions, const int* dim, const int* loc);
+
+#define cIntersectionFinderHandleQueryOutput F77_FUNC(cintersection_finder_handle_query_output, CINTERSECTION_FINDER_HANDLE_QUERY_OUTPUT)
+  void cIntersectionFinderHandleQueryOutput(void** handle, int* nelms);
+
+#define cIntersectionFinderHandleGetOutput F77_FUNC(cintersection_finder_handle_get_output, CINTERSECTION_FINDER_HANDLE_GET_OUTPUT)
+  void cIntersectionFinderHandleGetOutput(void** handle, int* id, const int* index);
 }
 
 #endif
@@ -0,0 +1,142 @@
+/*  Copyright (C) 2006 Imperial College London and others.
+    
+    Please see the AUTHORS file in the main source directory for a full list
+    of copyright holders.
+
+    Prof. C Pain
+    Applied Modelling and Computation Group
+    Department of Earth Science and Engineering
+    Imperial College London
+
+    amcgsoftware@imperial.ac.uk
+    
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation,
+    version 2.1 of the License.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+    USA
+*/
+
+#ifndef GMSH_READER_H
+#define GMSH_READER_H
+
+#include "confdefs.h"
+
+#include <string>
+#include <vector>
+
+namespace Fluidity{
+
+  enum GMSHReadError{
+    GMSH_READ_SUCCESS = 0,
+    GMSH_READ_FILE_NOT_FOUND = -1,
+    GMSH_READ_FILE_INVALID = -2,
+    GMSH_READ_UNSUPPORTED_VERSION = -3,
+    GMSH_READ_UNSUPPORTED_ELEMENT = -4,
+    GMSH_READ_COLUMN_COUNT_MISMATCH = -5
+  };
+
+  enum GMSHFormat{
+    GMSH_FORMAT_ASCII = 0,
+    GMSH_FORMAT_BINARY = 1
+  };
+
+  //* Nodes read from a GMSH file
+  /** The position of node i is x[3 * i:3 * i + 3].
+    */
+  struct GMSHNodes{
+    std::vector<int> ids;
+    std::vector<double> x;
+  };
+
+  //* Elements, including faces, read from a GMSH file
+  /** The tags of element i are tags[tag_starts[i]:tag_starts[i + 1]] and its
+    * nodes are nodes[node_starts[i]:node_starts[i + 1]], in GMSH order.
+    */
+  struct GMSHElements{
+    std::vector<int> ids, types, tag_starts, tags, node_starts, nodes;
+  };
+
+  //* Number of nodes of a GMSH element type, or -1 if the type is not supported
+  int GMSHElementNodeCount(int type);
+
+  //* Reader for version 2 GMSH mesh files, ASCII or binary
+  /** The file is memory mapped, and its sections located, on Open. Records
+    * are then parsed in parallel chunks by OpenMP threads. Each process
+    * reads a whole file: parallel runs still read the per-process files
+    * written by fldecomp or flredecomp.
+    */
+  class GMSHReader{
+    public:
+      GMSHReader();
+      ~GMSHReader();
+
+      GMSHReadError Open(const std::string& filename);
+      void Close();
+
+      GMSHFormat Format() const;
+      int NodeCount() const;
+      int ElementCount() const;
+      //* Whether the file has a column_ids $NodeData section
+      bool HasColumnIDs() const;
+
+      GMSHReadError ReadNodes(GMSHNodes& nodes) const;
+      GMSHReadError ReadElements(GMSHElements& elements) const;
+      //* Read the column ID of every node, in file order. The section must
+      //* have one entry per node.
+      GMSHReadError ReadColumnIDs(std::vector<int>& columns) const;
+
+    private:
+      struct ElementBlock{
+        size_t begin;
+        int first, count, type, ntags;
+      };
+
+      GMSHReadError Locate();
+      GMSHReadError LocateNodeData(size_t& pos);
+
+      const char* data;
+      size_t size;
+      bool mapped;
+      std::vector<char> buffer;
+
+      GMSHFormat format;
+      int nnodes, nelements, ncolumns, ncolumn_components;
+      size_t nodes_begin, nodes_end, elements_begin, elements_end, columns_begin, columns_end;
+      std::vector<ElementBlock> blocks;
+  };
+
+  struct GMSHMeshData{
+    GMSHFormat format;
+    GMSHNodes nodes;
+    std::vector<int> columns;
+    GMSHElements elements;
+  };
+}
+
+extern Fluidity::GMSHMeshData* readGMSHData;
+
+extern "C"{
+#define cGMSHReaderReset F77_FUNC(cgmsh_reader_reset, CGMSH_READER_RESET)
+  void cGMSHReaderReset();
+
+#define cGMSHReaderSetInput F77_FUNC(cgmsh_reader_set_input, CGMSH_READER_SET_INPUT)
+  int cGMSHReaderSetInput(char* filename, int* filename_len, int* format, int* nnodes, int* nelements,
+    int* ntags, int* nelement_nodes, int* have_columns);
+
+#define cGMSHReaderGetOutput F77_FUNC(cgmsh_reader_get_output, CGMSH_READER_GET_OUTPUT)
+  void cGMSHReaderGetOutput(int* nnodes, int* nelements, int* ntags, int* nelement_nodes,
+    int* node_ids, double* x, int* columns, int* types, int* tag_starts, int* tags,
+    int* node_starts, int* element_nodes);
+}
+
+#endif
@@ -59,8 +59,33 @@ namespace Fluidity{
     HALO_READ_FILE_INVALID = -2,
   };
 
+  enum HaloFormat{
+    HALO_FORMAT_XML = 0,
+    HALO_FORMAT_BINARY = 1
+  };
+
+  //* Halo data for one level
+  /** Only processes actually sent to or received from are stored, in
+    * increasing order. The sends to procs[i] are
+    * sends[send_starts[i]:send_starts[i + 1]], and similarly for receives.
+    */
+  struct HaloLevel{
+    int npnodes;
+    std::vector<int> procs, send_starts, sends, recv_starts, recvs;
+  };
+
   //* Read halo information
-  /** Read from a halo file.
+  /** Read from a halo file, in either the XML or the binary format.
+    * \param filename Halo file name
+    * \param process The process number
+    * \param nprocs The number of processes
+    * \param halos Halo data, by level
+    * \return 0 on success, non-zero on failure
+    */
+  HaloReadError ReadHalos(const std::string& filename, int& process, int& nprocs, std::map<int, HaloLevel>& halos);
+
+  //* Read halo information
+  /** Read from a halo file, with the sends and receives for every process.
     * \param filename Halo file name
     * \param process The process number
     * \param nprocs The number of processes
@@ -73,6 +98,17 @@ namespace Fluidity{
 
   //* Write halo information.
   /** Write to a halo file.
+    * \param filename Halo file name
+    * \param process The process number
+    * \param nprocs The number of processes
+    * \param halos Halo data, by level
+    * \param format File format
+    * \return 0 on success, non-zero on failure
+    */
+  int WriteHalos(const std::string& filename, const unsigned int& process, const unsigned int& nprocs, const std::map<int, HaloLevel>& halos, HaloFormat format);
+
+  //* Write halo information.
+  /** Write to a halo file, in the format set by SetHaloWriteFormat.
     * \param filename Halo file name
     * \param npnodes Number of private nodes, by tag
     * \param send Sends, by tag and process
@@ -80,11 +116,13 @@ namespace Fluidity{
     * \return 0 on success, non-zero on failure
     */
   int WriteHalos(const std::string& filename, const unsigned int& process, const unsigned int& nprocs, const std::map<int, int>& npnodes, const std::map<int, std::vector<std::vector<int> > >& send, const std::map<int, std::vector<std::vector<int> > >& recv);
+
+  //* Set the format of halo files written without an explicit format. XML by default.
+  void SetHaloWriteFormat(HaloFormat format);
   
   struct HaloData{
       int process, nprocs;
-      std::map<int, int> npnodes;
-      std::map<int, std::vector<std::vector<int> > > send, recv;
+      std::map<int, HaloLevel> halos;
   };
 }
 
@@ -117,6 +155,9 @@ extern "C"{
   
 #define cHaloWriterWrite F77_FUNC(chalo_writer_write, CHALO_WRITER_WRITE)
   int cHaloWriterWrite(char* filename, int* filename_len);
+
+#define cHaloWriterSetFormat F77_FUNC(chalo_writer_set_format, CHALO_WRITER_SET_FORMAT)
+  void cHaloWriterSetFormat(int* format);
 }
 
 #endif
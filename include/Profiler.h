@@ -45,6 +45,7 @@ class Profiler{
   Profiler();
   ~Profiler();
 
+  void add(const std::string&, double);
   double get(const std::string&) const;
   void print() const;
   void tic(const std::string&);
@@ -0,0 +1,473 @@
+/*  Copyright (C) 2006 Imperial College London and others.
+
+    Please see the AUTHORS file in the main source directory for a full list
+    of copyright holders.
+
+    Prof. C Pain
+    Applied Modelling and Computation Group
+    Department of Earth Science and Engineering
+    Imperial College London
+
+    amcgsoftware@imperial.ac.uk
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation,
+    version 2.1 of the License.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+    USA
+*/
+
+#ifndef SIMPLEX_CLIPPING_H
+#define SIMPLEX_CLIPPING_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// Intersection of two linear simplices by clipping one against the faces of
+// the other, using only fixed size buffers. Vertices are stored with their
+// coordinates contiguous, i.e. as a Fortran dim x loc array.
+namespace Fluidity
+{
+  // Maximum number of vertices of the intersection of two triangles
+  const int maxClippedPolygonSize = 6;
+  // Buffer size for the tetrahedra produced by ClipTetrahedra, as in
+  // femtools/Tetrahedron_intersection.F90
+  const int maxClippedTetrahedra = 150;
+
+  inline double ClipTolerance()
+  {
+    return std::numeric_limits<double>::epsilon();
+  }
+
+  // Whether the axis aligned bounding boxes of the simplices a and b, with
+  // loc vertices each, overlap
+  inline bool BoundingBoxesOverlap(int dim, int loc, const double* a, const double* b)
+  {
+    for(int i = 0;i < dim;i++){
+      double aMin = a[i], aMax = a[i], bMin = b[i], bMax = b[i];
+      for(int j = 1;j < loc;j++){
+        aMin = std::min(aMin, a[j * dim + i]);
+        aMax = std::max(aMax, a[j * dim + i]);
+        bMin = std::min(bMin, b[j * dim + i]);
+        bMax = std::max(bMax, b[j * dim + i]);
+      }
+      if(aMax < bMin or bMax < aMin){
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // Separating axis test for the triangles a and b: whether the line
+  // through an edge of one has the other entirely on its far side
+  inline bool TrianglesSeparated(const double* a, const double* b)
+  {
+    const double* triangles[2] = {a, b};
+    for(int t = 0;t < 2;t++){
+      const double* u = triangles[t];
+      const double* v = triangles[1 - t];
+      for(int edge = 0;edge < 3;edge++){
+        const double* p = u + 2 * edge;
+        const double* q = u + 2 * ((edge + 1) % 3);
+        const double* r = u + 2 * ((edge + 2) % 3);
+        double nx = p[1] - q[1], ny = q[0] - p[0];
+        double side = nx * (r[0] - p[0]) + ny * (r[1] - p[1]);
+        bool separated = true;
+        for(int i = 0;i < 3 and separated;i++){
+          separated = side * (nx * (v[2 * i] - p[0]) + ny * (v[2 * i + 1] - p[1])) <= 0.0;
+        }
+        if(separated){
+          return true;
+        }
+      }
+    }
+
+    return false;
+  }
+
+  // Intersect the intervals a and b. Returns the number of vertices of the
+  // intersection (0 or 2), which are written to c.
+  inline int ClipIntervals(const double* a, const double* b, double* c)
+  {
+    double aMin = std::min(a[0], a[1]), aMax = std::max(a[0], a[1]);
+    double bMin = std::min(b[0], b[1]), bMax = std::max(b[0], b[1]);
+    c[0] = std::max(aMin, bMin);
+    c[1] = std::min(aMax, bMax);
+
+    return c[1] - c[0] > ClipTolerance() ? 2 : 0;
+  }
+
+  namespace SimplexClippingDetail
+  {
+    // Distance of x from the line through p with unit normal (nx, ny),
+    // snapped to 0 within tolerance
+    inline double SignedDistance(double nx, double ny, const double* p, const double* x, double tolerance)
+    {
+      double d = nx * (x[0] - p[0]) + ny * (x[1] - p[1]);
+      return fabs(d) <= tolerance ? 0.0 : d;
+    }
+
+    // Remove consecutive (cyclically) coincident vertices from the polygon
+    // of n vertices. Returns the new number of vertices.
+    inline int RemoveDuplicateVertices(double* polygon, int n, double tolerance)
+    {
+      int nKept = 0;
+      for(int i = 0;i < n;i++){
+        const double* x = polygon + 2 * i;
+        if(nKept > 0 and fabs(x[0] - polygon[2 * (nKept - 1)]) <= tolerance
+                     and fabs(x[1] - polygon[2 * (nKept - 1) + 1]) <= tolerance){
+          continue;
+        }
+        polygon[2 * nKept] = x[0];
+        polygon[2 * nKept + 1] = x[1];
+        nKept++;
+      }
+      while(nKept > 1 and fabs(polygon[2 * (nKept - 1)] - polygon[0]) <= tolerance
+                      and fabs(polygon[2 * (nKept - 1) + 1] - polygon[1]) <= tolerance){
+        nKept--;
+      }
+
+      return nKept;
+    }
+  }
+
+  // Intersect the triangles a and b with Sutherland-Hodgman clipping. Returns
+  // the number of vertices of the convex intersection polygon, written
+  // anticlockwise to polygon (room for maxClippedPolygonSize + 3 vertices),
+  // or 0 if the intersection is empty or degenerate.
+  inline int ClipTriangles(const double* a, const double* b, double* polygon)
+  {
+    if(!BoundingBoxesOverlap(2, 3, a, b) or TrianglesSeparated(a, b)){
+      return 0;
+    }
+
+    // Orientation of b
+    double orientation = (b[2] - b[0]) * (b[5] - b[1]) - (b[3] - b[1]) * (b[4] - b[0]);
+    if(orientation == 0.0){
+      return 0;
+    }
+    double sign = orientation > 0.0 ? 1.0 : -1.0;
+
+    // Vertices within this distance of an edge of b are on it, and
+    // vertices this close together are the same vertex
+    double scale = 0.0;
+    for(int i = 0;i < 6;i++){
+      scale = std::max(scale, std::max(fabs(a[i]), fabs(b[i])));
+    }
+    double tolerance = 16.0 * ClipTolerance() * std::max(scale, 1.0);
+
+    double work[2][2 * (maxClippedPolygonSize + 3)];
+    double* in = work[0];
+    double* out = polygon;
+    int nIn = 3;
+    if((a[2] - a[0]) * (a[5] - a[1]) - (a[3] - a[1]) * (a[4] - a[0]) >= 0.0){
+      memcpy(in, a, 6 * sizeof(double));
+    }else{
+      // Keep the output anticlockwise
+      memcpy(in, a, 2 * sizeof(double));
+      memcpy(in + 2, a + 4, 2 * sizeof(double));
+      memcpy(in + 4, a + 2, 2 * sizeof(double));
+    }
+
+    for(int edge = 0;edge < 3 and nIn > 0;edge++){
+      const double* p = b + 2 * edge;
+      const double* q = b + 2 * ((edge + 1) % 3);
+      // Unit inward normal of this edge of b
+      double nx = -sign * (q[1] - p[1]), ny = sign * (q[0] - p[0]);
+      double length = sqrt(nx * nx + ny * ny);
+      nx /= length;
+      ny /= length;
+
+      out = (edge == 2) ? polygon : work[(edge + 1) % 2];
+      int nOut = 0;
+      double dPrev = SimplexClippingDetail::SignedDistance(nx, ny, p, in + 2 * (nIn - 1), tolerance);
+      for(int i = 0;i < nIn;i++){
+        const double* prev = in + 2 * ((i + nIn - 1) % nIn);
+        const double* cur = in + 2 * i;
+        double d = SimplexClippingDetail::SignedDistance(nx, ny, p, cur, tolerance);
+        // Only a strict change of side crosses the edge; a vertex on the
+        // edge is kept as it is
+        if((d > 0.0 and dPrev < 0.0) or (d < 0.0 and dPrev > 0.0)){
+          double w = dPrev / (dPrev - d);
+          out[2 * nOut] = prev[0] + w * (cur[0] - prev[0]);
+          out[2 * nOut + 1] = prev[1] + w * (cur[1] - prev[1]);
+          nOut++;
+        }
+        if(d >= 0.0){
+          out[2 * nOut] = cur[0];
+          out[2 * nOut + 1] = cur[1];
+          nOut++;
+        }
+        dPrev = d;
+      }
+      in = out;
+      nIn = SimplexClippingDetail::RemoveDuplicateVertices(out, nOut, tolerance);
+    }
+
+    if(nIn < 3){
+      return 0;
+    }
+    if(in != polygon){
+      memcpy(polygon, in, 2 * nIn * sizeof(double));
+    }
+
+    return nIn;
+  }
+
+  struct ClipPlane
+  {
+    double normal[3];
+    double c;
+  };
+
+  // Outward facing planes of the faces of the tetrahedron t, plane i
+  // passing through vertex i. See get_planes_tet in
+  // femtools/Tetrahedron_intersection.F90.
+  inline void TetrahedronPlanes(const double* t, ClipPlane* planes)
+  {
+    double e10[3], e20[3], e30[3], e21[3], e31[3];
+    for(int i = 0;i < 3;i++){
+      e10[i] = t[3 + i] - t[i];
+      e20[i] = t[6 + i] - t[i];
+      e30[i] = t[9 + i] - t[i];
+      e21[i] = t[6 + i] - t[3 + i];
+      e31[i] = t[9 + i] - t[3 + i];
+    }
+    const double* u[4] = {e20, e10, e30, e21};
+    const double* v[4] = {e10, e30, e20, e31};
+    for(int p = 0;p < 4;p++){
+      double* n = planes[p].normal;
+      n[0] = u[p][1] * v[p][2] - u[p][2] * v[p][1];
+      n[1] = u[p][2] * v[p][0] - u[p][0] * v[p][2];
+      n[2] = u[p][0] * v[p][1] - u[p][1] * v[p][0];
+      double norm = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      for(int i = 0;i < 3;i++){
+        n[i] /= norm;
+      }
+    }
+    if(e10[0] * planes[3].normal[0] + e10[1] * planes[3].normal[1] + e10[2] * planes[3].normal[2] < 0.0){
+      for(int p = 0;p < 4;p++){
+        for(int i = 0;i < 3;i++){
+          planes[p].normal[i] = -planes[p].normal[i];
+        }
+      }
+    }
+    for(int p = 0;p < 4;p++){
+      planes[p].c = planes[p].normal[0] * t[3 * p] + planes[p].normal[1] * t[3 * p + 1] + planes[p].normal[2] * t[3 * p + 2];
+    }
+  }
+
+  inline double TetrahedronVolume(const double* t)
+  {
+    double a[3], b[3], c[3];
+    for(int i = 0;i < 3;i++){
+      a[i] = t[i] - t[9 + i];
+      b[i] = t[3 + i] - t[9 + i];
+      c[i] = t[6 + i] - t[9 + i];
+    }
+    return (a[0] * (b[1] * c[2] - b[2] * c[1])
+          + a[1] * (b[2] * c[0] - b[0] * c[2])
+          + a[2] * (b[0] * c[1] - b[1] * c[0])) / 6.0;
+  }
+
+  namespace SimplexClippingDetail
+  {
+    inline void Interpolate(const double* p, double dp, const double* n, double dn, double* out)
+    {
+      double invdiff = 1.0 / (dp - dn);
+      double w0 = -dn * invdiff, w1 = dp * invdiff;
+      for(int i = 0;i < 3;i++){
+        out[i] = w0 * p[i] + w1 * n[i];
+      }
+    }
+
+    inline double* Append(double* tets, int& ntets)
+    {
+      if(ntets >= maxClippedTetrahedra){
+        return NULL;
+      }
+      return tets + 12 * ntets++;
+    }
+
+    // Clip tet against plane (negative side is kept), appending the pieces
+    // to tets. A port of clip in femtools/Tetrahedron_intersection.F90.
+    // Returns false if tets is full.
+    inline bool ClipTetrahedron(const ClipPlane& plane, const double* tet, double* tets, int& ntets)
+    {
+      double d[4];
+      int neg[4], pos[4], zer[4];
+      int nneg = 0, npos = 0, nzer = 0;
+      for(int i = 0;i < 4;i++){
+        d[i] = plane.normal[0] * tet[3 * i] + plane.normal[1] * tet[3 * i + 1] + plane.normal[2] * tet[3 * i + 2] - plane.c;
+        if(fabs(d[i]) < ClipTolerance()){
+          zer[nzer++] = i;
+        }else if(d[i] < 0.0){
+          neg[nneg++] = i;
+        }else{
+          pos[npos++] = i;
+        }
+      }
+
+      if(nneg == 0){
+        return true;
+      }
+      double* out;
+      if(npos == 0){
+        if(!(out = Append(tets, ntets))) return false;
+        memcpy(out, tet, 12 * sizeof(double));
+        return true;
+      }
+
+#define V(t, i) ((t) + 3 * (i))
+      double tmp[4][3];
+      if(npos == 3){
+        // +++-
+        if(!(out = Append(tets, ntets))) return false;
+        memcpy(out, tet, 12 * sizeof(double));
+        for(int i = 0;i < 3;i++){
+          Interpolate(V(tet, pos[i]), d[pos[i]], V(tet, neg[0]), d[neg[0]], V(out, pos[i]));
+        }
+      }else if(npos == 2 and nneg == 2){
+        // ++--
+        for(int i = 0;i < 2;i++){
+          Interpolate(V(tet, pos[i]), d[pos[i]], V(tet, neg[0]), d[neg[0]], tmp[i]);
+          Interpolate(V(tet, pos[i]), d[pos[i]], V(tet, neg[1]), d[neg[1]], tmp[i + 2]);
+        }
+        if(!(out = Append(tets, ntets))) return false;
+        memcpy(out, tet, 12 * sizeof(double));
+        memcpy(V(out, pos[0]), tmp[2], 3 * sizeof(double));
+        memcpy(V(out, pos[1]), tmp[1], 3 * sizeof(double));
+
+        if(!(out = Append(tets, ntets))) return false;
+        memcpy(V(out, 0), V(tet, neg[1]), 3 * sizeof(double));
+        memcpy(V(out, 1), tmp[3], 3 * sizeof(double));
+        memcpy(V(out, 2), tmp[2], 3 * sizeof(double));
+        memcpy(V(out, 3), tmp[1], 3 * sizeof(double));
+
+        if(!(out = Append(tets, ntets))) return false;
+        memcpy(V(out, 0), V(tet, neg[0]), 3 * sizeof(double));
+        memcpy(V(out, 1), tmp[0], 3 * sizeof(double));
+        memcpy(V(out, 2), tmp[1], 3 * sizeof(double));
+        memcpy(V(out, 3), tmp[2], 3 * sizeof(double));
+      }else if(npos == 2){
+        // ++-0
+        if(!(out = Append(tets, ntets))) return false;
+        memcpy(out, tet, 12 * sizeof(double));
+        for(int i = 0;i < 2;i++){
+          Interpolate(V(tet, pos[i]), d[pos[i]], V(tet, neg[0]), d[neg[0]], V(out, pos[i]));
+        }
+      }else if(nneg == 3){
+        // +---
+        for(int i = 0;i < 3;i++){
+          Interpolate(V(tet, pos[0]), d[pos[0]], V(tet, neg[i]), d[neg[i]], tmp[i]);
+        }
+        if(!(out = Append(tets, ntets))) return false;
+        memcpy(out, tet, 12 * sizeof(double));
+        memcpy(V(out, pos[0]), tmp[0], 3 * sizeof(double));
+
+        if(!(out = Append(tets, ntets))) return false;
+        memcpy(V(out, 0), tmp[0], 3 * sizeof(double));
+        memcpy(V(out, 1), V(tet, neg[1]), 3 * sizeof(double));
+        memcpy(V(out, 2), V(tet, neg[2]), 3 * sizeof(double));
+        memcpy(V(out, 3), tmp[1], 3 * sizeof(double));
+
+        if(!(out = Append(tets, ntets))) return false;
+        memcpy(V(out, 0), V(tet, neg[2]), 3 * sizeof(double));
+        memcpy(V(out, 1), tmp[1], 3 * sizeof(double));
+        memcpy(V(out, 2), tmp[2], 3 * sizeof(double));
+        memcpy(V(out, 3), tmp[0], 3 * sizeof(double));
+      }else if(nneg == 2){
+        // +--0
+        for(int i = 0;i < 2;i++){
+          Interpolate(V(tet, pos[0]), d[pos[0]], V(tet, neg[i]), d[neg[i]], tmp[i]);
+        }
+        if(!(out = Append(tets, ntets))) return false;
+        memcpy(out, tet, 12 * sizeof(double));
+        memcpy(V(out, pos[0]), tmp[0], 3 * sizeof(double));
+
+        if(!(out = Append(tets, ntets))) return false;
+        memcpy(V(out, 0), tmp[1], 3 * sizeof(double));
+        memcpy(V(out, 1), V(tet, zer[0]), 3 * sizeof(double));
+        memcpy(V(out, 2), V(tet, neg[1]), 3 * sizeof(double));
+        memcpy(V(out, 3), tmp[0], 3 * sizeof(double));
+      }else{
+        // +-00
+        if(!(out = Append(tets, ntets))) return false;
+        memcpy(out, tet, 12 * sizeof(double));
+        Interpolate(V(tet, pos[0]), d[pos[0]], V(tet, neg[0]), d[neg[0]], V(out, pos[0]));
+      }
+#undef V
+
+      return true;
+    }
+  }
+
+  // Intersect the tetrahedra a and b by clipping a against the planes of the
+  // faces of b. The intersection is returned as positively oriented
+  // tetrahedra of non-negligible volume in tets, which needs room for
+  // maxClippedTetrahedra. work must be the same size. Returns the number of
+  // tetrahedra, or -1 if the buffers overflowed.
+  inline int ClipTetrahedra(const double* a, const ClipPlane* planesB, double* tets, double* work)
+  {
+    // Separating axis test on the faces of b
+    for(int p = 0;p < 4;p++){
+      bool separated = true;
+      for(int i = 0;i < 4 and separated;i++){
+        separated = planesB[p].normal[0] * a[3 * i] + planesB[p].normal[1] * a[3 * i + 1]
+                  + planesB[p].normal[2] * a[3 * i + 2] - planesB[p].c > -ClipTolerance();
+      }
+      if(separated){
+        return 0;
+      }
+    }
+
+    int ntets = 1;
+    memcpy(tets, a, 12 * sizeof(double));
+
+    double* in = tets;
+    double* out = work;
+    for(int p = 0;p < 4 and ntets > 0;p++){
+      int nout = 0;
+      for(int t = 0;t < ntets;t++){
+        if(!SimplexClippingDetail::ClipTetrahedron(planesB[p], in + 12 * t, out, nout)){
+          return -1;
+        }
+      }
+      std::swap(in, out);
+      ntets = nout;
+    }
+
+    // Orient and drop slivers
+    int nkept = 0;
+    for(int t = 0;t < ntets;t++){
+      double* tet = in + 12 * t;
+      double vol = TetrahedronVolume(tet);
+      if(vol < 0.0){
+        for(int i = 0;i < 3;i++){
+          std::swap(tet[i], tet[3 + i]);
+        }
+        vol = -vol;
+      }
+      if(vol > ClipTolerance()){
+        memmove(tets + 12 * nkept, tet, 12 * sizeof(double));
+        nkept++;
+      }
+    }
+
+    return nkept;
+  }
+}
+
+#endif
@@ -49,6 +49,7 @@
 #include <string>
 #include <vector>
 #include "vtk.h"
+#include "GMSH_Reader.h"
 #include "Halos_IO.h"
 #include "fmangle.h"
 #include "partition.h"
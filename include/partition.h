@@ -48,6 +48,22 @@ namespace Fluidity{
 
   int partition(const std::vector<int> &ENList, const std::vector<int> &surface_nids, int nloc, int nnodes,
                 std::vector<int>& npartitions, int partition_method, std::vector<int> &decomp);
+
+  // Geometric partitioning: cut a Hilbert curve through the nodes x (dim x
+  // nnodes) into npartitions pieces of equal weight. weights may be empty,
+  // for unit node weights.
+  int sfc_partition(const std::vector<double> &x, int dim, const std::vector<double> &weights,
+                    int npartitions, std::vector<int> &decomp);
+
+  // Returns the edge-cut of the node partitioning decomp (numbered from
+  // zero), with the total and largest per partition number of halo nodes,
+  // and the largest partition size relative to the mean.
+  int partition_quality(const std::vector<int> &ENList, const int& dim, int nloc, int nnodes,
+                        const std::vector<int> &decomp, int npartitions,
+                        int &halo_nodes, int &max_halo_nodes, double &imbalance);
+
+  void print_partition_quality(const char *name, const std::vector<int> &ENList, const int& dim, int nloc,
+                               int nnodes, const std::vector<int> &decomp, int npartitions);
 }
               
 #endif
@@ -73,6 +73,11 @@
 #define PetscObjectReferenceWrapper(x, ierr) PetscObjectReference(x%v, ierr)
 #endif
 #if (PETSC_VERSION_MAJOR==3 && PETSC_VERSION_MINOR<8)
+#define PetscObjectGetReferenceWrapper(x, cnt, ierr) PetscObjectGetReference(x, cnt, ierr)
+#else
+#define PetscObjectGetReferenceWrapper(x, cnt, ierr) PetscObjectGetReference(x%v, cnt, ierr)
+#endif
+#if (PETSC_VERSION_MAJOR==3 && PETSC_VERSION_MINOR<8)
 #define MatCreateSubMatrix MatGetSubMatrix
 #endif
 #if (PETSC_VERSION_MAJOR==3 && PETSC_VERSION_MINOR<9)
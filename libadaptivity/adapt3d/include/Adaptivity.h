@@ -86,6 +86,13 @@ class Adaptivity{
   /// Enable/disable surface locking
   void enableSurfaceLock();
 
+  /// Enable/disable the thread-parallel C++ engine (MeshOptimiser)
+  /// in place of the Fortran engine. Serial meshes only. Fluidity does
+  /// not use this class, and always adapts with the Fortran engine
+  /// through adptvy, so for now the C++ engine is only reached by the
+  /// libadaptivity tests and benchmark.
+  void enableThreadedEngine();
+
   /// Enable/disable automatic detection and protection of co-planar patches.
   void disableGeometryDiscovery();
 
@@ -98,6 +105,10 @@ class Adaptivity{
   /// Enable/disable surface locking
   void disableSurfaceLock();
 
+  /// Enable/disable the thread-parallel C++ engine (MeshOptimiser)
+  /// in place of the Fortran engine. Serial meshes only.
+  void disableThreadedEngine();
+
 #ifdef HAVE_VTK
   /// Get a vtkUnstructuredGrid object that contains the adapted mesh.
   vtkUnstructuredGrid* get_adapted_vtu();
@@ -108,6 +119,13 @@ class Adaptivity{
 
   /// Get the gimension of the mesh
   void getMeshDimensions(int *_NNodes, int *_NElements, int *_NSElements);
+
+  /// Get the minimum and mean quality (mean ratio in metric space)
+  /// of the elements of the adapted mesh.
+  void get_mesh_quality(double *qmin, double *qmean);
+
+  /// Get the quality of each element of the adapted mesh.
+  void get_element_quality(std::vector<double> &quality);
   
   /// Get the surface lables.
   void get_surface_ids(std::vector<int> &sids);
@@ -165,6 +183,7 @@ class Adaptivity{
  private:
   static bool verbose;
 
+  void adapt_threaded();
   int getNProcessors() const;
   double volume(int n1, int n2, int n3, int n4) const;
   double volume(int n1, int n2, int n3, afloat_t x, afloat_t y, afloat_t z) const;
@@ -246,6 +265,9 @@ class Adaptivity{
     ADPBIG, ADPNOD;
 
   int UsingSurfaces;
+
+  // Use MeshOptimiser rather than adptvy
+  bool threaded;
 };
 
 #endif
@@ -0,0 +1,191 @@
+/*
+  Copyright (C) 2006 Imperial College London and others.
+
+  Please see the AUTHORS file in the main source directory for a full list
+  of copyright holders.
+
+  Gerard Gorman
+  Applied Modelling and Computation Group
+  Department of Earth Science and Engineering
+  Imperial College London
+
+  adrian@Imperial.ac.uk
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+  USA
+*/
+
+#ifndef MESHOPTIMISER_H
+#define MESHOPTIMISER_H
+
+#include "confdefs.h"
+
+#ifdef USING_DOUBLE_PRECISION
+typedef double afloat_t;
+#else
+typedef float afloat_t;
+#endif
+
+#include <vector>
+
+/** Thread-parallel anisotropic adaptivity of a serial tetrahedral mesh.
+
+    The mesh is adapted to the metric by splitting edges longer than
+    sqrt(2), collapsing edges shorter than 1/sqrt(2), 2-3 and 3-2 swaps
+    of poor elements and quality constrained Laplacian smoothing, all
+    measured in metric space. Each operation is applied in rounds to
+    an independent set of cavities (sets of vertices that no two
+    operations share), so the operations of a round run concurrently
+    with OpenMP and give the same mesh on any number of threads. The
+    mesh is held in growable arrays, so no memory estimate is needed.
+
+    Surface nodes are only collapsed within a co-planar patch of one
+    surface id and are never moved by smoothing; surface edges are
+    split with the surface elements. Meshes and numbering are in the
+    same form as Adaptivity (one based element lists).
+
+    Threads are only used when libadaptivity is configured with
+    OpenMP, which Fluidity's --enable-openmp passes on.
+*/
+class MeshOptimiser{
+ public:
+  /// Constructor.
+  MeshOptimiser();
+
+  /// Adapt the mesh.
+  void adapt();
+
+  /// Get the number of nodes, elements and surface elements.
+  void get_mesh_dimensions(int *NNodes, int *NElements, int *NSElements) const;
+
+  /// Get the quality (see get_quality) of each element.
+  void get_element_quality(double *quality) const;
+
+  /// Get the interpolated fields, in the layout of set_fields.
+  void get_fields(afloat_t *fields) const;
+
+  /// Get the interpolated metric.
+  void get_metric(afloat_t *metric) const;
+
+  /// Get the points of the mesh.
+  void get_points(afloat_t *X, afloat_t *Y, afloat_t *Z) const;
+
+  /// Get the minimum and mean element quality in metric space. The
+  /// quality is the mean ratio, which is 1 for a regular tetrahedron
+  /// with unit edges in metric space and 0 for a degenerate one.
+  void get_quality(double *qmin, double *qmean) const;
+
+  /// Get the surface ids.
+  void get_surface_ids(int *sids) const;
+
+  /// Get the surface mesh (one based).
+  void get_surface_mesh(int *SENList) const;
+
+  /// Get the element labels.
+  void get_volume_ids(int *ids) const;
+
+  /// Get the volume mesh (one based).
+  void get_volume_mesh(int *ENList) const;
+
+  /// Set the maximum number of adaptive sweeps through the mesh.
+  void set_adapt_sweeps(int sweeps);
+
+  /// Set the fields to be interpolated. The nfields fields have
+  /// nfreedom[i] components each and are stored one after the other,
+  /// each as NNodes tuples of components.
+  void set_fields(const afloat_t *fields, const int *nfreedom, int nfields);
+
+  /// Set the metric tensor field (9 values per node).
+  void set_metric(const afloat_t *metric);
+
+  /// Switch mesh operations on/off.
+  void set_operations(bool split, bool collapse, bool swap, bool smooth);
+
+  /// Set the mesh points.
+  void set_points(const afloat_t *X, const afloat_t *Y, const afloat_t *Z, int NNodes);
+
+  /// Set the surface mesh (one based) and its ids. sids may be NULL.
+  void set_surface_mesh(const int *SENList, const int *sids, int NSElements);
+
+  /// Keep the surface mesh intact.
+  void set_surface_lock(bool lock);
+
+  /// Set the element labels.
+  void set_volume_ids(const int *ids);
+
+  /// Set the volume mesh (one based).
+  void set_volume_mesh(const int *ENList, int NElements);
+
+ private:
+  /// A possible operation and its priority.
+  struct Candidate{
+    double priority;
+    int a, b;
+    bool operator<(const Candidate &other) const;
+  };
+
+  /// A 2-3 or 3-2 swap: the old elements and the new ones.
+  struct Swap{
+    double quality;
+    int nold, nnew;
+    int old_elements[3];
+    int new_elements[3][4];
+    bool operator<(const Swap &other) const;
+  };
+
+  void build_adjacency();
+  bool collapsible(int u) const;
+  int collapse_target(int u, double *len) const;
+  bool collapse_valid(int u, int v) const;
+  void collapse(int u, int v);
+  int coarsen();
+  void compact();
+  void edge_elements(int a, int b, std::vector<int> &ring) const;
+  void edge_facets(int a, int b, std::vector<int> &facets) const;
+  void find_orientation();
+  bool find_swap(int e, Swap *swap) const;
+  double length(int a, int b) const;
+  bool movable(int u) const;
+  double quality(const int *n) const;
+  int refine();
+  void smooth();
+  bool smooth_vertex(int u);
+  void split(int a, int b, int m, const std::vector<int> &ring, int new_element,
+             const std::vector<int> &facets, int new_facet);
+  int swap();
+  void apply_swap(const Swap &swap, int new_element);
+  void update_neighbours(int n);
+  double volume(const int *n) const;
+  double volume(const double *x0, const double *x1, const double *x2, const double *x3) const;
+
+  // Mesh. Deleted elements have ENList[4*e]<0, deleted facets
+  // SENList[3*f]<0 and deleted nodes an empty NEList.
+  std::vector<double> coords, metric, values;
+  std::vector<int> ENList, regions, SENList, sids;
+  std::vector< std::vector<int> > NEList, NNList, NSList;
+
+  // Layout of the interpolated fields.
+  int nfields, nvalues;
+  std::vector<int> nfreedom;
+
+  // Sign of the volume of the elements as they are numbered.
+  double orientation;
+
+  int sweeps;
+  bool do_split, do_collapse, do_swap, do_smooth, surface_lock;
+  double L_low, L_up, collapse_quality, swap_quality;
+};
+
+#endif
@@ -28,6 +28,7 @@
 */
 
 #include "Adaptivity.h"
+#include "MeshOptimiser.h"
 #include "cinterfaces.h"
 
 using namespace std;
@@ -93,6 +94,8 @@ Adaptivity::Adaptivity(){
   ADPNOD = 0;
 
   interpolate = false;
+
+  threaded = false;
 };
 
 afloat_t Adaptivity::edgeLengthDistribution(afloat_t w){
@@ -158,6 +161,15 @@ void Adaptivity::adapt(){
   if(verbose)
     cout<<"void Adaptivity::adapt()\n";
 
+  if(threaded){
+    if(NProcs>1){
+      cerr<<"WARNING: the threaded engine does not handle halos, using the Fortran engine.\n";
+    }else{
+      adapt_threaded();
+      return;
+    }
+  }
+
   //
   // Hardwired stuff
   //
@@ -307,6 +319,75 @@ void Adaptivity::adapt(){
   newZ = &(floatBuffer[NWNODZ-1]);
 }
 
+void Adaptivity::adapt_threaded(){
+  if(verbose)
+    cout<<"void Adaptivity::adapt_threaded()\n";
+
+  int NNodes = X.size();
+  int NElements = ENList.size()/nloc;
+  int NSElements = SENList.size()/snloc;
+
+  MeshOptimiser optimiser;
+  optimiser.set_points(&(X[0]), &(Y[0]), &(Z[0]), NNodes);
+  optimiser.set_metric(&(Metric[0]));
+  optimiser.set_volume_mesh(&(ENList[0]), NElements);
+  if(volumeID!=NULL)
+    optimiser.set_volume_ids(volumeID);
+  if(NSElements>0)
+    optimiser.set_surface_mesh(&(SENList[0]), surfID.empty()?NULL:&(surfID[0]), NSElements);
+
+  int totfre=0;
+  if(interpolate){
+    for(vector<int>::const_iterator it=nfreedom.begin();it!=nfreedom.end();++it){
+      totfre+=*it;
+    }
+    if(totfre>0)
+      optimiser.set_fields(&(fields[0]), &(nfreedom[0]), nfields);
+  }
+
+  optimiser.set_adapt_sweeps(MaxNumberAdaptIterations);
+  optimiser.set_operations(AdaptOpts[0]==LOGICAL_TRUE, AdaptOpts[1]==LOGICAL_TRUE,
+                           AdaptOpts[2]==LOGICAL_TRUE || AdaptOpts[3]==LOGICAL_TRUE,
+                           AdaptOpts[5]==LOGICAL_TRUE);
+  optimiser.set_surface_lock(SRFGMY==LOGICAL_TRUE);
+  optimiser.adapt();
+
+  // Lay the new mesh out in the buffers as adptvy does, so that the
+  // getters work for either engine.
+  optimiser.get_mesh_dimensions(&newNNodes, &newNElements, &newNSElements);
+  newNPrivateNodes = newNNodes;
+
+  NWENLS = 1;
+  NWSNLS = NWENLS + 4*newNElements;
+  NWSFID = NWSNLS + 3*newNSElements;
+  NWELRG = NWSFID + newNSElements;
+  intBuffer.resize(NWELRG - 1 + newNElements);
+  optimiser.get_volume_mesh(&(intBuffer[NWENLS-1]));
+  if(newNSElements>0){
+    optimiser.get_surface_mesh(&(intBuffer[NWSNLS-1]));
+    optimiser.get_surface_ids(&(intBuffer[NWSFID-1]));
+  }
+  optimiser.get_volume_ids(&(intBuffer[NWELRG-1]));
+
+  NWNODX = 1;
+  NWNODY = NWNODX + newNNodes;
+  NWNODZ = NWNODY + newNNodes;
+  NEWMTX = NWNODZ + newNNodes;
+  NEWFLD = NEWMTX + 9*newNNodes;
+  floatBuffer.resize(NEWFLD - 1 + totfre*newNNodes);
+  optimiser.get_points(&(floatBuffer[NWNODX-1]), &(floatBuffer[NWNODY-1]), &(floatBuffer[NWNODZ-1]));
+  optimiser.get_metric(&(floatBuffer[NEWMTX-1]));
+  if(totfre>0)
+    optimiser.get_fields(&(floatBuffer[NEWFLD-1]));
+
+  // Zero tolerence for errors from adaptivity
+  assert(newNNodes>0);
+
+  newX = &(floatBuffer[NWNODX-1]);
+  newY = &(floatBuffer[NWNODY-1]);
+  newZ = &(floatBuffer[NWNODZ-1]);
+}
+
 void Adaptivity::enableGeometryDiscovery(){
   if(verbose)
     cout<<"void Adaptivity::enableGeometryDiscovery()\n";
@@ -337,6 +418,12 @@ void Adaptivity::enableSurfaceLock(){
   SRFGMY = LOGICAL_TRUE;
 }
 
+void Adaptivity::enableThreadedEngine(){
+  if(verbose)
+    cout<<"void Adaptivity::enableThreadedEngine()\n";
+  threaded = true;
+}
+
 void Adaptivity::disableGeometryDiscovery(){
   if(verbose)
     cout<<"void Adaptivity::disableGeometryDiscovery()\n";
@@ -367,6 +454,12 @@ void Adaptivity::disableSurfaceLock(){
   SRFGMY = LOGICAL_FALSE;
 }
 
+void Adaptivity::disableThreadedEngine(){
+  if(verbose)
+    cout<<"void Adaptivity::disableThreadedEngine()\n";
+  threaded = false;
+}
+
 #ifdef HAVE_VTK
 /// Get a vtkUnstructuredGrid object that contains the adapted mesh.
 vtkUnstructuredGrid* Adaptivity::get_adapted_vtu(){
@@ -485,6 +578,29 @@ void Adaptivity::getMeshDimensions(int *_NNodes, int *_NElements, int *_NSElemen
   *_NSElements = newNSElements;
 }
 
+void Adaptivity::get_mesh_quality(double *qmin, double *qmean){
+  if(verbose)
+    cout<<"void Adaptivity::get_mesh_quality(double *, double *)\n";
+
+  MeshOptimiser optimiser;
+  optimiser.set_points(newX, newY, newZ, newNNodes);
+  optimiser.set_metric(&(floatBuffer[NEWMTX-1]));
+  optimiser.set_volume_mesh(&(intBuffer[NWENLS-1]), newNElements);
+  optimiser.get_quality(qmin, qmean);
+}
+
+void Adaptivity::get_element_quality(vector<double> &quality){
+  if(verbose)
+    cout<<"void Adaptivity::get_element_quality(vector<double> &)\n";
+
+  MeshOptimiser optimiser;
+  optimiser.set_points(newX, newY, newZ, newNNodes);
+  optimiser.set_metric(&(floatBuffer[NEWMTX-1]));
+  optimiser.set_volume_mesh(&(intBuffer[NWENLS-1]), newNElements);
+  quality.resize(newNElements);
+  optimiser.get_element_quality(&(quality[0]));
+}
+
 void Adaptivity::get_surface_ids(vector<int> &sids){
   if(verbose)
     cout<<"void Adaptivity::get_surface_ids(vector<int> &sids)\n";
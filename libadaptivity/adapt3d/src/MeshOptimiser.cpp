@@ -0,0 +1,1215 @@
+/*
+  Copyright (C) 2006 Imperial College London and others.
+
+  Please see the AUTHORS file in the main source directory for a full list
+  of copyright holders.
+
+  Gerard Gorman
+  Applied Modelling and Computation Group
+  Department of Earth Science and Engineering
+  Imperial College London
+
+  adrian@Imperial.ac.uk
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+  USA
+*/
+
+#include "MeshOptimiser.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace std;
+
+namespace{
+  // Two surface elements are co-planar if their unit normals agree to
+  // this tolerance (as DiscreteGeometryConstraints).
+  const double coplanar_tolerance = 0.9999999;
+
+  // Swaps are applied in at most this many rounds per sweep.
+  const int max_swap_rounds = 10;
+
+  // Edges are split at most this many times over per sweep.
+  const int max_refine_levels = 10;
+
+  bool contains(const vector<int> &list, int value){
+    return find(list.begin(), list.end(), value)!=list.end();
+  }
+
+  bool contains(const int *n, int len, int value){
+    for(int i=0;i<len;i++)
+      if(n[i]==value)
+        return true;
+    return false;
+  }
+
+  void erase_value(vector<int> &list, int value){
+    vector<int>::iterator it = find(list.begin(), list.end(), value);
+    if(it!=list.end()){
+      *it = list.back();
+      list.pop_back();
+    }
+  }
+
+  void insert_unique(vector<int> &list, int value){
+    if(!contains(list, value))
+      list.push_back(value);
+  }
+}
+
+bool MeshOptimiser::Candidate::operator<(const Candidate &other) const{
+  if(priority!=other.priority)
+    return priority<other.priority;
+  if(a!=other.a)
+    return a<other.a;
+  return b<other.b;
+}
+
+bool MeshOptimiser::Swap::operator<(const Swap &other) const{
+  if(quality!=other.quality)
+    return quality<other.quality;
+  return old_elements[0]<other.old_elements[0];
+}
+
+MeshOptimiser::MeshOptimiser(){
+  nfields = 0;
+  nvalues = 0;
+  orientation = 1.0;
+
+  sweeps = 10;
+  do_split = true;
+  do_collapse = true;
+  do_swap = true;
+  do_smooth = true;
+  surface_lock = false;
+
+  L_low = 1.0/sqrt(2.0);
+  L_up = sqrt(2.0);
+
+  // A collapse may not leave an element worse than this, unless one
+  // was already.
+  collapse_quality = 0.1;
+
+  // Elements worse than this are considered for swapping.
+  swap_quality = 0.4;
+}
+
+void MeshOptimiser::adapt(){
+  assert(metric.size()==coords.size()*3);
+
+  find_orientation();
+  build_adjacency();
+
+  for(int sweep=0;sweep<sweeps;sweep++){
+    int changes = 0;
+    if(do_collapse)
+      changes += coarsen();
+    if(do_split)
+      changes += refine();
+    if(do_collapse)
+      changes += coarsen();
+    if(do_swap)
+      changes += swap();
+    if(do_smooth)
+      smooth();
+
+    compact();
+    build_adjacency();
+
+    if(changes==0)
+      break;
+  }
+}
+
+void MeshOptimiser::get_mesh_dimensions(int *NNodes, int *NElements, int *NSElements) const{
+  *NNodes = coords.size()/3;
+  *NElements = ENList.size()/4;
+  *NSElements = SENList.size()/3;
+}
+
+void MeshOptimiser::get_element_quality(double *_quality) const{
+  const int NElements = ENList.size()/4;
+#pragma omp parallel for schedule(static)
+  for(int e=0;e<NElements;e++)
+    _quality[e] = ENList[4*e]<0?-1.0:quality(&(ENList[4*e]));
+}
+
+void MeshOptimiser::get_fields(afloat_t *fields) const{
+  const int NNodes = coords.size()/3;
+  size_t pos = 0;
+  for(int i=0, col=0;i<nfields;col+=nfreedom[i++]){
+    for(int n=0;n<NNodes;n++)
+      for(int j=0;j<nfreedom[i];j++)
+        fields[pos++] = values[n*nvalues+col+j];
+  }
+}
+
+void MeshOptimiser::get_metric(afloat_t *_metric) const{
+  for(size_t i=0;i<metric.size();i++)
+    _metric[i] = metric[i];
+}
+
+void MeshOptimiser::get_points(afloat_t *X, afloat_t *Y, afloat_t *Z) const{
+  const int NNodes = coords.size()/3;
+  for(int i=0;i<NNodes;i++){
+    X[i] = coords[3*i];
+    Y[i] = coords[3*i+1];
+    Z[i] = coords[3*i+2];
+  }
+}
+
+void MeshOptimiser::get_quality(double *qmin, double *qmean) const{
+  const int NElements = ENList.size()/4;
+  double lmin = 1.0, sum = 0.0;
+  int count = 0;
+#pragma omp parallel for reduction(min:lmin) reduction(+:sum,count)
+  for(int e=0;e<NElements;e++){
+    if(ENList[4*e]<0)
+      continue;
+    double q = quality(&(ENList[4*e]));
+    lmin = min(lmin, q);
+    sum += q;
+    count++;
+  }
+  *qmin = lmin;
+  *qmean = count>0?sum/count:0.0;
+}
+
+void MeshOptimiser::get_surface_ids(int *_sids) const{
+  for(size_t i=0;i<sids.size();i++)
+    _sids[i] = sids[i];
+}
+
+void MeshOptimiser::get_surface_mesh(int *_SENList) const{
+  for(size_t i=0;i<SENList.size();i++)
+    _SENList[i] = SENList[i]+1;
+}
+
+void MeshOptimiser::get_volume_ids(int *ids) const{
+  for(size_t i=0;i<regions.size();i++)
+    ids[i] = regions[i];
+}
+
+void MeshOptimiser::get_volume_mesh(int *_ENList) const{
+  for(size_t i=0;i<ENList.size();i++)
+    _ENList[i] = ENList[i]+1;
+}
+
+void MeshOptimiser::set_adapt_sweeps(int _sweeps){
+  sweeps = _sweeps;
+}
+
+void MeshOptimiser::set_fields(const afloat_t *fields, const int *_nfreedom, int _nfields){
+  const int NNodes = coords.size()/3;
+  nfields = _nfields;
+  nfreedom.assign(_nfreedom, _nfreedom+nfields);
+  nvalues = 0;
+  for(int i=0;i<nfields;i++)
+    nvalues += nfreedom[i];
+
+  // Fields are interpolated node by node, so store them that way.
+  values.resize(NNodes*nvalues);
+  size_t pos = 0;
+  for(int i=0, col=0;i<nfields;col+=nfreedom[i++]){
+    for(int n=0;n<NNodes;n++)
+      for(int j=0;j<nfreedom[i];j++)
+        values[n*nvalues+col+j] = fields[pos++];
+  }
+}
+
+void MeshOptimiser::set_metric(const afloat_t *_metric){
+  metric.resize(coords.size()*3);
+  for(size_t i=0;i<metric.size();i++)
+    metric[i] = _metric[i];
+}
+
+void MeshOptimiser::set_operations(bool split, bool collapse, bool swap, bool smooth){
+  do_split = split;
+  do_collapse = collapse;
+  do_swap = swap;
+  do_smooth = smooth;
+}
+
+void MeshOptimiser::set_points(const afloat_t *X, const afloat_t *Y, const afloat_t *Z, int NNodes){
+  coords.resize(3*NNodes);
+  for(int i=0;i<NNodes;i++){
+    coords[3*i] = X[i];
+    coords[3*i+1] = Y[i];
+    coords[3*i+2] = Z[i];
+  }
+  values.clear();
+  nfields = 0;
+  nvalues = 0;
+  find_orientation();
+}
+
+void MeshOptimiser::set_surface_mesh(const int *_SENList, const int *_sids, int NSElements){
+  SENList.resize(3*NSElements);
+  for(int i=0;i<3*NSElements;i++)
+    SENList[i] = _SENList[i]-1;
+  if(_sids==NULL)
+    sids.assign(NSElements, 1);
+  else
+    sids.assign(_sids, _sids+NSElements);
+}
+
+void MeshOptimiser::set_surface_lock(bool lock){
+  surface_lock = lock;
+}
+
+void MeshOptimiser::set_volume_ids(const int *ids){
+  regions.assign(ids, ids+ENList.size()/4);
+}
+
+void MeshOptimiser::set_volume_mesh(const int *_ENList, int NElements){
+  ENList.resize(4*NElements);
+  for(int i=0;i<4*NElements;i++)
+    ENList[i] = _ENList[i]-1;
+  regions.assign(NElements, 1);
+  find_orientation();
+}
+
+// Node-element, node-surface element and node-node lists.
+void MeshOptimiser::build_adjacency(){
+  const int NNodes = coords.size()/3;
+  const int NElements = ENList.size()/4;
+  const int NSElements = SENList.size()/3;
+
+  NEList.assign(NNodes, vector<int>());
+  NSList.assign(NNodes, vector<int>());
+  NNList.assign(NNodes, vector<int>());
+  for(int e=0;e<NElements;e++){
+    if(ENList[4*e]<0)
+      continue;
+    for(int j=0;j<4;j++)
+      NEList[ENList[4*e+j]].push_back(e);
+  }
+  for(int f=0;f<NSElements;f++){
+    if(SENList[3*f]<0)
+      continue;
+    for(int j=0;j<3;j++)
+      NSList[SENList[3*f+j]].push_back(f);
+  }
+
+#pragma omp parallel for schedule(static)
+  for(int n=0;n<NNodes;n++)
+    update_neighbours(n);
+}
+
+// Whether all of the elements around u have the same label and, if u
+// is on the surface, it is inside a co-planar patch of one surface id.
+bool MeshOptimiser::collapsible(int u) const{
+  if(!movable(u))
+    return false;
+
+  const vector<int> &facets = NSList[u];
+  if(facets.empty())
+    return true;
+  if(surface_lock)
+    return false;
+
+  double normal0[3];
+  for(size_t i=0;i<facets.size();i++){
+    if(sids[facets[i]]!=sids[facets[0]])
+      return false;
+
+    const int *f = &(SENList[3*facets[i]]);
+    double a[3], b[3], normal[3];
+    for(int j=0;j<3;j++){
+      a[j] = coords[3*f[1]+j]-coords[3*f[0]+j];
+      b[j] = coords[3*f[2]+j]-coords[3*f[0]+j];
+    }
+    normal[0] = a[1]*b[2]-a[2]*b[1];
+    normal[1] = a[2]*b[0]-a[0]*b[2];
+    normal[2] = a[0]*b[1]-a[1]*b[0];
+    double mag = sqrt(normal[0]*normal[0]+normal[1]*normal[1]+normal[2]*normal[2]);
+    for(int j=0;j<3;j++)
+      normal[j] /= mag;
+
+    if(i==0){
+      for(int j=0;j<3;j++)
+        normal0[j] = normal[j];
+    }else if(fabs(normal[0]*normal0[0]+normal[1]*normal0[1]+normal[2]*normal0[2])<coplanar_tolerance){
+      return false;
+    }
+  }
+  return true;
+}
+
+// The node that u should be collapsed onto, along its shortest edge
+// that can be collapsed, or -1.
+int MeshOptimiser::collapse_target(int u, double *len) const{
+  if(!collapsible(u))
+    return -1;
+
+  vector< pair<double, int> > short_edges;
+  for(vector<int>::const_iterator it=NNList[u].begin();it!=NNList[u].end();++it){
+    double l = length(u, *it);
+    if(l<L_low)
+      short_edges.push_back(pair<double, int>(l, *it));
+  }
+  sort(short_edges.begin(), short_edges.end());
+
+  vector<int> facets;
+  for(size_t i=0;i<short_edges.size();i++){
+    const int v = short_edges[i].second;
+    // Surface nodes stay on the surface.
+    if(!NSList[u].empty()){
+      edge_facets(u, v, facets);
+      if(facets.empty())
+        continue;
+    }
+    if(collapse_valid(u, v)){
+      *len = short_edges[i].first;
+      return v;
+    }
+  }
+  return -1;
+}
+
+bool MeshOptimiser::collapse_valid(int u, int v) const{
+  for(vector<int>::const_iterator it=NNList[u].begin();it!=NNList[u].end();++it){
+    if(*it!=v && length(v, *it)>L_up)
+      return false;
+  }
+
+  // Link condition: the only common neighbours of u and v are the
+  // nodes of the elements around the edge, otherwise the collapse
+  // would change the topology.
+  vector<int> ring, link;
+  edge_elements(u, v, ring);
+  for(size_t i=0;i<ring.size();i++){
+    for(int j=0;j<4;j++){
+      const int n = ENList[4*ring[i]+j];
+      if(n!=u && n!=v)
+        insert_unique(link, n);
+    }
+  }
+  size_t common = 0;
+  for(vector<int>::const_iterator it=NNList[u].begin();it!=NNList[u].end();++it){
+    if(*it!=v && contains(NNList[v], *it))
+      common++;
+  }
+  if(common!=link.size())
+    return false;
+
+  double qnew = 1.0;
+  for(vector<int>::const_iterator it=NEList[u].begin();it!=NEList[u].end();++it){
+    int n[4];
+    for(int j=0;j<4;j++)
+      n[j] = ENList[4*(*it)+j];
+    if(contains(n, 4, v))
+      continue;
+    for(int j=0;j<4;j++)
+      if(n[j]==u)
+        n[j] = v;
+    qnew = min(qnew, quality(n));
+    if(qnew<=0.0)
+      return false;
+  }
+  if(qnew>=collapse_quality)
+    return true;
+
+  double qold = 1.0;
+  for(vector<int>::const_iterator it=NEList[u].begin();it!=NEList[u].end();++it)
+    qold = min(qold, quality(&(ENList[4*(*it)])));
+  return qnew>=qold;
+}
+
+// Collapse u onto v. Changes only the elements around u and the lists
+// of u and its neighbours.
+void MeshOptimiser::collapse(int u, int v){
+  const vector<int> star = NEList[u];
+  for(size_t i=0;i<star.size();i++){
+    const int e = star[i];
+    int *n = &(ENList[4*e]);
+    if(contains(n, 4, v)){
+      for(int j=0;j<4;j++)
+        if(n[j]!=u)
+          erase_value(NEList[n[j]], e);
+      for(int j=0;j<4;j++)
+        n[j] = -1;
+    }else{
+      for(int j=0;j<4;j++)
+        if(n[j]==u)
+          n[j] = v;
+      NEList[v].push_back(e);
+    }
+  }
+
+  const vector<int> facets = NSList[u];
+  for(size_t i=0;i<facets.size();i++){
+    const int f = facets[i];
+    int *n = &(SENList[3*f]);
+    if(contains(n, 3, v)){
+      for(int j=0;j<3;j++)
+        if(n[j]!=u)
+          erase_value(NSList[n[j]], f);
+      for(int j=0;j<3;j++)
+        n[j] = -1;
+    }else{
+      for(int j=0;j<3;j++)
+        if(n[j]==u)
+          n[j] = v;
+      NSList[v].push_back(f);
+    }
+  }
+
+  for(vector<int>::const_iterator it=NNList[u].begin();it!=NNList[u].end();++it){
+    if(*it==v)
+      continue;
+    erase_value(NNList[*it], u);
+    insert_unique(NNList[*it], v);
+    insert_unique(NNList[v], *it);
+  }
+  erase_value(NNList[v], u);
+
+  NEList[u].clear();
+  NNList[u].clear();
+  NSList[u].clear();
+}
+
+// Collapse short edges, in rounds of collapses with disjoint closed
+// neighbourhoods. Returns the number of collapses.
+int MeshOptimiser::coarsen(){
+  const int NNodes = coords.size()/3;
+  vector<char> active(NNodes, 1), taken(NNodes);
+  vector<int> target(NNodes, -1);
+  vector<double> len(NNodes, 0.0);
+
+  int ncollapsed = 0;
+  for(;;){
+#pragma omp parallel for schedule(dynamic, 32)
+    for(int u=0;u<NNodes;u++){
+      if(active[u]){
+        target[u] = collapse_target(u, &(len[u]));
+        active[u] = 0;
+      }
+    }
+
+    vector<Candidate> candidates;
+    for(int u=0;u<NNodes;u++){
+      if(target[u]>=0){
+        Candidate c = {len[u], u, target[u]};
+        candidates.push_back(c);
+      }
+    }
+    if(candidates.empty())
+      break;
+    sort(candidates.begin(), candidates.end());
+
+    fill(taken.begin(), taken.end(), 0);
+    vector<Candidate> selected;
+    for(size_t i=0;i<candidates.size();i++){
+      const int u = candidates[i].a;
+      bool independent = !taken[u];
+      for(vector<int>::const_iterator it=NNList[u].begin();independent && it!=NNList[u].end();++it)
+        independent = !taken[*it];
+      if(!independent)
+        continue;
+      taken[u] = 1;
+      for(vector<int>::const_iterator it=NNList[u].begin();it!=NNList[u].end();++it)
+        taken[*it] = 1;
+      selected.push_back(candidates[i]);
+    }
+
+    const int nselected = selected.size();
+#pragma omp parallel for schedule(dynamic, 16)
+    for(int i=0;i<nselected;i++)
+      collapse(selected[i].a, selected[i].b);
+    ncollapsed += nselected;
+
+    // A collapse reads the lists of its node and its target, so only
+    // those touching the neighbourhoods changed need another look.
+    for(int i=0;i<nselected;i++){
+      const int v = selected[i].b;
+      target[selected[i].a] = -1;
+      taken[v] = 2;
+      for(vector<int>::const_iterator it=NNList[v].begin();it!=NNList[v].end();++it)
+        taken[*it] = 2;
+    }
+    for(int u=0;u<NNodes;u++)
+      active[u] = taken[u]==2 || (target[u]>=0 && taken[target[u]]==2);
+  }
+
+  return ncollapsed;
+}
+
+// Remove deleted nodes, elements and surface elements.
+void MeshOptimiser::compact(){
+  const int NNodes = coords.size()/3;
+  const int NElements = ENList.size()/4;
+  const int NSElements = SENList.size()/3;
+
+  vector<int> renumber(NNodes, -1);
+  int count = 0;
+  for(int n=0;n<NNodes;n++)
+    if(!NEList[n].empty())
+      renumber[n] = count++;
+
+  vector<double> new_coords(3*count), new_metric(9*count), new_values(nvalues*count);
+  for(int n=0;n<NNodes;n++){
+    const int m = renumber[n];
+    if(m<0)
+      continue;
+    copy(&(coords[3*n]), &(coords[3*n])+3, &(new_coords[3*m]));
+    copy(&(metric[9*n]), &(metric[9*n])+9, &(new_metric[9*m]));
+    for(int j=0;j<nvalues;j++)
+      new_values[m*nvalues+j] = values[n*nvalues+j];
+  }
+  coords.swap(new_coords);
+  metric.swap(new_metric);
+  values.swap(new_values);
+
+  vector<int> new_ENList, new_regions;
+  new_ENList.reserve(ENList.size());
+  new_regions.reserve(regions.size());
+  for(int e=0;e<NElements;e++){
+    if(ENList[4*e]<0)
+      continue;
+    for(int j=0;j<4;j++)
+      new_ENList.push_back(renumber[ENList[4*e+j]]);
+    new_regions.push_back(regions[e]);
+  }
+  ENList.swap(new_ENList);
+  regions.swap(new_regions);
+
+  vector<int> new_SENList, new_sids;
+  for(int f=0;f<NSElements;f++){
+    if(SENList[3*f]<0)
+      continue;
+    for(int j=0;j<3;j++)
+      new_SENList.push_back(renumber[SENList[3*f+j]]);
+    new_sids.push_back(sids[f]);
+  }
+  SENList.swap(new_SENList);
+  sids.swap(new_sids);
+}
+
+void MeshOptimiser::edge_elements(int a, int b, vector<int> &ring) const{
+  ring.clear();
+  for(vector<int>::const_iterator it=NEList[a].begin();it!=NEList[a].end();++it)
+    if(contains(&(ENList[4*(*it)]), 4, b))
+      ring.push_back(*it);
+}
+
+void MeshOptimiser::edge_facets(int a, int b, vector<int> &facets) const{
+  facets.clear();
+  for(vector<int>::const_iterator it=NSList[a].begin();it!=NSList[a].end();++it)
+    if(contains(&(SENList[3*(*it)]), 3, b))
+      facets.push_back(*it);
+}
+
+void MeshOptimiser::find_orientation(){
+  orientation = 1.0;
+  if(ENList.empty() || coords.empty())
+    return;
+  if(volume(&(ENList[0]))<0.0)
+    orientation = -1.0;
+}
+
+// The best 2-3 or 3-2 swap that improves the worst of the elements
+// it replaces, if e is a poor element.
+bool MeshOptimiser::find_swap(int e, Swap *swap) const{
+  const int *n = &(ENList[4*e]);
+  const double q = quality(n);
+  if(q>=swap_quality)
+    return false;
+
+  swap->quality = q;
+  double best = q;
+  bool found = false;
+
+  // 2-3: replace e and its neighbour across a face by three elements
+  // around the edge joining their opposite nodes.
+  for(int i=0;i<4;i++){
+    const int a = n[i];
+    int f[3];
+    for(int j=0, k=0;j<4;j++)
+      if(j!=i)
+        f[k++] = n[j];
+
+    int other = -1;
+    for(vector<int>::const_iterator it=NEList[f[0]].begin();it!=NEList[f[0]].end();++it){
+      const int *m = &(ENList[4*(*it)]);
+      if(*it!=e && contains(m, 4, f[1]) && contains(m, 4, f[2])){
+        other = *it;
+        break;
+      }
+    }
+    if(other<0 || regions[other]!=regions[e])
+      continue;
+
+    // Leave internal surfaces alone.
+    bool facet = false;
+    for(vector<int>::const_iterator it=NSList[f[0]].begin();it!=NSList[f[0]].end();++it){
+      const int *m = &(SENList[3*(*it)]);
+      facet = facet || (contains(m, 3, f[1]) && contains(m, 3, f[2]));
+    }
+    if(facet)
+      continue;
+
+    int b = -1;
+    for(int j=0;j<4;j++)
+      if(!contains(f, 3, ENList[4*other+j]))
+        b = ENList[4*other+j];
+    if(contains(NNList[a], b))
+      continue;
+
+    // Each new element is e with a node of the face replaced by b,
+    // which keeps the orientation of e.
+    int t[3][4];
+    double qnew = 1.0;
+    for(int k=0;k<3;k++){
+      for(int j=0;j<4;j++)
+        t[k][j] = n[j]==f[k]?b:n[j];
+      qnew = min(qnew, quality(t[k]));
+    }
+    if(qnew>best){
+      best = qnew;
+      found = true;
+      swap->nold = 2;
+      swap->nnew = 3;
+      swap->old_elements[0] = e;
+      swap->old_elements[1] = other;
+      copy(&(t[0][0]), &(t[0][0])+12, &(swap->new_elements[0][0]));
+    }
+  }
+
+  // 3-2: replace the three elements around an interior edge of e by
+  // two elements sharing the face of the three other nodes.
+  static const int edges[6][2] = {{0, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3}, {2, 3}};
+  vector<int> ring, facets;
+  for(int k=0;k<6;k++){
+    const int p = n[edges[k][0]], r = n[edges[k][1]];
+    edge_elements(p, r, ring);
+    if(ring.size()!=3)
+      continue;
+    edge_facets(p, r, facets);
+    if(!facets.empty())
+      continue;
+    if(regions[ring[1]]!=regions[ring[0]] || regions[ring[2]]!=regions[ring[0]])
+      continue;
+
+    vector<int> link;
+    double qold = 1.0;
+    for(int i=0;i<3;i++){
+      const int *m = &(ENList[4*ring[i]]);
+      qold = min(qold, quality(m));
+      for(int j=0;j<4;j++)
+        if(m[j]!=p && m[j]!=r)
+          insert_unique(link, m[j]);
+    }
+    if(link.size()!=3)
+      continue;
+
+    bool existing = false;
+    for(vector<int>::const_iterator it=NEList[link[0]].begin();it!=NEList[link[0]].end();++it){
+      const int *m = &(ENList[4*(*it)]);
+      existing = existing || (contains(m, 4, link[1]) && contains(m, 4, link[2]));
+    }
+    if(existing)
+      continue;
+
+    // The new elements are the first element around the edge with
+    // one end of the edge replaced by the link node not in it, which
+    // keeps its orientation.
+    const int *m = &(ENList[4*ring[0]]);
+    int missing = -1;
+    for(int i=0;i<3;i++)
+      if(!contains(m, 4, link[i]))
+        missing = link[i];
+    int t[2][4];
+    double qnew = 1.0;
+    for(int i=0;i<2;i++){
+      const int replaced = i==0?r:p;
+      for(int j=0;j<4;j++)
+        t[i][j] = m[j]==replaced?missing:m[j];
+      qnew = min(qnew, quality(t[i]));
+    }
+    if(qnew>best && qnew>qold){
+      best = qnew;
+      found = true;
+      swap->nold = 3;
+      swap->nnew = 2;
+      copy(ring.begin(), ring.end(), swap->old_elements);
+      copy(&(t[0][0]), &(t[0][0])+8, &(swap->new_elements[0][0]));
+    }
+  }
+
+  if(found && swap->old_elements[0]!=e){
+    // Keep the generating element first, for a stable order.
+    for(int i=1;i<swap->nold;i++){
+      if(swap->old_elements[i]==e){
+        std::swap(swap->old_elements[0], swap->old_elements[i]);
+        break;
+      }
+    }
+  }
+  return found;
+}
+
+// Edge length in metric space, with the metric averaged over the edge.
+double MeshOptimiser::length(int a, int b) const{
+  double d[3], M[9];
+  for(int i=0;i<3;i++)
+    d[i] = coords[3*b+i]-coords[3*a+i];
+  for(int i=0;i<9;i++)
+    M[i] = 0.5*(metric[9*a+i]+metric[9*b+i]);
+
+  double l2 = 0.0;
+  for(int i=0;i<3;i++)
+    for(int j=0;j<3;j++)
+      l2 += d[i]*M[3*i+j]*d[j];
+  return sqrt(max(l2, 0.0));
+}
+
+// Whether all of the elements around u have the same label and it is
+// not on the surface.
+bool MeshOptimiser::movable(int u) const{
+  const vector<int> &star = NEList[u];
+  if(star.empty())
+    return false;
+  for(size_t i=1;i<star.size();i++)
+    if(regions[star[i]]!=regions[star[0]])
+      return false;
+  return true;
+}
+
+// Mean ratio of the element in metric space, with the metric averaged
+// over the element, or -1 if the element is inverted or degenerate.
+double MeshOptimiser::quality(const int *n) const{
+  const double *x[4];
+  for(int i=0;i<4;i++)
+    x[i] = &(coords[3*n[i]]);
+  const double vol = volume(x[0], x[1], x[2], x[3]);
+  if(vol<=0.0)
+    return -1.0;
+
+  double M[9];
+  for(int i=0;i<9;i++)
+    M[i] = 0.25*(metric[9*n[0]+i]+metric[9*n[1]+i]+metric[9*n[2]+i]+metric[9*n[3]+i]);
+  const double det =
+    M[0]*(M[4]*M[8]-M[5]*M[7])-M[1]*(M[3]*M[8]-M[5]*M[6])+M[2]*(M[3]*M[7]-M[4]*M[6]);
+
+  double l2 = 0.0;
+  for(int i=0;i<4;i++){
+    for(int j=i+1;j<4;j++){
+      double d[3];
+      for(int k=0;k<3;k++)
+        d[k] = x[j][k]-x[i][k];
+      for(int k=0;k<3;k++)
+        for(int l=0;l<3;l++)
+          l2 += d[k]*M[3*k+l]*d[l];
+    }
+  }
+  if(det<=0.0 || l2<=0.0)
+    return -1.0;
+
+  const double r = cbrt(3.0*vol*sqrt(det));
+  return 12.0*r*r/l2;
+}
+
+// Split long edges at their mid points, longest first, in rounds of
+// splits whose elements share no nodes. With the surface locked, edges
+// touching it are not split, as splitting towards a coarse locked
+// surface need not converge. Returns the number of splits.
+int MeshOptimiser::refine(){
+  vector<Candidate> candidates;
+  {
+    const int NNodes = coords.size()/3;
+#pragma omp parallel
+    {
+      vector<Candidate> local;
+#pragma omp for schedule(dynamic, 64) nowait
+      for(int a=0;a<NNodes;a++){
+        for(vector<int>::const_iterator it=NNList[a].begin();it!=NNList[a].end();++it){
+          if(*it<a)
+            continue;
+          double l = length(a, *it);
+          if(l<=L_up)
+            continue;
+          if(surface_lock && !(NSList[a].empty() && NSList[*it].empty()))
+            continue;
+          Candidate c = {-l, a, *it};
+          local.push_back(c);
+        }
+      }
+#pragma omp critical
+      candidates.insert(candidates.end(), local.begin(), local.end());
+    }
+  }
+
+  int nsplit = 0;
+  vector<char> taken;
+  vector<int> ring, facets, level(coords.size()/3, 0);
+  while(!candidates.empty()){
+    sort(candidates.begin(), candidates.end());
+
+    const int NNodes = coords.size()/3;
+    const int NElements = ENList.size()/4;
+    const int NSElements = SENList.size()/3;
+    taken.assign(NNodes, 0);
+
+    vector<Candidate> selected, deferred;
+    vector< vector<int> > rings, edge_facet_lists;
+    vector<int> element_offset(1, NElements), facet_offset(1, NSElements);
+    for(size_t i=0;i<candidates.size();i++){
+      edge_elements(candidates[i].a, candidates[i].b, ring);
+      bool independent = true;
+      for(size_t j=0;independent && j<ring.size();j++)
+        for(int k=0;k<4;k++)
+          independent = independent && !taken[ENList[4*ring[j]+k]];
+      if(!independent){
+        deferred.push_back(candidates[i]);
+        continue;
+      }
+      for(size_t j=0;j<ring.size();j++)
+        for(int k=0;k<4;k++)
+          taken[ENList[4*ring[j]+k]] = 1;
+
+      edge_facets(candidates[i].a, candidates[i].b, facets);
+      selected.push_back(candidates[i]);
+      rings.push_back(ring);
+      edge_facet_lists.push_back(facets);
+      element_offset.push_back(element_offset.back()+ring.size());
+      facet_offset.push_back(facet_offset.back()+facets.size());
+    }
+
+    // Grow the mesh for the new nodes and (surface) elements.
+    const int nselected = selected.size();
+    coords.resize(3*(NNodes+nselected));
+    metric.resize(9*(NNodes+nselected));
+    values.resize(nvalues*(NNodes+nselected));
+    NEList.resize(NNodes+nselected);
+    NNList.resize(NNodes+nselected);
+    NSList.resize(NNodes+nselected);
+    ENList.resize(4*element_offset.back());
+    regions.resize(element_offset.back());
+    SENList.resize(3*facet_offset.back());
+    sids.resize(facet_offset.back());
+
+#pragma omp parallel for schedule(dynamic, 16)
+    for(int i=0;i<nselected;i++)
+      split(selected[i].a, selected[i].b, NNodes+i, rings[i], element_offset[i],
+            edge_facet_lists[i], facet_offset[i]);
+    nsplit += nselected;
+
+    // Edges of the new nodes may still be long.
+    candidates.swap(deferred);
+    level.resize(NNodes+nselected);
+    for(int i=0;i<nselected;i++){
+      const int m = NNodes+i;
+      level[m] = max(level[selected[i].a], level[selected[i].b])+1;
+      if(level[m]>=max_refine_levels)
+        continue;
+      for(vector<int>::const_iterator it=NNList[m].begin();it!=NNList[m].end();++it){
+        double l = length(m, *it);
+        if(l<=L_up)
+          continue;
+        if(surface_lock && !NSList[*it].empty())
+          continue;
+        Candidate c = {-l, min(m, *it), max(m, *it)};
+        candidates.push_back(c);
+      }
+    }
+  }
+
+  return nsplit;
+}
+
+// Quality constrained Laplacian smoothing of the interior nodes, one
+// colour of nodes at a time.
+void MeshOptimiser::smooth(){
+  const int NNodes = coords.size()/3;
+
+  vector<int> colour(NNodes, -1);
+  vector< vector<int> > colours;
+  vector<char> used;
+  for(int u=0;u<NNodes;u++){
+    if(!NSList[u].empty() || !movable(u))
+      continue;
+    used.assign(colours.size(), 0);
+    for(vector<int>::const_iterator it=NNList[u].begin();it!=NNList[u].end();++it)
+      if(colour[*it]>=0)
+        used[colour[*it]] = 1;
+    size_t c = 0;
+    while(c<colours.size() && used[c])
+      c++;
+    if(c==colours.size())
+      colours.push_back(vector<int>());
+    colour[u] = c;
+    colours[c].push_back(u);
+  }
+
+  for(int pass=0;pass<2;pass++){
+    int moved = 0;
+    for(size_t c=0;c<colours.size();c++){
+      const int ncolour = colours[c].size();
+#pragma omp parallel for schedule(dynamic, 32) reduction(+:moved)
+      for(int i=0;i<ncolour;i++)
+        if(smooth_vertex(colours[c][i]))
+          moved++;
+    }
+    if(moved==0)
+      break;
+  }
+}
+
+// Move u towards the centroid of its neighbours if that improves the
+// worst element around it, and interpolate its metric and fields from
+// the old element that contains its new position.
+bool MeshOptimiser::smooth_vertex(int u){
+  const vector<int> &star = NEList[u];
+  double qold = 1.0;
+  for(size_t i=0;i<star.size();i++)
+    qold = min(qold, quality(&(ENList[4*star[i]])));
+
+  double *x = &(coords[3*u]);
+  double x0[3], centroid[3] = {0.0, 0.0, 0.0};
+  for(int i=0;i<3;i++)
+    x0[i] = x[i];
+  for(vector<int>::const_iterator it=NNList[u].begin();it!=NNList[u].end();++it)
+    for(int i=0;i<3;i++)
+      centroid[i] += coords[3*(*it)+i];
+  for(int i=0;i<3;i++)
+    centroid[i] /= NNList[u].size();
+
+  for(double relax=1.0;relax>0.2;relax*=0.5){
+    double x1[3];
+    for(int i=0;i<3;i++)
+      x[i] = x1[i] = x0[i]+relax*(centroid[i]-x0[i]);
+    double qnew = 1.0;
+    for(size_t i=0;i<star.size() && qnew>qold;i++)
+      qnew = min(qnew, quality(&(ENList[4*star[i]])));
+    for(int i=0;i<3;i++)
+      x[i] = x0[i];
+    if(qnew<=qold)
+      continue;
+
+    for(size_t i=0;i<star.size();i++){
+      const int *n = &(ENList[4*star[i]]);
+      const double *xn[4];
+      for(int j=0;j<4;j++)
+        xn[j] = &(coords[3*n[j]]);
+      const double vol = volume(xn[0], xn[1], xn[2], xn[3]);
+      if(vol<=0.0)
+        continue;
+      double lambda[4];
+      bool inside = true;
+      for(int j=0;j<4;j++){
+        const double *xl[4] = {xn[0], xn[1], xn[2], xn[3]};
+        xl[j] = x1;
+        lambda[j] = volume(xl[0], xl[1], xl[2], xl[3])/vol;
+        inside = inside && lambda[j]>=-1.0e-8;
+      }
+      if(!inside)
+        continue;
+
+      double new_metric[9];
+      vector<double> new_values(nvalues, 0.0);
+      for(int k=0;k<9;k++){
+        new_metric[k] = 0.0;
+        for(int j=0;j<4;j++)
+          new_metric[k] += lambda[j]*metric[9*n[j]+k];
+      }
+      for(int k=0;k<nvalues;k++)
+        for(int j=0;j<4;j++)
+          new_values[k] += lambda[j]*values[n[j]*nvalues+k];
+
+      for(int k=0;k<3;k++)
+        x[k] = x1[k];
+      copy(new_metric, new_metric+9, &(metric[9*u]));
+      copy(new_values.begin(), new_values.end(), values.begin()+u*nvalues);
+      return true;
+    }
+    return false;
+  }
+  return false;
+}
+
+// Split edge (a, b) at new node m. Each element of ring keeps its half
+// at a and new_element+i takes its half at b; surface elements
+// likewise.
+void MeshOptimiser::split(int a, int b, int m, const vector<int> &ring, int new_element,
+                          const vector<int> &facets, int new_facet){
+  for(int i=0;i<3;i++)
+    coords[3*m+i] = 0.5*(coords[3*a+i]+coords[3*b+i]);
+  for(int i=0;i<9;i++)
+    metric[9*m+i] = 0.5*(metric[9*a+i]+metric[9*b+i]);
+  for(int i=0;i<nvalues;i++)
+    values[m*nvalues+i] = 0.5*(values[a*nvalues+i]+values[b*nvalues+i]);
+
+  NEList[m].clear();
+  NNList[m].clear();
+  NSList[m].clear();
+  NNList[m].push_back(a);
+  NNList[m].push_back(b);
+  replace(NNList[a].begin(), NNList[a].end(), b, m);
+  replace(NNList[b].begin(), NNList[b].end(), a, m);
+
+  for(size_t i=0;i<ring.size();i++){
+    const int e = ring[i], f = new_element+i;
+    int *n = &(ENList[4*e]), *nf = &(ENList[4*f]);
+    for(int j=0;j<4;j++){
+      nf[j] = n[j]==a?m:n[j];
+      if(n[j]==b)
+        n[j] = m;
+    }
+    regions[f] = regions[e];
+
+    erase_value(NEList[b], e);
+    NEList[b].push_back(f);
+    NEList[m].push_back(e);
+    NEList[m].push_back(f);
+    for(int j=0;j<4;j++){
+      const int w = nf[j];
+      if(w==m || w==b)
+        continue;
+      NEList[w].push_back(f);
+      insert_unique(NNList[w], m);
+      insert_unique(NNList[m], w);
+    }
+  }
+
+  for(size_t i=0;i<facets.size();i++){
+    const int e = facets[i], f = new_facet+i;
+    int *n = &(SENList[3*e]), *nf = &(SENList[3*f]);
+    for(int j=0;j<3;j++){
+      nf[j] = n[j]==a?m:n[j];
+      if(n[j]==b)
+        n[j] = m;
+    }
+    sids[f] = sids[e];
+
+    erase_value(NSList[b], e);
+    NSList[b].push_back(f);
+    NSList[m].push_back(e);
+    NSList[m].push_back(f);
+    for(int j=0;j<3;j++)
+      if(nf[j]!=m && nf[j]!=b)
+        NSList[nf[j]].push_back(f);
+  }
+}
+
+// Swap poor elements, worst first, in rounds of swaps whose elements
+// share no nodes. Returns the number of swaps.
+int MeshOptimiser::swap(){
+  int nswapped = 0;
+  vector<char> taken;
+  for(int round=0;round<max_swap_rounds;round++){
+    const int NElements = ENList.size()/4;
+    vector<Swap> swaps;
+#pragma omp parallel
+    {
+      vector<Swap> local;
+      Swap s;
+#pragma omp for schedule(dynamic, 64) nowait
+      for(int e=0;e<NElements;e++)
+        if(ENList[4*e]>=0 && find_swap(e, &s))
+          local.push_back(s);
+#pragma omp critical
+      swaps.insert(swaps.end(), local.begin(), local.end());
+    }
+    if(swaps.empty())
+      break;
+    sort(swaps.begin(), swaps.end());
+
+    taken.assign(coords.size()/3, 0);
+    vector<Swap> selected;
+    vector<int> element_offset(1, NElements);
+    for(size_t i=0;i<swaps.size();i++){
+      bool independent = true;
+      for(int j=0;independent && j<swaps[i].nold;j++)
+        for(int k=0;k<4;k++)
+          independent = independent && !taken[ENList[4*swaps[i].old_elements[j]+k]];
+      if(!independent)
+        continue;
+      for(int j=0;j<swaps[i].nold;j++)
+        for(int k=0;k<4;k++)
+          taken[ENList[4*swaps[i].old_elements[j]+k]] = 1;
+      selected.push_back(swaps[i]);
+      element_offset.push_back(element_offset.back()+max(swaps[i].nnew-swaps[i].nold, 0));
+    }
+
+    ENList.resize(4*element_offset.back());
+    regions.resize(element_offset.back());
+
+    const int nselected = selected.size();
+#pragma omp parallel for schedule(dynamic, 16)
+    for(int i=0;i<nselected;i++)
+      apply_swap(selected[i], element_offset[i]);
+    nswapped += nselected;
+  }
+
+  return nswapped;
+}
+
+void MeshOptimiser::apply_swap(const Swap &s, int new_element){
+  vector<int> nodes;
+  for(int i=0;i<s.nold;i++)
+    for(int j=0;j<4;j++)
+      insert_unique(nodes, ENList[4*s.old_elements[i]+j]);
+  for(size_t i=0;i<nodes.size();i++)
+    for(int j=0;j<s.nold;j++)
+      erase_value(NEList[nodes[i]], s.old_elements[j]);
+
+  const int region = regions[s.old_elements[0]];
+  for(int i=0;i<s.nnew;i++){
+    const int e = i<s.nold?s.old_elements[i]:new_element+i-s.nold;
+    for(int j=0;j<4;j++){
+      ENList[4*e+j] = s.new_elements[i][j];
+      NEList[s.new_elements[i][j]].push_back(e);
+    }
+    regions[e] = region;
+  }
+  for(int i=s.nnew;i<s.nold;i++)
+    for(int j=0;j<4;j++)
+      ENList[4*s.old_elements[i]+j] = -1;
+
+  for(size_t i=0;i<nodes.size();i++)
+    update_neighbours(nodes[i]);
+}
+
+// Rebuild the node-node list of n from its node-element list.
+void MeshOptimiser::update_neighbours(int n){
+  vector<int> &neighbours = NNList[n];
+  neighbours.clear();
+  for(vector<int>::const_iterator it=NEList[n].begin();it!=NEList[n].end();++it)
+    for(int j=0;j<4;j++)
+      if(ENList[4*(*it)+j]!=n)
+        neighbours.push_back(ENList[4*(*it)+j]);
+  sort(neighbours.begin(), neighbours.end());
+  neighbours.erase(unique(neighbours.begin(), neighbours.end()), neighbours.end());
+}
+
+double MeshOptimiser::volume(const int *n) const{
+  return volume(&(coords[3*n[0]]), &(coords[3*n[1]]), &(coords[3*n[2]]), &(coords[3*n[3]]));
+}
+
+// Volume, signed so that the elements as numbered are positive.
+double MeshOptimiser::volume(const double *x0, const double *x1, const double *x2, const double *x3) const{
+  double a[3], b[3], c[3];
+  for(int i=0;i<3;i++){
+    a[i] = x1[i]-x0[i];
+    b[i] = x2[i]-x0[i];
+    c[i] = x3[i]-x0[i];
+  }
+  return orientation*(a[0]*(b[1]*c[2]-b[2]*c[1])
+                      -a[1]*(b[0]*c[2]-b[2]*c[0])
+                      +a[2]*(b[0]*c[1]-b[1]*c[0]))/6.0;
+}
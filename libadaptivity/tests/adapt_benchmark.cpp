@@ -0,0 +1,346 @@
+/* Copyright (C) 2009 Imperial College London.
+
+ Please see the AUTHORS file in the main source directory for a full
+ list of copyright holders.
+
+ Dr Gerard J Gorman
+ Applied Modelling and Computation Group
+ Department of Earth Science and Engineering
+ Imperial College London
+
+ g.gorman@imperial.ac.uk
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+ USA
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "vtk.h"
+
+#include "ErrorMeasure.h"
+#include "Adaptivity.h"
+#include "DiscreteGeometryConstraints.h"
+
+#include "wall_time.h"
+
+/** Benchmark of the adapt pipeline. A unit cube is meshed with
+    n x n x n cubes of six tetrahedra for several n, and for each of
+    an isotropic, a boundary layer and a shock field the metric is
+    formed with ErrorMeasure, graded and the mesh adapted with the
+    Fortran engine and with the threaded engine. Each case runs in its
+    own child process so that its peak resident set size is not hidden
+    by an earlier, larger case. The wall time of each stage, the peak
+    resident set size, the element counts and a histogram of the
+    element quality in metric space are written as JSON
+    (adapt_benchmark.json unless a file name is given):
+
+    adapt_benchmark [file.json [n1 n2 ...]]
+
+    The exit status is non-zero if a case fails or an adapted mesh
+    has an inverted or degenerate element.
+ */
+
+using namespace std;
+
+const int nbins = 10;
+
+/// Analytic fields to adapt to.
+double field(const string &name, const double *x){
+  if(name=="isotropic")
+    return x[0]*x[0] + x[1]*x[1] + x[2]*x[2];
+  else if(name=="boundary_layer")
+    return exp(-x[2]/0.02);
+  else
+    return tanh((x[0] - 0.5 - 0.1*sin(2*M_PI*x[1]))/0.02);
+}
+
+/// Mesh the unit cube with n x n x n cubes of six tetrahedra and
+/// sample the named field at the points as the point data array "u".
+vtkUnstructuredGrid *make_mesh(int n, const string &name){
+  const int np = n+1;
+  const double h = 1.0/n;
+
+  vtkUnstructuredGrid *ug = vtkUnstructuredGrid::New();
+
+  vtkPoints *points = vtkPoints::New();
+  points->SetDataTypeToDouble();
+  points->SetNumberOfPoints(np*np*np);
+
+  vtkDoubleArray *u = vtkDoubleArray::New();
+  u->SetName("u");
+  u->SetNumberOfComponents(1);
+  u->SetNumberOfTuples(np*np*np);
+
+  for(int k=0;k<np;k++)
+    for(int j=0;j<np;j++)
+      for(int i=0;i<np;i++){
+        double x[] = {i*h, j*h, k*h};
+        int p = i + np*(j + np*k);
+        points->SetPoint(p, x);
+        u->SetTuple1(p, field(name, x));
+      }
+  ug->SetPoints(points);
+  ug->GetPointData()->AddArray(u);
+  points->Delete();
+  u->Delete();
+
+  // Kuhn subdivision of a cube: each tetrahedron follows a path from
+  // corner 0 to corner 7 through the corners of the cube.
+  const int paths[6][2] = {{1, 2}, {1, 4}, {2, 1}, {2, 4}, {4, 1}, {4, 2}};
+  ug->Allocate(6*n*n*n);
+  for(int k=0;k<n;k++)
+    for(int j=0;j<n;j++)
+      for(int i=0;i<n;i++){
+        int corner[8];
+        for(int c=0;c<8;c++)
+          corner[c] = (i + (c&1)) + np*((j + ((c>>1)&1)) + np*(k + ((c>>2)&1)));
+
+        for(int t=0;t<6;t++){
+          vtkIdType pts[] = {corner[0], corner[paths[t][0]],
+                             corner[paths[t][0]|paths[t][1]], corner[7]};
+
+          // Number the tetrahedron with positive volume.
+          double x[4][3];
+          for(int l=0;l<4;l++)
+            ug->GetPoints()->GetPoint(pts[l], x[l]);
+          double a[3], b[3], c[3];
+          for(int d=0;d<3;d++){
+            a[d] = x[1][d] - x[0][d];
+            b[d] = x[2][d] - x[0][d];
+            c[d] = x[3][d] - x[0][d];
+          }
+          double vol = a[0]*(b[1]*c[2]-b[2]*c[1])
+            - a[1]*(b[0]*c[2]-b[2]*c[0])
+            + a[2]*(b[0]*c[1]-b[1]*c[0]);
+          if(vol<0)
+            swap(pts[0], pts[1]);
+
+          ug->InsertNextCell(VTK_TETRA, 4, pts);
+        }
+      }
+
+  return ug;
+}
+
+/// Timings and statistics measured by the child process of one case.
+struct Result{
+  int threads;
+  int NNodes, NElements, NNewNodes, NNewElements, NNewSElements;
+  double metric_time, gradation_time, adapt_time;
+  double qmin, qmean;
+  int histogram[nbins];
+};
+
+/// One benchmark case.
+struct Record{
+  string field, engine;
+  int n;
+  Result result;
+  long rss;
+};
+
+/// Form the metric for the field and adapt the mesh with one engine.
+Result run_case(int n, const string &name, bool threaded){
+  Result result;
+#ifdef _OPENMP
+  result.threads = omp_get_max_threads();
+#else
+  result.threads = 1;
+#endif
+
+  vtkUnstructuredGrid *ug = make_mesh(n, name);
+  result.NNodes = ug->GetNumberOfPoints();
+  result.NElements = ug->GetNumberOfCells();
+
+  vector<int> SENList, sids;
+  {
+    DiscreteGeometryConstraints constraints;
+    constraints.set_coplanar_tolerance(0.9999999);
+    constraints.set_volume_input(ug);
+    constraints.get_coplanar_ids(sids);
+    constraints.get_surface(SENList);
+  }
+
+  ErrorMeasure error;
+  double start = wall_time();
+  error.set_input(ug);
+  error.add_field("u", 0.01, false, 0.01);
+  error.set_max_length(0.25);
+  error.set_min_length(0.2/n);
+  result.metric_time = wall_time() - start;
+
+  start = wall_time();
+  error.apply_gradation(1.3);
+  result.gradation_time = wall_time() - start;
+  error.set_max_nodes(20*result.NNodes);
+
+  Adaptivity adapt;
+  adapt.set_from_vtk(ug, false);
+  adapt.set_adapt_sweeps(5);
+  adapt.set_surface_mesh(SENList);
+  adapt.set_surface_ids(sids);
+  if(threaded)
+    adapt.enableThreadedEngine();
+
+  start = wall_time();
+  adapt.adapt();
+  result.adapt_time = wall_time() - start;
+
+  adapt.getMeshDimensions(&result.NNewNodes, &result.NNewElements, &result.NNewSElements);
+
+  vector<double> quality;
+  adapt.get_element_quality(quality);
+  result.qmin = 1.0;
+  result.qmean = 0.0;
+  for(int i=0;i<nbins;i++)
+    result.histogram[i] = 0;
+  for(size_t e=0;e<quality.size();e++){
+    result.qmin = min(result.qmin, quality[e]);
+    result.qmean += quality[e];
+    int bin = (int)(quality[e]*nbins);
+    result.histogram[max(0, min(nbins-1, bin))]++;
+  }
+  if(!quality.empty())
+    result.qmean /= quality.size();
+
+  ug->Delete();
+
+  return result;
+}
+
+/// Run the case in a child process and take the peak resident set
+/// size, in kilobytes, from the child's resource usage. Returns false
+/// if the child failed.
+bool fork_case(Record &record){
+  int fd[2];
+  if(pipe(fd)!=0){
+    cerr<<"ERROR: failed to create a pipe\n";
+    return false;
+  }
+
+  pid_t pid = fork();
+  if(pid<0){
+    cerr<<"ERROR: failed to fork\n";
+    close(fd[0]);
+    close(fd[1]);
+    return false;
+  }
+  if(pid==0){
+    close(fd[0]);
+    Result result = run_case(record.n, record.field, record.engine=="threaded");
+    bool sent = write(fd[1], &result, sizeof(Result))==(ssize_t)sizeof(Result);
+    close(fd[1]);
+    _exit(sent?0:1);
+  }
+
+  close(fd[1]);
+  ssize_t len = read(fd[0], &record.result, sizeof(Result));
+  close(fd[0]);
+
+  int status;
+  struct rusage usage;
+  if(wait4(pid, &status, 0, &usage)!=pid || !WIFEXITED(status) || WEXITSTATUS(status)!=0 ||
+     len!=(ssize_t)sizeof(Result)){
+    cerr<<"ERROR: "<<record.field<<" n="<<record.n<<" "<<record.engine<<" failed\n";
+    return false;
+  }
+  record.rss = usage.ru_maxrss;
+
+  return true;
+}
+
+void write_json(const string &filename, const vector<Record> &records){
+  ofstream json(filename.c_str());
+  json<<"[\n";
+  for(size_t i=0;i<records.size();i++){
+    const Result &r = records[i].result;
+    json<<"  {\"field\": \""<<records[i].field<<"\", \"engine\": \""<<records[i].engine<<"\", "
+        <<"\"n\": "<<records[i].n<<", \"threads\": "<<r.threads<<",\n"
+        <<"   \"nodes\": "<<r.NNodes<<", \"elements\": "<<r.NElements<<", "
+        <<"\"adapted_nodes\": "<<r.NNewNodes<<", \"adapted_elements\": "<<r.NNewElements<<", "
+        <<"\"adapted_surface_elements\": "<<r.NNewSElements<<",\n"
+        <<"   \"metric_time\": "<<r.metric_time<<", \"gradation_time\": "<<r.gradation_time<<", "
+        <<"\"adapt_time\": "<<r.adapt_time<<", \"peak_rss_kb\": "<<records[i].rss<<",\n"
+        <<"   \"quality_min\": "<<r.qmin<<", \"quality_mean\": "<<r.qmean<<", "
+        <<"\"quality_histogram\": [";
+    for(int b=0;b<nbins;b++)
+      json<<(b?", ":"")<<r.histogram[b];
+    json<<"]}"<<(i+1<records.size()?",":"")<<"\n";
+  }
+  json<<"]\n";
+}
+
+int main(int argc, char **argv){
+  string filename("adapt_benchmark.json");
+  if(argc>1)
+    filename = argv[1];
+
+  vector<int> sizes;
+  for(int i=2;i<argc;i++)
+    sizes.push_back(atoi(argv[i]));
+  if(sizes.empty()){
+    sizes.push_back(8);
+    sizes.push_back(16);
+    sizes.push_back(24);
+  }
+
+  const char *fields[] = {"isotropic", "boundary_layer", "shock"};
+
+  vector<Record> records;
+  bool valid = true;
+  for(size_t s=0;s<sizes.size();s++)
+    for(int f=0;f<3;f++)
+      for(int threaded=0;threaded<2;threaded++){
+        Record record;
+        record.field = fields[f];
+        record.engine = threaded?"threaded":"fortran";
+        record.n = sizes[s];
+        if(!fork_case(record)){
+          valid = false;
+          continue;
+        }
+
+        const Result &r = record.result;
+        cout<<record.field<<" n="<<record.n<<" "<<record.engine<<": "
+            <<r.NElements<<" -> "<<r.NNewElements<<" elements, metric "
+            <<r.metric_time<<" s, gradation "<<r.gradation_time<<" s, adapt "
+            <<r.adapt_time<<" s, peak RSS "<<record.rss<<" kB, quality min "<<r.qmin
+            <<" mean "<<r.qmean<<endl;
+        if(r.qmin<=0.0){
+          cerr<<"ERROR: inverted or degenerate elements in the adapted mesh\n";
+          valid = false;
+        }
+        records.push_back(record);
+      }
+
+  write_json(filename, records);
+
+  return valid?0:1;
+}
@@ -30,17 +30,51 @@
 #include <iostream>
 #include <vector>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "vtk.h"
 
 #include "ErrorMeasure.h"
 #include "Adaptivity.h"
 #include "DiscreteGeometryConstraints.h"
 
-/** This test seeks to execute a full adaptive mesh example.
+#include "wall_time.h"
+
+/** This test seeks to execute a full adaptive mesh example. The mesh
+    is adapted to the metric with the Fortran engine and with the
+    threaded C++ engine, and the time, elements per second and element
+    quality in metric space of each are reported.
  */
 
 using namespace std;
 
+vtkUnstructuredGrid *adapt_mesh(vtkUnstructuredGrid *ug, vector<int> SENList, vector<int> sids,
+                                bool threaded, const char *name){
+  Adaptivity adapt;
+  adapt.set_from_vtk(ug, true);
+  adapt.set_adapt_sweeps(5);
+  adapt.set_surface_mesh(SENList);
+  adapt.set_surface_ids(sids);
+  if(threaded)
+    adapt.enableThreadedEngine();
+
+  double start = wall_time();
+  adapt.adapt();
+  double elapsed = wall_time() - start;
+
+  int NNodes, NElements, NSElements;
+  adapt.getMeshDimensions(&NNodes, &NElements, &NSElements);
+  double qmin, qmean;
+  adapt.get_mesh_quality(&qmin, &qmean);
+  cout<<name<<": "<<NElements<<" elements, "<<NSElements<<" surface elements in "
+      <<elapsed<<" s ("<<NElements/elapsed<<" elements/s), quality min "
+      <<qmin<<" mean "<<qmean<<endl;
+
+  return adapt.get_adapted_vtu();
+}
+
 int main(int argc, char **argv){
   vtkXMLUnstructuredGridReader *ug_reader = vtkXMLUnstructuredGridReader::New();
   ug_reader->SetFileName("output.vtu");
@@ -64,64 +98,57 @@ int main(int argc, char **argv){
     cout<<"Found "<<sids.size()<<" surface elements\n";
   }
 
-  for(size_t i=0;i<1;i++){
-    cout<<"Outer iteration: "<<i<<endl;
-    
-    DiscreteGeometryConstraints constraints;
-    constraints.verbose_on();
-    constraints.set_surface_input(ug, SENList, sids);
-    
-    vector<double> max_len;
-    constraints.get_constraints(max_len);
-    constraints.write_vtk(string("sids.vtu"));
-    
-    /* Test merging of metrics.
-     */
-    ErrorMeasure error;
-    error.verbose_on();
-    error.set_input(ug);
-    error.add_field("Vm", 1.0, false, 0.01);
-    error.set_max_length(2.0);
-    error.set_max_length(&(max_len[0]), ug->GetNumberOfPoints());
-    error.set_min_length(0.002);
-    error.apply_gradation(1.3);
-    error.set_max_nodes(200000);
-    
-    error.diagnostics();
-    
-    vtkXMLUnstructuredGridWriter *metric_writer = vtkXMLUnstructuredGridWriter::New();
-    metric_writer->SetFileName("metric.vtu");
-    metric_writer->SetInput(ug);
-    metric_writer->Write();
-    metric_writer->Delete();
-    
-    ug->GetPointData()->RemoveArray("mean_desired_lengths");
-    ug->GetPointData()->RemoveArray("desired_lengths");
-    
-    Adaptivity adapt;
-    adapt.verbose_on();
-    adapt.set_from_vtk(ug, true);
-    adapt.set_adapt_sweeps(5);
-    adapt.set_surface_mesh(SENList);
-    adapt.set_surface_ids(sids);
-    adapt.adapt();
-    adapt.get_surface_ids(sids);
-    adapt.get_surface_mesh(SENList);
-    vtkUnstructuredGrid *tmp_ug = adapt.get_adapted_vtu();
-    if(i>0)
-      ug->Delete();
-    ug = tmp_ug;
-
-    ug->GetPointData()->RemoveArray("metric");
+  DiscreteGeometryConstraints constraints;
+  constraints.verbose_on();
+  constraints.set_surface_input(ug, SENList, sids);
+  
+  vector<double> max_len;
+  constraints.get_constraints(max_len);
+  constraints.write_vtk(string("sids.vtu"));
+  
+  /* Test merging of metrics.
+   */
+  ErrorMeasure error;
+  error.verbose_on();
+  error.set_input(ug);
+  error.add_field("Vm", 1.0, false, 0.01);
+  error.set_max_length(2.0);
+  error.set_max_length(&(max_len[0]), ug->GetNumberOfPoints());
+  error.set_min_length(0.002);
+  error.apply_gradation(1.3);
+  error.set_max_nodes(200000);
+  
+  error.diagnostics();
+  
+  vtkXMLUnstructuredGridWriter *metric_writer = vtkXMLUnstructuredGridWriter::New();
+  metric_writer->SetFileName("metric.vtu");
+  metric_writer->SetInput(ug);
+  metric_writer->Write();
+  metric_writer->Delete();
+  
+  ug->GetPointData()->RemoveArray("mean_desired_lengths");
+  ug->GetPointData()->RemoveArray("desired_lengths");
 
+  cout<<ug->GetNumberOfCells()<<" elements before adapting";
+#ifdef _OPENMP
+  cout<<", "<<omp_get_max_threads()<<" threads";
+#endif
+  cout<<endl;
+
+  const char *names[] = {"Fortran engine", "Threaded engine"};
+  const char *filenames[] = {"adapted.vtu", "adapted_threaded.vtu"};
+  for(int threaded=0;threaded<2;threaded++){
+    vtkUnstructuredGrid *adapted_ug = adapt_mesh(ug, SENList, sids, threaded, names[threaded]);
+    adapted_ug->GetPointData()->RemoveArray("metric");
+
+    vtkXMLUnstructuredGridWriter *ug_writer = vtkXMLUnstructuredGridWriter::New();
+    ug_writer->SetFileName(filenames[threaded]);
+    ug_writer->SetInput(adapted_ug);
+    ug_writer->Write();
+    ug_writer->Delete();
+    adapted_ug->Delete();
   }
-  
-  vtkXMLUnstructuredGridWriter *ug_writer = vtkXMLUnstructuredGridWriter::New();
-  ug_writer->SetFileName("adapted.vtu");
-  ug_writer->SetInput(ug);
-  ug_writer->Write();
 
-  ug_writer->Delete();
   ug_reader->Delete();
   return 0;
 }
@@ -0,0 +1,42 @@
+/* Copyright (C) 2009 Imperial College London.
+
+ Please see the AUTHORS file in the main source directory for a full
+ list of copyright holders.
+
+ Dr Gerard J Gorman
+ Applied Modelling and Computation Group
+ Department of Earth Science and Engineering
+ Imperial College London
+
+ g.gorman@imperial.ac.uk
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+ USA
+*/
+
+#ifndef WALL_TIME_H
+#define WALL_TIME_H
+
+#include <time.h>
+
+/// Seconds on a monotonic clock, for timing the adapt tests whether or
+/// not libadaptivity is built with OpenMP.
+inline double wall_time(){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + 1.0e-9*now.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,172 @@
+/* Copyright (C) 2006- Imperial College London and others.
+
+   Please see the AUTHORS file in the main source directory for a full
+   list of copyright holders.
+
+   Applied Modelling and Computation Group
+   Department of Earth Science and Engineering
+   Imperial College London
+
+   amcgsoftware@imperial.ac.uk
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+   USA
+*/
+
+#ifndef VTUSTREAMWRITER_H
+#define VTUSTREAMWRITER_H
+
+#include "confdefs.h"
+
+#ifdef HAVE_VTK
+
+#include <vtk.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/** Streaming writer for appended, compressed VTU/PVTU files.
+
+    Unlike vtkXMLUnstructuredGridWriter, which needs the complete
+    vtkUnstructuredGrid in memory before anything is written, this writer
+    converts each array straight out of the caller's memory into
+    fixed-size blocks, compresses each block as soon as it is full and
+    appends it to a spill file next to the output. The XML header is only
+    written at close, after which the spill file is copied behind it. Peak
+    memory is therefore one compression block rather than the whole state,
+    and no vtkDataArray is ever built.
+
+    The files produced follow the VTK XML format (version 0.1, UInt32
+    headers, raw appended data) so they are read by any VTK or ParaView.
+
+    A deferred writer only snapshots the data handed to it; close() and
+    pclose() record how the file is to be finished and complete() then
+    does the compression and I/O, typically on a VTUWriterQueue thread.
+
+    Blocks are compressed a batch at a time, one block per thread of the
+    compression settings, each with its own compressor instance.
+*/
+class VTUStreamWriter{
+ public:
+  VTUStreamWriter(const std::string &filename, bool deferred=false);
+  ~VTUStreamWriter();
+
+  bool is_deferred() const;
+
+  /// Write out everything snapshotted by a deferred writer.
+  void complete();
+
+  /// Mesh geometry and topology; enlist counts from one, as in vtkwritemesh.
+  template<typename real_t>
+    void write_mesh(int nnodes, int nelements,
+                    const real_t *x, const real_t *y, const real_t *z,
+                    const int *enlist, const int *element_types, const int *element_sizes);
+
+  /// Nodal (cell_data=false) or cell data given as one pointer per component.
+  template<typename real_t>
+    void write_array(const std::string &name, bool cell_data,
+                     int ncomponents, const real_t * const *components);
+
+  void write_ghost_levels(const int *ghost_levels);
+
+  void set_active(bool cell_data, const char *attribute, const std::string &name);
+
+  /// Finish a serial .vtu file.
+  void close();
+
+  /// Finish this rank's piece and, on rank 0, the .pvtu summary.
+  void pclose(int rank, int npartitions);
+
+  /// Compression used by writers constructed after the call; see
+  /// new_vtu_compressor for codec and level.
+  static void set_compression(const std::string &codec, int level, int nthreads);
+
+  static const size_t block_size = 32768;
+
+ private:
+  struct ArrayInfo{
+    std::string name, type;
+    int ncomponents;
+    long long offset;
+  };
+
+  struct Snapshot{
+    char kind;  // 'm'esh, 'a'rray or 'g'host levels
+    char type;  // 'i'nt, 'f'loat or 'd'ouble
+    std::string name;
+    bool cell_data;
+    int ncomponents;
+    std::vector<char> data;     // one component after another
+    std::vector<int> topology;  // mesh only: types, sizes, then enlist
+  };
+
+  template<typename real_t>
+    void replay(const Snapshot &snapshot);
+
+  template<typename T>
+    inline void put(T value){
+    memcpy(&block[fill], &value, sizeof(T));
+    fill += sizeof(T);
+    if(fill==block.size())
+      flush_blocks();
+  }
+
+  void begin_array(const std::string &name, const std::string &type, int ncomponents,
+                   size_t nbytes, std::vector<ArrayInfo> &arrays);
+  void flush_blocks();
+  void end_array();
+  void write_xml(FILE *out) const;
+  void write_pvtu(const std::string &pvtu_name, const std::string &piece_prefix, int npartitions) const;
+  void finalise(const std::string &name);
+
+  std::string filename, spill_name;
+  FILE *spill;
+  long long spill_size;
+
+  // One compressor, and one block's worth of output, per thread.
+  std::vector<vtkDataCompressor *> compressors;
+  std::vector<unsigned char> block, compressed;
+  std::vector<size_t> compressed_sizes;
+  size_t compression_space, fill;
+
+  static std::string codec;
+  static int level, nthreads;
+
+  // State of the array currently being streamed.
+  long long header_offset;
+  std::vector<unsigned int> header;
+
+  std::vector<ArrayInfo> point_arrays, cell_arrays, mesh_arrays;
+  std::string active_point[3], active_cell[3];
+  std::string points_type;
+  int nnodes, nelements;
+
+  bool deferred;
+  std::vector<Snapshot> snapshots;
+  // Rank and partition count passed to pclose, or -1 after close.
+  int close_rank, close_npartitions;
+};
+
+/** Create the VTK compressor for codec "zlib", "lz4" or "lzma" at level
+    (1 fastest to 9 smallest; anything else keeps the codec's default).
+    lz4 and lzma need VTK 8.2 or newer, otherwise zlib is used. The
+    caller owns the result.
+*/
+vtkDataCompressor *new_vtu_compressor(const std::string &codec, int level);
+
+#endif
+#endif
@@ -0,0 +1,85 @@
+/* Copyright (C) 2006- Imperial College London and others.
+
+   Please see the AUTHORS file in the main source directory for a full
+   list of copyright holders.
+
+   Applied Modelling and Computation Group
+   Department of Earth Science and Engineering
+   Imperial College London
+
+   amcgsoftware@imperial.ac.uk
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+   USA
+*/
+
+#ifndef VTUWRITERQUEUE_H
+#define VTUWRITERQUEUE_H
+
+#include "confdefs.h"
+
+#ifdef HAVE_VTK
+
+#include <deque>
+
+#include <pthread.h>
+
+#include "vtustreamwriter.h"
+
+/** Bounded queue of deferred VTUStreamWriters completed by one
+    background thread.
+
+    push() takes ownership of a writer whose data has been snapshotted
+    and returns as soon as there is room in the queue, so the simulation
+    carries on while the previous dump is compressed and written. With a
+    depth of one this is plain double buffering: one dump being written,
+    the next being filled. With a depth of zero, the default, push()
+    writes the dump itself before returning.
+*/
+class VTUWriterQueue{
+ public:
+  VTUWriterQueue();
+  ~VTUWriterQueue();
+
+  void set_depth(int depth);
+  int get_depth() const;
+
+  void push(VTUStreamWriter *writer);
+
+  /// Block until every queued dump is on disk.
+  void flush();
+
+  /// Seconds the caller spent waiting for room in the queue (or in
+  /// flush), and seconds the background thread spent writing, since the
+  /// last call.
+  void get_times(double &wait_time, double &write_time);
+
+ private:
+  static void *run(void *queue);
+  static double wall_time();
+
+  int depth;
+  bool running, shutdown;
+  int busy;
+  std::deque<VTUStreamWriter *> writers;
+  double wait_time, write_time;
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t not_empty, not_full;
+};
+
+#endif
+#endif
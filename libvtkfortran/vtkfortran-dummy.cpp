@@ -29,6 +29,14 @@
 
 extern "C"{
   void vtkopen(char *outName, int *len1, char *vtkTitle, int *len2){}
+  void vtksetstreaming(int *flag){}
+  void vtksetasynchronous(int *depth){}
+  void vtksetcompression(char *codec, int *len, int *level, int *nthreads){}
+  void vtkflush(){}
+  void vtkgetdumptimes(double *wait_time, double *write_time){
+    *wait_time = 0.0;
+    *write_time = 0.0;
+  }
   void vtkwritemesh(int *NNodes, int *NElems, 
 		       float *x, float *y, float *z,
 		       int *enlist, int *elementTypes, int *elementSizes){}
@@ -41,11 +41,14 @@
 #include <string>
 
 #include <cassert>
+#include <cstring>
 
 #include <sys/stat.h>
 #include <sys/types.h>
 
 #include "tinyxml.h"
+#include "vtustreamwriter.h"
+#include "vtuwriterqueue.h"
 
 using namespace std;
 
@@ -54,6 +57,19 @@ static string fl_vtkFileName;
 static unsigned ncnt;
 static unsigned ecnt;
 
+// When set, vtkopen hands the dump to a VTUStreamWriter instead of
+// building a vtkUnstructuredGrid.
+static bool streamingOutput = false;
+static VTUStreamWriter *streamWriter = NULL;
+
+// Deferred writers are completed on this queue's thread when its depth
+// is non-zero.
+static VTUWriterQueue writerQueue;
+
+// Compressor for the appended data, see new_vtu_compressor.
+static string compressionCodec = "zlib";
+static int compressionLevel = -1;
+
 
 int pvtu_search_and_replace(TiXmlElement *pElement, const char *dir){
   if (!pElement) return 0;
@@ -124,10 +140,70 @@ extern "C" {
 #endif
     string title(vtkTitle, *len2);
     fl_vtkFileName = string(outName, *len1);
+
+    if(streamingOutput || writerQueue.get_depth()>0){
+      dataSet->Delete();
+      dataSet = NULL;
+      streamWriter = new VTUStreamWriter(fl_vtkFileName, writerQueue.get_depth()>0);
+    }
     
     return;
   }
 
+  /**
+     Select the streaming writer for subsequent dumps. Must be called
+     before vtkopen.
+     @param[in] flag Non-zero to stream arrays to disk as they are written.
+  */
+  void vtksetstreaming(int *flag){
+    streamingOutput = (*flag)!=0;
+    return;
+  }
+
+  /**
+     Select the asynchronous writer for subsequent dumps. Each dump is
+     snapshotted at close and compressed and written by a background
+     thread. Must be called before vtkopen.
+     @param[in] depth Maximum number of dumps queued or being written;
+     0 writes synchronously.
+  */
+  void vtksetasynchronous(int *depth){
+    writerQueue.set_depth(*depth);
+    return;
+  }
+
+  /**
+     Select the compression of subsequent dumps.
+     @param[in] codec "zlib", "lz4" or "lzma"; the latter two need VTK 8.2 or newer.
+     @param[in] len Length of codec.
+     @param[in] level Compression level from 1 (fastest) to 9 (smallest); anything else keeps the default.
+     @param[in] nthreads Number of blocks compressed in parallel by the streaming and asynchronous writers.
+  */
+  void vtksetcompression(char *codec, int *len, int *level, int *nthreads){
+    compressionCodec = string(codec, *len);
+    compressionLevel = *level;
+    VTUStreamWriter::set_compression(compressionCodec, compressionLevel, *nthreads);
+    return;
+  }
+
+  /**
+     Wait until all dumps handed to the asynchronous writer are on disk.
+  */
+  void vtkflush(){
+    writerQueue.flush();
+    return;
+  }
+
+  /**
+     Time spent on asynchronous dumps since the last call.
+     @param[out] wait_time Seconds the caller was blocked on a full queue or in vtkflush.
+     @param[out] write_time Seconds the background thread spent compressing and writing.
+  */
+  void vtkgetdumptimes(double *wait_time, double *write_time){
+    writerQueue.get_times(*wait_time, *write_time);
+    return;
+  }
+
   /**
      Writes the mesh geometry.
      @param[in] NNodes Total number of nodes.
@@ -143,16 +219,20 @@ extern "C" {
     ncnt = *NNodes;
     ecnt = *NElems;
 
+    if(streamWriter){
+      streamWriter->write_mesh(ncnt, ecnt, x, y, z, enlist, elementTypes, elementSizes);
+      return;
+    }
+
     // Point definitions  
     vtkPoints *newPts = vtkPoints::New();
     newPts->SetDataTypeToFloat();
+    newPts->SetNumberOfPoints(ncnt);
+    float *xyz = (float *)newPts->GetVoidPointer(0);
     for(unsigned i=0; i<ncnt; i++){
-      float xyz[3];
-      xyz[0] = x[i]; 
-      xyz[1] = y[i]; 
-      xyz[2] = z[i]; 
-    
-      newPts->InsertPoint(i, xyz);
+      xyz[3*i  ] = x[i]; 
+      xyz[3*i+1] = y[i]; 
+      xyz[3*i+2] = z[i]; 
     }
     dataSet->SetPoints(newPts);
 
@@ -203,16 +283,20 @@ extern "C" {
     ncnt = *NNodes;
     ecnt = *NElems;
 
+    if(streamWriter){
+      streamWriter->write_mesh(ncnt, ecnt, x, y, z, enlist, elementTypes, elementSizes);
+      return;
+    }
+
     // Point definitions  
     vtkPoints *newPts = vtkPoints::New();
     newPts->SetDataTypeToDouble();
+    newPts->SetNumberOfPoints(ncnt);
+    double *xyz = (double *)newPts->GetVoidPointer(0);
     for(unsigned i=0; i<ncnt; i++){
-      double xyz[3];
-      xyz[0] = x[i]; 
-      xyz[1] = y[i]; 
-      xyz[2] = z[i]; 
-    
-      newPts->InsertPoint(i, xyz);
+      xyz[3*i  ] = x[i]; 
+      xyz[3*i+1] = y[i]; 
+      xyz[3*i+2] = z[i]; 
     }
     dataSet->SetPoints(newPts);
 
@@ -258,13 +342,19 @@ extern "C" {
   */
   void vtkwriteisn(int *vect, char *name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      const int *components[] = {vect};
+      streamWriter->write_array(tag, false, 1, components);
+      streamWriter->set_active(false, "Scalars", tag);
+      return;
+    }
+
     vtkIntArray *newScalars = vtkIntArray::New();
     newScalars->SetName( tag.c_str() );
     newScalars->SetNumberOfComponents(1);
     newScalars->SetNumberOfTuples(ncnt);
 
-    for(unsigned i=0; i<ncnt; i++)
-      newScalars->InsertValue(i, vect[i]);
+    memcpy(newScalars->GetPointer(0), vect, ncnt*sizeof(int));
   
     dataSet->GetPointData()->AddArray(newScalars);
     dataSet->GetPointData()->SetActiveAttribute(tag.c_str(), vtkDataSetAttributes::SCALARS);
@@ -281,14 +371,19 @@ extern "C" {
   */
   void vtkwritefsn(float *vect, char *name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      const float *components[] = {vect};
+      streamWriter->write_array(tag, false, 1, components);
+      streamWriter->set_active(false, "Scalars", tag);
+      return;
+    }
+
     vtkFloatArray *newScalars = vtkFloatArray::New();
     newScalars->SetName( tag.c_str() );
     newScalars->SetNumberOfComponents(1);
     newScalars->SetNumberOfTuples(ncnt);
-  
-  
-    for(unsigned i=0; i<ncnt; i++)
-      newScalars->InsertValue(i, vect[i]);
+
+    memcpy(newScalars->GetPointer(0), vect, ncnt*sizeof(float));
   
     dataSet->GetPointData()->AddArray(newScalars);
     dataSet->GetPointData()->SetActiveAttribute(tag.c_str(), vtkDataSetAttributes::SCALARS);
@@ -305,14 +400,19 @@ extern "C" {
   */
   void vtkwritedsn(double *vect, char *name, int *len){ 
     string tag(name, *len);
+    if(streamWriter){
+      const double *components[] = {vect};
+      streamWriter->write_array(tag, false, 1, components);
+      streamWriter->set_active(false, "Scalars", tag);
+      return;
+    }
+
     vtkDoubleArray *newScalars = vtkDoubleArray::New();
     newScalars->SetName( tag.c_str() );
     newScalars->SetNumberOfComponents(1);
     newScalars->SetNumberOfTuples(ncnt);
-  
-  
-    for(unsigned i=0; i<ncnt; i++)
-      newScalars->InsertValue(i, vect[i]);
+
+    memcpy(newScalars->GetPointer(0), vect, ncnt*sizeof(double));
   
     dataSet->GetPointData()->AddArray(newScalars);
     dataSet->GetPointData()->SetActiveAttribute(tag.c_str(), vtkDataSetAttributes::SCALARS);
@@ -330,14 +430,24 @@ extern "C" {
   void vtkwritefvn(float *vx, float *vy, float *vz,
 		      char *name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      const float *components[] = {vx, vy, vz};
+      streamWriter->write_array(tag, false, 3, components);
+      streamWriter->set_active(false, "Vectors", tag);
+      return;
+    }
+
     vtkFloatArray *newVectors = vtkFloatArray::New();  
   
     newVectors->SetName( tag.c_str() );
     newVectors->SetNumberOfComponents(3);
     newVectors->SetNumberOfTuples(ncnt);
 
+    float *tuple = newVectors->GetPointer(0);
     for(unsigned i=0; i<ncnt; i++){
-      newVectors->SetTuple3(i, vx[i], vy[i], vz[i]);
+      tuple[3*i  ] = vx[i];
+      tuple[3*i+1] = vy[i];
+      tuple[3*i+2] = vz[i];
     }
 
     dataSet->GetPointData()->AddArray(newVectors);
@@ -356,14 +466,24 @@ extern "C" {
   void vtkwritedvn(double *vx, double *vy, double *vz,
 		      char *name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      const double *components[] = {vx, vy, vz};
+      streamWriter->write_array(tag, false, 3, components);
+      streamWriter->set_active(false, "Vectors", tag);
+      return;
+    }
+
     vtkDoubleArray *newVectors = vtkDoubleArray::New();  
   
     newVectors->SetName( tag.c_str() );
     newVectors->SetNumberOfComponents(3);
     newVectors->SetNumberOfTuples(ncnt);
 
+    double *tuple = newVectors->GetPointer(0);
     for(unsigned i=0; i<ncnt; i++){
-      newVectors->SetTuple3(i, vx[i], vy[i], vz[i]);
+      tuple[3*i  ] = vx[i];
+      tuple[3*i+1] = vy[i];
+      tuple[3*i+2] = vz[i];
     }
 
     dataSet->GetPointData()->AddArray(newVectors);
@@ -384,17 +504,24 @@ extern "C" {
 		      float *v7, float *v8, float *v9, 
 		      char *name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      const float *components[] = {v1, v2, v3, v4, v5, v6, v7, v8, v9};
+      streamWriter->write_array(tag, false, 9, components);
+      streamWriter->set_active(false, "Tensors", tag);
+      return;
+    }
+
     vtkFloatArray *newTensors = vtkFloatArray::New();  
   
     newTensors->SetName( tag.c_str() );
     newTensors->SetNumberOfComponents(9);
     newTensors->SetNumberOfTuples(ncnt);
   
+    const float *components[] = {v1, v2, v3, v4, v5, v6, v7, v8, v9};
+    float *tuple = newTensors->GetPointer(0);
     for(unsigned i=0; i<ncnt; i++){
-      newTensors->SetTuple9(i, 
-			    v1[i], v2[i], v3[i],
-			    v4[i], v5[i], v6[i],
-			    v7[i], v8[i], v9[i]);
+      for(int j=0; j<9; j++)
+        tuple[9*i+j] = components[j][i];
     }
   
     dataSet->GetPointData()->AddArray(newTensors);
@@ -417,17 +544,24 @@ extern "C" {
 		      double *v7, double *v8, double *v9, 
 		      char *name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      const double *components[] = {v1, v2, v3, v4, v5, v6, v7, v8, v9};
+      streamWriter->write_array(tag, false, 9, components);
+      streamWriter->set_active(false, "Tensors", tag);
+      return;
+    }
+
     vtkDoubleArray *newTensors = vtkDoubleArray::New();  
   
     newTensors->SetName( tag.c_str() );
     newTensors->SetNumberOfComponents(9);
     newTensors->SetNumberOfTuples(ncnt);
   
+    const double *components[] = {v1, v2, v3, v4, v5, v6, v7, v8, v9};
+    double *tuple = newTensors->GetPointer(0);
     for(unsigned i=0; i<ncnt; i++){
-      newTensors->SetTuple9(i, 
-			    v1[i], v2[i], v3[i],
-			    v4[i], v5[i], v6[i],
-			    v7[i], v8[i], v9[i]);
+      for(int j=0; j<9; j++)
+        tuple[9*i+j] = components[j][i];
     }
   
     dataSet->GetPointData()->AddArray(newTensors);
@@ -449,13 +583,19 @@ extern "C" {
   */
   void vtkwriteisc(int *vect, char *name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      const int *components[] = {vect};
+      streamWriter->write_array(tag, true, 1, components);
+      streamWriter->set_active(true, "Scalars", tag);
+      return;
+    }
+
     vtkIntArray *newScalars = vtkIntArray::New();
     newScalars->SetName( tag.c_str() );
     newScalars->SetNumberOfComponents(1);
     newScalars->SetNumberOfTuples(ecnt);
 
-    for(unsigned i=0; i<ecnt; i++)
-      newScalars->InsertValue(i, vect[i]);
+    memcpy(newScalars->GetPointer(0), vect, ecnt*sizeof(int));
   
     dataSet->GetCellData()->AddArray(newScalars);
     dataSet->GetCellData()->SetActiveAttribute(tag.c_str(), vtkDataSetAttributes::SCALARS);
@@ -470,13 +610,19 @@ extern "C" {
      @param[in] ghost_levels This array is 0 for owned elements, 1 otherwise.
   */
   void vtkwriteghostlevels(int *ghost_levels){
+    if(streamWriter){
+      streamWriter->write_ghost_levels(ghost_levels);
+      return;
+    }
+
     vtkUnsignedCharArray *newScalars = vtkUnsignedCharArray::New();
     newScalars->SetName("vtkGhostLevels");
     newScalars->SetNumberOfComponents(1);
     newScalars->SetNumberOfTuples(ecnt);
 
+    unsigned char *ghosts = newScalars->GetPointer(0);
     for(unsigned i=0; i<ecnt; i++)
-      newScalars->InsertValue(i, ghost_levels[i]);
+      ghosts[i] = ghost_levels[i];
   
     dataSet->GetCellData()->AddArray(newScalars);
     dataSet->GetCellData()->SetActiveAttribute("vtkGhostLevels", vtkDataSetAttributes::SCALARS);
@@ -493,14 +639,19 @@ extern "C" {
   */
   void vtkwritefsc(float *vect, char *name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      const float *components[] = {vect};
+      streamWriter->write_array(tag, true, 1, components);
+      streamWriter->set_active(true, "Scalars", tag);
+      return;
+    }
+
     vtkFloatArray *newScalars = vtkFloatArray::New();
     newScalars->SetName( tag.c_str() );
     newScalars->SetNumberOfComponents(1);
     newScalars->SetNumberOfTuples(ecnt);
-  
-  
-    for(unsigned i=0; i<ecnt; i++)
-      newScalars->InsertValue(i, vect[i]);
+
+    memcpy(newScalars->GetPointer(0), vect, ecnt*sizeof(float));
   
     dataSet->GetCellData()->AddArray(newScalars);
     dataSet->GetCellData()->SetActiveAttribute(tag.c_str(), vtkDataSetAttributes::SCALARS);
@@ -517,14 +668,19 @@ extern "C" {
   */
   void vtkwritedsc(double *vect, char *name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      const double *components[] = {vect};
+      streamWriter->write_array(tag, true, 1, components);
+      streamWriter->set_active(true, "Scalars", tag);
+      return;
+    }
+
     vtkDoubleArray *newScalars = vtkDoubleArray::New();
     newScalars->SetName( tag.c_str() );
     newScalars->SetNumberOfComponents(1);
     newScalars->SetNumberOfTuples(ecnt);
-  
-  
-    for(unsigned i=0; i<ecnt; i++)
-      newScalars->InsertValue(i, vect[i]);
+
+    memcpy(newScalars->GetPointer(0), vect, ecnt*sizeof(double));
   
     dataSet->GetCellData()->AddArray(newScalars);
     dataSet->GetCellData()->SetActiveAttribute(tag.c_str(), vtkDataSetAttributes::SCALARS);
@@ -542,14 +698,24 @@ extern "C" {
   void vtkwritefvc(float *vx, float *vy, float *vz,
                       char *name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      const float *components[] = {vx, vy, vz};
+      streamWriter->write_array(tag, true, 3, components);
+      streamWriter->set_active(true, "Vectors", tag);
+      return;
+    }
+
     vtkFloatArray *newVectors = vtkFloatArray::New();  
   
     newVectors->SetName( tag.c_str() );
     newVectors->SetNumberOfComponents(3);
     newVectors->SetNumberOfTuples(ecnt);
 
+    float *tuple = newVectors->GetPointer(0);
     for(unsigned i=0; i<ecnt; i++){
-      newVectors->SetTuple3(i, vx[i], vy[i], vz[i]);
+      tuple[3*i  ] = vx[i];
+      tuple[3*i+1] = vy[i];
+      tuple[3*i+2] = vz[i];
     }
 
     dataSet->GetCellData()->AddArray(newVectors);
@@ -568,14 +734,24 @@ extern "C" {
   void vtkwritedvc(double *vx, double *vy, double *vz,
           char *name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      const double *components[] = {vx, vy, vz};
+      streamWriter->write_array(tag, true, 3, components);
+      streamWriter->set_active(true, "Vectors", tag);
+      return;
+    }
+
     vtkDoubleArray *newVectors = vtkDoubleArray::New();  
   
     newVectors->SetName( tag.c_str() );
     newVectors->SetNumberOfComponents(3);
     newVectors->SetNumberOfTuples(ecnt);
 
+    double *tuple = newVectors->GetPointer(0);
     for(unsigned i=0; i<ecnt; i++){
-      newVectors->SetTuple3(i, vx[i], vy[i], vz[i]);
+      tuple[3*i  ] = vx[i];
+      tuple[3*i+1] = vy[i];
+      tuple[3*i+2] = vz[i];
     }
 
     dataSet->GetCellData()->AddArray(newVectors);
@@ -596,17 +772,24 @@ extern "C" {
                       float *v7, float *v8, float *v9, 
                       char *name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      const float *components[] = {v1, v2, v3, v4, v5, v6, v7, v8, v9};
+      streamWriter->write_array(tag, true, 9, components);
+      streamWriter->set_active(true, "Tensors", tag);
+      return;
+    }
+
     vtkFloatArray *newTensors = vtkFloatArray::New();  
   
     newTensors->SetName( tag.c_str() );
     newTensors->SetNumberOfComponents(9);
     newTensors->SetNumberOfTuples(ecnt);
   
+    const float *components[] = {v1, v2, v3, v4, v5, v6, v7, v8, v9};
+    float *tuple = newTensors->GetPointer(0);
     for(unsigned i=0; i<ecnt; i++){
-      newTensors->SetTuple9(i, 
-          v1[i], v2[i], v3[i],
-          v4[i], v5[i], v6[i],
-          v7[i], v8[i], v9[i]);
+      for(int j=0; j<9; j++)
+        tuple[9*i+j] = components[j][i];
     }
   
     dataSet->GetCellData()->AddArray(newTensors);
@@ -629,17 +812,24 @@ extern "C" {
                       double *v7, double *v8, double *v9, 
                       char *name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      const double *components[] = {v1, v2, v3, v4, v5, v6, v7, v8, v9};
+      streamWriter->write_array(tag, true, 9, components);
+      streamWriter->set_active(true, "Tensors", tag);
+      return;
+    }
+
     vtkDoubleArray *newTensors = vtkDoubleArray::New();  
   
     newTensors->SetName( tag.c_str() );
     newTensors->SetNumberOfComponents(9);
     newTensors->SetNumberOfTuples(ecnt);
   
+    const double *components[] = {v1, v2, v3, v4, v5, v6, v7, v8, v9};
+    double *tuple = newTensors->GetPointer(0);
     for(unsigned i=0; i<ecnt; i++){
-      newTensors->SetTuple9(i, 
-          v1[i], v2[i], v3[i],
-          v4[i], v5[i], v6[i],
-          v7[i], v8[i], v9[i]);
+      for(int j=0; j<9; j++)
+        tuple[9*i+j] = components[j][i];
     }
   
     dataSet->GetCellData()->AddArray(newTensors);
@@ -655,12 +845,22 @@ extern "C" {
      Finish writing and close vtk file (serial).
    */
   void vtkclose(){
+    if(streamWriter){
+      streamWriter->close();
+      if(streamWriter->is_deferred())
+        writerQueue.push(streamWriter);
+      else
+        delete streamWriter;
+      streamWriter = NULL;
+      return;
+    }
+
     vtkXMLUnstructuredGridWriter *writer= vtkXMLUnstructuredGridWriter::New();
     
 #ifdef DEBUG
     writer->DebugOn();
 #endif
-    vtkZLibDataCompressor* compressor = vtkZLibDataCompressor::New();
+    vtkDataCompressor* compressor = new_vtu_compressor(compressionCodec, compressionLevel);
 
 #ifdef DEBUG
     cerr<<"fl_vtkFileName - "<<fl_vtkFileName<<endl;
@@ -699,7 +899,7 @@ extern "C" {
 #ifdef DEBUG
     writer->DebugOn();
 #endif
-    vtkZLibDataCompressor* compressor = vtkZLibDataCompressor::New();
+    vtkDataCompressor* compressor = new_vtu_compressor(compressionCodec, compressionLevel);
     
     writer->SetDataModeToBinary();
 #ifdef DEBUG
@@ -768,6 +968,15 @@ extern "C" {
      Finish writing and close vtk file (parallel).
   */
   void vtkpclose(int *rank, int *npartitions){
+    if(streamWriter){
+      streamWriter->pclose(*rank, *npartitions);
+      if(streamWriter->is_deferred())
+        writerQueue.push(streamWriter);
+      else
+        delete streamWriter;
+      streamWriter = NULL;
+      return;
+    }
 
     _vtkpclose_nointerleave(rank, npartitions);
     return;
@@ -778,6 +987,10 @@ extern "C" {
    */
   void vtksetactivescalars(char* name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      streamWriter->set_active(false, "Scalars", tag);
+      return;
+    }
     dataSet->GetPointData()->SetActiveAttribute(tag.c_str(), vtkDataSetAttributes::SCALARS);
     return;
   }
@@ -787,6 +1000,10 @@ extern "C" {
    */
   void vtksetactivevectors(char* name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      streamWriter->set_active(false, "Vectors", tag);
+      return;
+    }
     dataSet->GetPointData()->SetActiveAttribute(tag.c_str(), vtkDataSetAttributes::VECTORS);
     return;
   }
@@ -796,6 +1013,10 @@ extern "C" {
    */
   void vtksetactivetensors(char* name, int *len){
     string tag(name, *len);
+    if(streamWriter){
+      streamWriter->set_active(false, "Tensors", tag);
+      return;
+    }
     dataSet->GetPointData()->SetActiveAttribute(tag.c_str(), vtkDataSetAttributes::TENSORS);
     return;
   }
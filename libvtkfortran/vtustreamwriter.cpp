@@ -0,0 +1,541 @@
+/* Copyright (C) 2006- Imperial College London and others.
+
+   Please see the AUTHORS file in the main source directory for a full
+   list of copyright holders.
+
+   Applied Modelling and Computation Group
+   Department of Earth Science and Engineering
+   Imperial College London
+
+   amcgsoftware@imperial.ac.uk
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+   USA
+*/
+
+#include "confdefs.h"
+
+#ifdef HAVE_VTK
+
+#include "vtustreamwriter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if VTK_MAJOR_VERSION>8 || (VTK_MAJOR_VERSION==8 && VTK_MINOR_VERSION>=2)
+#define VTK_HAS_LZ4_LZMA 1
+#endif
+
+using namespace std;
+
+namespace{
+  const char *vtk_type_name(float){return "Float32";}
+  const char *vtk_type_name(double){return "Float64";}
+  const char *vtk_type_name(int){return "Int32";}
+
+  char type_code(float){return 'f';}
+  char type_code(double){return 'd';}
+  char type_code(int){return 'i';}
+
+  const char *byte_order(){
+    const unsigned short one = 1;
+    return (*(const unsigned char *)&one) ? "LittleEndian" : "BigEndian";
+  }
+
+  string basename_of(const string &path){
+    size_t slash = path.rfind('/');
+    return slash==string::npos ? path : path.substr(slash+1);
+  }
+}
+
+vtkDataCompressor *new_vtu_compressor(const string &codec, int level){
+  bool set_level = level>=1 && level<=9;
+
+#ifdef VTK_HAS_LZ4_LZMA
+  vtkDataCompressor *compressor = NULL;
+  if(codec=="lz4")
+    compressor = vtkLZ4DataCompressor::New();
+  else if(codec=="lzma")
+    compressor = vtkLZMADataCompressor::New();
+  if(compressor!=NULL){
+    if(set_level)
+      compressor->SetCompressionLevel(level);
+    return compressor;
+  }
+#else
+  if(codec=="lz4"||codec=="lzma")
+    cerr<<"WARNING: "<<codec<<" compression needs VTK 8.2 or newer, using zlib"<<endl;
+#endif
+
+  vtkZLibDataCompressor *zlib = vtkZLibDataCompressor::New();
+  if(set_level)
+    zlib->SetCompressionLevel(level);
+  return zlib;
+}
+
+const size_t VTUStreamWriter::block_size;
+string VTUStreamWriter::codec = "zlib";
+int VTUStreamWriter::level = -1;
+int VTUStreamWriter::nthreads = 1;
+
+void VTUStreamWriter::set_compression(const string &_codec, int _level, int _nthreads){
+  codec = _codec;
+  level = _level;
+  nthreads = max(_nthreads, 1);
+}
+
+VTUStreamWriter::VTUStreamWriter(const string &_filename, bool _deferred) :
+  filename(_filename), spill(NULL), spill_size(0), fill(0),
+  header_offset(0), nnodes(0), nelements(0), deferred(_deferred),
+  close_rank(-1), close_npartitions(1){
+
+  compressors.resize(nthreads);
+  for(int i=0; i<nthreads; i++)
+    compressors[i] = new_vtu_compressor(codec, level);
+  compression_space = compressors[0]->GetMaximumCompressionSpace(block_size);
+
+  block.resize(nthreads*block_size);
+  compressed.resize(nthreads*compression_space);
+  compressed_sizes.resize(nthreads);
+
+  // Every rank writing a piece of the same file needs a spill file of
+  // its own.
+  vector<char> name(filename.begin(), filename.end());
+  const char suffix[] = ".part.XXXXXX";
+  name.insert(name.end(), suffix, suffix+sizeof(suffix));
+  int fd = mkstemp(&name[0]);
+  spill_name = &name[0];
+  if(fd>=0)
+    spill = fdopen(fd, "w+b");
+  if(spill==NULL){
+    cerr<<"ERROR: Failed to open "<<spill_name<<" for writing"<<endl;
+    if(fd>=0){
+      ::close(fd);
+      remove(spill_name.c_str());
+    }
+  }
+}
+
+VTUStreamWriter::~VTUStreamWriter(){
+  if(spill!=NULL){
+    fclose(spill);
+    remove(spill_name.c_str());
+  }
+  for(size_t i=0; i<compressors.size(); i++)
+    compressors[i]->Delete();
+}
+
+bool VTUStreamWriter::is_deferred() const{
+  return deferred;
+}
+
+void VTUStreamWriter::begin_array(const string &name, const string &type, int ncomponents,
+                                  size_t nbytes, vector<ArrayInfo> &arrays){
+  assert(fill==0);
+
+  ArrayInfo info;
+  info.name = name;
+  info.type = type;
+  info.ncomponents = ncomponents;
+  info.offset = spill_size;
+  arrays.push_back(info);
+
+  // Compression header: number of blocks, block size, size of the last
+  // partial block (0 if full), then the compressed size of each block.
+  // The block sizes are patched in by end_array.
+  size_t nblocks = (nbytes+block_size-1)/block_size;
+  header.assign(3+nblocks, 0);
+  header[0] = nblocks;
+  header[1] = block_size;
+  header[2] = nbytes%block_size;
+
+  header_offset = spill_size;
+  if(spill!=NULL)
+    fwrite(&header[0], sizeof(unsigned int), header.size(), spill);
+  spill_size += sizeof(unsigned int)*header.size();
+  header.resize(3);
+}
+
+void VTUStreamWriter::flush_blocks(){
+  if(fill==0)
+    return;
+
+  // Compress the batch block-parallel, then append the blocks in order.
+  int nblocks = (fill+block_size-1)/block_size;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) num_threads(nblocks) if(nblocks>1)
+#endif
+  for(int b=0; b<nblocks; b++){
+    size_t nbytes = min(block_size, fill-b*block_size);
+    compressed_sizes[b] = compressors[b]->Compress(&block[b*block_size], nbytes,
+                                                   &compressed[b*compression_space], compression_space);
+  }
+
+  for(int b=0; b<nblocks; b++){
+    if(spill!=NULL)
+      fwrite(&compressed[b*compression_space], 1, compressed_sizes[b], spill);
+    spill_size += compressed_sizes[b];
+    header.push_back(compressed_sizes[b]);
+  }
+  fill = 0;
+}
+
+void VTUStreamWriter::end_array(){
+  flush_blocks();
+
+  if(spill==NULL)
+    return;
+
+  assert(header.size()==3+header[0]);
+  fseeko(spill, header_offset, SEEK_SET);
+  fwrite(&header[0], sizeof(unsigned int), header.size(), spill);
+  fseeko(spill, 0, SEEK_END);
+}
+
+template<typename real_t>
+void VTUStreamWriter::write_mesh(int _nnodes, int _nelements,
+                                 const real_t *x, const real_t *y, const real_t *z,
+                                 const int *enlist, const int *element_types, const int *element_sizes){
+  nnodes = _nnodes;
+  nelements = _nelements;
+  points_type = vtk_type_name(real_t());
+
+  if(deferred){
+    Snapshot snapshot;
+    snapshot.kind = 'm';
+    snapshot.type = type_code(real_t());
+    snapshot.data.resize(3*sizeof(real_t)*nnodes);
+    const real_t *xyz[] = {x, y, z};
+    for(int d=0; d<3; d++)
+      memcpy(&snapshot.data[d*sizeof(real_t)*nnodes], xyz[d], sizeof(real_t)*nnodes);
+    snapshot.topology.assign(element_types, element_types+nelements);
+    snapshot.topology.insert(snapshot.topology.end(), element_sizes, element_sizes+nelements);
+    size_t nentries = 0;
+    for(int i=0; i<nelements; i++)
+      nentries += element_sizes[i];
+    snapshot.topology.insert(snapshot.topology.end(), enlist, enlist+nentries);
+    snapshots.push_back(snapshot);
+    return;
+  }
+
+  begin_array("Points", points_type, 3, 3*sizeof(real_t)*nnodes, mesh_arrays);
+  for(int i=0; i<nnodes; i++){
+    put(x[i]);
+    put(y[i]);
+    put(z[i]);
+  }
+  end_array();
+
+  size_t nentries = 0;
+  for(int i=0; i<nelements; i++)
+    nentries += element_sizes[i];
+
+  begin_array("connectivity", "Int32", 1, sizeof(int)*nentries, mesh_arrays);
+  const int *elem = enlist;
+  for(int i=0; i<nelements; i++){
+    // Node ordering blues
+    if(element_types[i]==9){
+      put(elem[0]-1); put(elem[1]-1); put(elem[3]-1); put(elem[2]-1);
+    }else if(element_types[i]==12){
+      put(elem[0]-1); put(elem[1]-1); put(elem[3]-1); put(elem[2]-1);
+      put(elem[4]-1); put(elem[5]-1); put(elem[7]-1); put(elem[6]-1);
+    }else{
+      for(int j=0; j<element_sizes[i]; j++)
+        put(elem[j]-1);
+    }
+    elem += element_sizes[i];
+  }
+  end_array();
+
+  begin_array("offsets", "Int32", 1, sizeof(int)*nelements, mesh_arrays);
+  int offset = 0;
+  for(int i=0; i<nelements; i++){
+    offset += element_sizes[i];
+    put(offset);
+  }
+  end_array();
+
+  begin_array("types", "UInt8", 1, nelements, mesh_arrays);
+  for(int i=0; i<nelements; i++)
+    put((unsigned char)element_types[i]);
+  end_array();
+}
+
+template<typename real_t>
+void VTUStreamWriter::write_array(const string &name, bool cell_data,
+                                  int ncomponents, const real_t * const *components){
+  int ntuples = cell_data ? nelements : nnodes;
+
+  if(deferred){
+    Snapshot snapshot;
+    snapshot.kind = 'a';
+    snapshot.type = type_code(real_t());
+    snapshot.name = name;
+    snapshot.cell_data = cell_data;
+    snapshot.ncomponents = ncomponents;
+    snapshot.data.resize(sizeof(real_t)*ncomponents*ntuples);
+    for(int j=0; j<ncomponents; j++)
+      memcpy(&snapshot.data[j*sizeof(real_t)*ntuples], components[j], sizeof(real_t)*ntuples);
+    snapshots.push_back(snapshot);
+    return;
+  }
+
+  begin_array(name, vtk_type_name(real_t()), ncomponents, sizeof(real_t)*ncomponents*ntuples,
+              cell_data ? cell_arrays : point_arrays);
+  if(ncomponents==1){
+    const real_t *v = components[0];
+    for(int i=0; i<ntuples; i++)
+      put(v[i]);
+  }else{
+    for(int i=0; i<ntuples; i++)
+      for(int j=0; j<ncomponents; j++)
+        put(components[j][i]);
+  }
+  end_array();
+}
+
+void VTUStreamWriter::write_ghost_levels(const int *ghost_levels){
+  if(deferred){
+    Snapshot snapshot;
+    snapshot.kind = 'g';
+    snapshot.topology.assign(ghost_levels, ghost_levels+nelements);
+    snapshots.push_back(snapshot);
+    return;
+  }
+
+  begin_array("vtkGhostLevels", "UInt8", 1, nelements, cell_arrays);
+  for(int i=0; i<nelements; i++)
+    put((unsigned char)ghost_levels[i]);
+  end_array();
+}
+
+void VTUStreamWriter::set_active(bool cell_data, const char *attribute, const string &name){
+  string *active = cell_data ? active_cell : active_point;
+  if(string(attribute)=="Scalars")
+    active[0] = name;
+  else if(string(attribute)=="Vectors")
+    active[1] = name;
+  else
+    active[2] = name;
+}
+
+void VTUStreamWriter::write_xml(FILE *out) const{
+  ostringstream xml;
+  xml<<"<?xml version=\"1.0\"?>\n"
+     <<"<VTKFile type=\"UnstructuredGrid\" version=\"0.1\" byte_order=\""<<byte_order()<<"\""
+     <<" compressor=\""<<compressors[0]->GetClassName()<<"\">\n"
+     <<"  <UnstructuredGrid>\n"
+     <<"    <Piece NumberOfPoints=\""<<nnodes<<"\" NumberOfCells=\""<<nelements<<"\">\n";
+
+  const char *attributes[] = {"Scalars", "Vectors", "Tensors"};
+  for(int c=0; c<2; c++){
+    const vector<ArrayInfo> &arrays = c ? cell_arrays : point_arrays;
+    const string *active = c ? active_cell : active_point;
+    xml<<"      <"<<(c ? "CellData" : "PointData");
+    for(int a=0; a<3; a++)
+      if(!active[a].empty())
+        xml<<" "<<attributes[a]<<"=\""<<active[a]<<"\"";
+    xml<<">\n";
+    for(size_t i=0; i<arrays.size(); i++)
+      xml<<"        <DataArray type=\""<<arrays[i].type<<"\" Name=\""<<arrays[i].name<<"\""
+         <<" NumberOfComponents=\""<<arrays[i].ncomponents<<"\" format=\"appended\""
+         <<" offset=\""<<arrays[i].offset<<"\"/>\n";
+    xml<<"      </"<<(c ? "CellData" : "PointData")<<">\n";
+  }
+
+  for(size_t i=0; i<mesh_arrays.size(); i++){
+    const ArrayInfo &a = mesh_arrays[i];
+    if(a.name=="Points")
+      xml<<"      <Points>\n";
+    else if(a.name=="connectivity")
+      xml<<"      <Cells>\n";
+    xml<<"        <DataArray type=\""<<a.type<<"\" Name=\""<<a.name<<"\""
+       <<" NumberOfComponents=\""<<a.ncomponents<<"\" format=\"appended\""
+       <<" offset=\""<<a.offset<<"\"/>\n";
+    if(a.name=="Points")
+      xml<<"      </Points>\n";
+    else if(a.name=="types")
+      xml<<"      </Cells>\n";
+  }
+
+  xml<<"    </Piece>\n"
+     <<"  </UnstructuredGrid>\n"
+     <<"  <AppendedData encoding=\"raw\">\n   _";
+
+  string s = xml.str();
+  fwrite(s.data(), 1, s.size(), out);
+}
+
+void VTUStreamWriter::write_pvtu(const string &pvtu_name, const string &piece_prefix, int npartitions) const{
+  ofstream pvtu(pvtu_name.c_str());
+  if(!pvtu.good()){
+    cerr<<"ERROR: Failed to open "<<pvtu_name<<" for writing"<<endl;
+    return;
+  }
+
+  pvtu<<"<?xml version=\"1.0\"?>\n"
+      <<"<VTKFile type=\"PUnstructuredGrid\" version=\"0.1\" byte_order=\""<<byte_order()<<"\">\n"
+      <<"  <PUnstructuredGrid GhostLevel=\"1\">\n";
+
+  const char *attributes[] = {"Scalars", "Vectors", "Tensors"};
+  for(int c=0; c<2; c++){
+    const vector<ArrayInfo> &arrays = c ? cell_arrays : point_arrays;
+    const string *active = c ? active_cell : active_point;
+    pvtu<<"    <"<<(c ? "PCellData" : "PPointData");
+    for(int a=0; a<3; a++)
+      if(!active[a].empty())
+        pvtu<<" "<<attributes[a]<<"=\""<<active[a]<<"\"";
+    pvtu<<">\n";
+    for(size_t i=0; i<arrays.size(); i++)
+      pvtu<<"      <PDataArray type=\""<<arrays[i].type<<"\" Name=\""<<arrays[i].name<<"\""
+          <<" NumberOfComponents=\""<<arrays[i].ncomponents<<"\"/>\n";
+    pvtu<<"    </"<<(c ? "PCellData" : "PPointData")<<">\n";
+  }
+
+  pvtu<<"    <PPoints>\n"
+      <<"      <PDataArray type=\""<<points_type<<"\" Name=\"Points\" NumberOfComponents=\"3\"/>\n"
+      <<"    </PPoints>\n";
+  for(int p=0; p<npartitions; p++)
+    pvtu<<"    <Piece Source=\""<<piece_prefix<<p<<".vtu\"/>\n";
+  pvtu<<"  </PUnstructuredGrid>\n"
+      <<"</VTKFile>\n";
+}
+
+void VTUStreamWriter::finalise(const string &name){
+  if(spill==NULL)
+    return;
+
+  FILE *out = fopen(name.c_str(), "wb");
+  if(out==NULL){
+    cerr<<"ERROR: Failed to open "<<name<<" for writing"<<endl;
+    return;
+  }
+
+  write_xml(out);
+
+  // Copy the appended data behind the header one chunk at a time.
+  vector<char> chunk(1<<20);
+  fflush(spill);
+  fseeko(spill, 0, SEEK_SET);
+  size_t nread;
+  while((nread=fread(&chunk[0], 1, chunk.size(), spill))>0)
+    fwrite(&chunk[0], 1, nread, out);
+
+  const char trailer[] = "\n  </AppendedData>\n</VTKFile>\n";
+  fwrite(trailer, 1, sizeof(trailer)-1, out);
+  fclose(out);
+
+  fclose(spill);
+  spill = NULL;
+  remove(spill_name.c_str());
+}
+
+template<typename real_t>
+void VTUStreamWriter::replay(const Snapshot &snapshot){
+  const real_t *data = (const real_t *)&snapshot.data[0];
+  if(snapshot.kind=='m'){
+    const int *types = &snapshot.topology[0];
+    write_mesh(nnodes, nelements, data, data+nnodes, data+2*nnodes,
+               types+2*nelements, types, types+nelements);
+  }else{
+    int ntuples = snapshot.cell_data ? nelements : nnodes;
+    vector<const real_t *> components(snapshot.ncomponents);
+    for(int j=0; j<snapshot.ncomponents; j++)
+      components[j] = data+j*ntuples;
+    write_array(snapshot.name, snapshot.cell_data, snapshot.ncomponents, &components[0]);
+  }
+}
+
+void VTUStreamWriter::complete(){
+  assert(deferred);
+  deferred = false;
+
+  for(size_t i=0; i<snapshots.size(); i++){
+    const Snapshot &snapshot = snapshots[i];
+    if(snapshot.kind=='g')
+      write_ghost_levels(&snapshot.topology[0]);
+    else if(snapshot.type=='i')
+      replay<int>(snapshot);
+    else if(snapshot.type=='f')
+      replay<float>(snapshot);
+    else
+      replay<double>(snapshot);
+  }
+  vector<Snapshot>().swap(snapshots);
+
+  if(close_rank<0)
+    close();
+  else
+    pclose(close_rank, close_npartitions);
+}
+
+void VTUStreamWriter::close(){
+  if(deferred){
+    close_rank = -1;
+    return;
+  }
+  finalise(filename);
+}
+
+void VTUStreamWriter::pclose(int rank, int npartitions){
+  if(deferred){
+    close_rank = rank;
+    close_npartitions = npartitions;
+    return;
+  }
+
+  // Mirror the layout produced by vtkXMLPUnstructuredGridWriter followed
+  // by pvtu_fix_path: name.pvtu with its pieces in name/name_<rank>.vtu.
+  string stem = filename;
+  bool is_pvtu = filename.size()>5 && filename.substr(filename.size()-5)==".pvtu";
+  if(is_pvtu)
+    stem = filename.substr(0, filename.size()-5);
+  else if(filename.size()>4 && filename.substr(filename.size()-4)==".vtu")
+    stem = filename.substr(0, filename.size()-4);
+
+  string directory = stem+"/";
+  mkdir(directory.c_str(), 0777);
+
+  string piece_prefix = basename_of(stem)+"/"+basename_of(stem)+"_";
+
+  ostringstream piece;
+  piece<<directory<<basename_of(stem)<<"_"<<rank<<".vtu";
+  finalise(piece.str());
+
+  if(rank==0)
+    write_pvtu(is_pvtu ? filename : stem+".pvtu", piece_prefix, npartitions);
+}
+
+template void VTUStreamWriter::write_mesh<float>(int, int, const float *, const float *, const float *,
+                                                 const int *, const int *, const int *);
+template void VTUStreamWriter::write_mesh<double>(int, int, const double *, const double *, const double *,
+                                                  const int *, const int *, const int *);
+template void VTUStreamWriter::write_array<int>(const string &, bool, int, const int * const *);
+template void VTUStreamWriter::write_array<float>(const string &, bool, int, const float * const *);
+template void VTUStreamWriter::write_array<double>(const string &, bool, int, const double * const *);
+
+#endif
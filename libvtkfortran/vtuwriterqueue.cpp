@@ -0,0 +1,156 @@
+/* Copyright (C) 2006- Imperial College London and others.
+
+   Please see the AUTHORS file in the main source directory for a full
+   list of copyright holders.
+
+   Applied Modelling and Computation Group
+   Department of Earth Science and Engineering
+   Imperial College London
+
+   amcgsoftware@imperial.ac.uk
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+   USA
+*/
+
+#include "confdefs.h"
+
+#ifdef HAVE_VTK
+
+#include "vtuwriterqueue.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <sys/time.h>
+
+using namespace std;
+
+VTUWriterQueue::VTUWriterQueue() :
+  depth(0), running(false), shutdown(false), busy(0), wait_time(0.0), write_time(0.0){
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&not_empty, NULL);
+  pthread_cond_init(&not_full, NULL);
+}
+
+VTUWriterQueue::~VTUWriterQueue(){
+  if(running){
+    flush();
+    pthread_mutex_lock(&mutex);
+    shutdown = true;
+    pthread_cond_broadcast(&not_empty);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, NULL);
+  }
+  pthread_cond_destroy(&not_full);
+  pthread_cond_destroy(&not_empty);
+  pthread_mutex_destroy(&mutex);
+}
+
+void VTUWriterQueue::set_depth(int _depth){
+  pthread_mutex_lock(&mutex);
+  depth = max(_depth, 0);
+  pthread_cond_broadcast(&not_full);
+  pthread_mutex_unlock(&mutex);
+}
+
+int VTUWriterQueue::get_depth() const{
+  return depth;
+}
+
+void VTUWriterQueue::push(VTUStreamWriter *writer){
+  // With no room at all the writer would wait forever.
+  if(depth<1){
+    writer->complete();
+    delete writer;
+    return;
+  }
+
+  if(!running){
+    if(pthread_create(&thread, NULL, run, this)!=0){
+      cerr<<"ERROR: Failed to start the vtu writer thread, writing synchronously"<<endl;
+      writer->complete();
+      delete writer;
+      return;
+    }
+    running = true;
+  }
+
+  double start = wall_time();
+  pthread_mutex_lock(&mutex);
+  // Dumps queued or being written may not exceed the depth.
+  while((int)writers.size()+busy>=depth)
+    pthread_cond_wait(&not_full, &mutex);
+  writers.push_back(writer);
+  wait_time += wall_time()-start;
+  pthread_cond_signal(&not_empty);
+  pthread_mutex_unlock(&mutex);
+}
+
+void VTUWriterQueue::flush(){
+  double start = wall_time();
+  pthread_mutex_lock(&mutex);
+  while(!writers.empty() || busy)
+    pthread_cond_wait(&not_full, &mutex);
+  wait_time += wall_time()-start;
+  pthread_mutex_unlock(&mutex);
+}
+
+void VTUWriterQueue::get_times(double &_wait_time, double &_write_time){
+  pthread_mutex_lock(&mutex);
+  _wait_time = wait_time;
+  _write_time = write_time;
+  wait_time = 0.0;
+  write_time = 0.0;
+  pthread_mutex_unlock(&mutex);
+}
+
+void *VTUWriterQueue::run(void *_queue){
+  VTUWriterQueue *queue = (VTUWriterQueue *)_queue;
+
+  pthread_mutex_lock(&queue->mutex);
+  for(;;){
+    while(queue->writers.empty() && !queue->shutdown)
+      pthread_cond_wait(&queue->not_empty, &queue->mutex);
+    if(queue->writers.empty())
+      break;
+
+    VTUStreamWriter *writer = queue->writers.front();
+    queue->writers.pop_front();
+    queue->busy = 1;
+    pthread_mutex_unlock(&queue->mutex);
+
+    double start = wall_time();
+    writer->complete();
+    delete writer;
+    double elapsed = wall_time()-start;
+
+    pthread_mutex_lock(&queue->mutex);
+    queue->busy = 0;
+    queue->write_time += elapsed;
+    pthread_cond_broadcast(&queue->not_full);
+  }
+  pthread_mutex_unlock(&queue->mutex);
+
+  return NULL;
+}
+
+double VTUWriterQueue::wall_time(){
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec+1.0e-6*tv.tv_usec;
+}
+
+#endif
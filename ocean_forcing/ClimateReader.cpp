@@ -40,6 +40,7 @@ ClimateReader::ClimateReader(){
   space = 0.25;
   
   ncid = -1;
+  current_varid = -1;
   
   VerboseOff();
   have_ref_date = false;
@@ -209,34 +210,22 @@ double ClimateReader::GetValue(string name, int ilong, int ilat, int ilevel){
     }
   }
   
-  int varid = ncvarid(ncid, varname.c_str());
-  
-  // Attributes to read
-  nc_get_att_double(ncid, varid, "scale_factor",  &scale_factor);
-  nc_get_att_double(ncid, varid, "add_offset",    &add_offset);
-  nc_get_att_short(ncid,  varid, "_FillValue",    &fill_value);
-  nc_get_att_short(ncid,  varid, "missing_value", &missing_value);
-  
-  long mindex[4];
-  mindex[0] = t0;
-  mindex[1] = ilevel;
-  mindex[2] = ilat;
-  mindex[3] = ilong;
-  if(verbose)
-    cout<<"Reading "<<varname<<" 0: "<<mindex[0]<<", "<<mindex[1]<<", "<<mindex[2]<<", "<<mindex[3]<<": "<<scale_factor<<", "<<add_offset<<endl;
-  
-  short value;
-  int err = ncvarget1(ncid, varid, mindex, &value);
-  assert(err<=0);
-  double rval0 = Uncompress(value);
+  if(varname!=current_varname){
+    current_varid = ncvarid(ncid, varname.c_str());
+    current_varname = varname;
+    
+    // Attributes to read
+    nc_get_att_double(ncid, current_varid, "scale_factor",  &scale_factor);
+    nc_get_att_double(ncid, current_varid, "add_offset",    &add_offset);
+    nc_get_att_short(ncid,  current_varid, "_FillValue",    &fill_value);
+    nc_get_att_short(ncid,  current_varid, "missing_value", &missing_value);
+  }
   
-  mindex[0] = t1;
   if(verbose)
-    cout<<"Reading "<<varname<<" 1: "<<mindex[0]<<", "<<mindex[1]<<", "<<mindex[2]<<", "<<mindex[3]<<": "<<scale_factor<<", "<<add_offset<<endl;
+    cout<<"Reading "<<varname<<": "<<t0<<", "<<t1<<", "<<ilevel<<", "<<ilat<<", "<<ilong<<": "<<scale_factor<<", "<<add_offset<<endl;
   
-  err = ncvarget1(ncid, varid, mindex, &value);
-  assert(err<=0);
-  double rval1 = Uncompress(value);
+  double rval0 = Uncompress(GetSlab(t0, ilevel)[ilat*idim0+ilong]);
+  double rval1 = Uncompress(GetSlab(t1, ilevel)[ilat*idim0+ilong]);
   
   return SolveLine(rval0, rval1, s0, s1, s);
 #else
@@ -248,12 +237,38 @@ double ClimateReader::GetValue(string name, int ilong, int ilat, int ilevel){
 #endif
 }
 
+#ifdef HAVE_LIBNETCDF
+const SharedArray<short> &ClimateReader::GetSlab(int t, int level){
+  ostringstream key;
+  key<<current_varname<<":"<<t<<":"<<level;
+  
+  SharedArray<short> &slab = slabs[key.str()];
+  if(slab.empty()){
+    // Another process on this node may already have read this level
+    if(!slab.Attach(SharedSegment::FileKey(filename)+":"+key.str(), idim0*jdim0)){
+      if(verbose)
+        cout<<"Reading "<<key.str()<<endl;
+      
+      long start[]={t, level, 0, 0}, count[]={1, 1, jdim0, idim0};
+      int err = ncvarget(ncid, current_varid, start, count, slab.Values());
+      assert(err<=0);
+      slab.Publish();
+    }
+  }
+  
+  return slab;
+}
+#endif
+
 int ClimateReader::SetClimatology(string filename){
 #ifdef HAVE_LIBNETCDF
   if(verbose)
     cout<<"int set_climatology("<<filename<<")\n";
 
   ncid = ncopen(filename.c_str(), NC_NOWRITE);    
+  this->filename = filename;
+  current_varname.clear();
+  slabs.clear();
   return ncid;
 #else
   cerr<<"ERROR: no NetCDF support compiled\n";
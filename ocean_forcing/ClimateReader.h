@@ -30,12 +30,14 @@
 #include "confdefs.h"
 
 #include "Calendar.h"
+#include "SharedArray.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <deque>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -65,6 +67,7 @@ class ClimateReader{
   int Cartesian2Grid(double x, double y, double z, int &ilong, int &ilat, int &ilevel);
   int Cartesian2Spherical(double x, double y, double z, double &longitude, double &latitude, double &depth);
   double GetValue(std::string name, int ilong, int ilat, int ilevel);
+  const SharedArray<short> &GetSlab(int t, int level);
   double SolveLine(double x0, double x1, double t0, double t1, double t) const;
   int Spherical2Grid(double longitude, double latitude, double depth, int &ilong, int &ilat, int &ilevel);
   double Uncompress(short svar);
@@ -74,6 +77,12 @@ class ClimateReader{
   double space;
   std::vector<float> levels, months, seasons;
   int ncid;
+  std::string filename;
+
+  // Levels of the current variable, decoded once per node
+  std::string current_varname;
+  int current_varid;
+  std::map<std::string, SharedArray<short> > slabs;
   
   double scale_factor, add_offset;
   short fill_value, missing_value;
@@ -27,6 +27,7 @@
 */
 #include "FluxesReader.h"
 #include <limits>
+#include <sstream>
 #include <string.h>
 
 #ifdef __SUN
@@ -169,8 +170,8 @@ double FluxesReader::GetScalar(string scalar, double xlong, double ylat){
   size_t time_level=0;
   size_t nvalues=0, stride=longitude.size();
 
-  for(map<int, map<string, vector<double> > >::const_iterator itime=fields.begin(); itime!=fields.end(); itime++){
-    const vector<double> &fld=itime->second.find(scalar)->second;
+  for(map<int, map<string, SharedArray<double> > >::const_iterator itime=fields.begin(); itime!=fields.end(); itime++){
+    const SharedArray<double> &fld=itime->second.find(scalar)->second;
     
     if(i0==i1){ // No interpolation along longitude
       if(verbose)
@@ -303,9 +304,9 @@ int FluxesReader::GetScalars(double xlong, double ylat, double *scalars){
   // variables calculated in ERA-40
   size_t nvalues=0, stride=longitude.size();
   
-  for(map<int, map<string, vector<double> > >::const_iterator itime=fields.begin(); itime!=fields.end(); itime++){
+  for(map<int, map<string, SharedArray<double> > >::const_iterator itime=fields.begin(); itime!=fields.end(); itime++){
     for(deque<string>::const_iterator ifield=fields_of_interest.begin(); ifield!=fields_of_interest.end(); ifield++){
-      const vector<double> &fld=itime->second.find(*ifield)->second;
+      const SharedArray<double> &fld=itime->second.find(*ifield)->second;
       
       if(i0==i1){ // No interpolation along longitude
         if(verbose)
@@ -411,7 +412,7 @@ int FluxesReader::Read(int time_index){
     // Check if we already have a copy of this field
     if(fields.find(time_index)!=fields.end())
       if(fields[time_index].find(*ifield)!=fields[time_index].end())
-        if(fields[time_index][*ifield].empty())
+        if(!fields[time_index][*ifield].empty())
           continue;
     
     long id = ncvarid(ncid, ifield->c_str());
@@ -425,6 +426,14 @@ int FluxesReader::Read(int time_index){
     
     long start[]={time_index, 0, 0}, count[]={1, spec["latitude"], spec["longitude"]};
     size_t len = spec["latitude"]*spec["longitude"];
+    
+    // Another process on this node may already have decoded this slice
+    ostringstream key;
+    key<<SharedSegment::FileKey(ERA_data_files[0])<<":"<<*ifield<<":"<<time_index;
+    SharedArray<double> &values = fields[time_index][*ifield];
+    if(values.Attach(key.str(), len))
+      continue;
+    
     vector<short> field(len);
     ncvarget(ncid, id, start, count, &(field[0]));
     
@@ -451,7 +460,7 @@ int FluxesReader::Read(int time_index){
           <<*ifield<<"  _missing_value   = "<<missing_value<<endl;
     }
     
-    fields[time_index][*ifield].resize(len);
+    double *data = values.Values();
     for(size_t i=0; i<len; i++){
       if((field[i]==fill_value)||
          (field[i]==missing_value)){
@@ -459,9 +468,10 @@ int FluxesReader::Read(int time_index){
             cerr<<"Time: "<<time_index<<". NCID: "<<ncid<<endl;
             exit(-1);
       }else{
-        fields[time_index][*ifield][i] = scale_factor*field[i] + add_offset;
+        data[i] = scale_factor*field[i] + add_offset;
       }
     }
+    values.Publish();
   }
 #else
   cerr<<"ERROR: No fluxes support compiled\n";
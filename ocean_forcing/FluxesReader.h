@@ -55,6 +55,7 @@ extern "C" {
 #include <stdlib.h>
 
 #include "Calendar.h"
+#include "SharedArray.h"
 
 class FluxesReader{
  public:
@@ -110,7 +111,7 @@ class FluxesReader{
   std::deque<std::string> fields_of_interest;
 
   //    time index    |  name of field  | field values
-  std::map<int, std::map<std::string, std::vector<double> > > fields;
+  std::map<int, std::map<std::string, SharedArray<double> > > fields;
 };
 
 extern FluxesReader FluxesReader_global;
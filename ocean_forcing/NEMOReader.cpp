@@ -27,6 +27,7 @@
 */
 #include "NEMOReader.h"
 #include <limits>
+#include <sstream>
 #include <string.h>
 
 #ifdef __SUN
@@ -174,9 +175,9 @@ int NEMOReader::GetScalars(double xlong, double ylat, double p_depth, double *sc
                        // variables calculated in NEMO
   size_t nvalues=0, stride=longitude.size(), vstride=longitude.size()*latitude.size();
   
-  for(map<int, map<string, vector<double> > >::const_iterator itime=fields.begin(); itime!=fields.end(); itime++){
+  for(map<int, map<string, SharedArray<double> > >::const_iterator itime=fields.begin(); itime!=fields.end(); itime++){
     for(deque<string>::const_iterator ifield=fields_of_interest.begin(); ifield!=fields_of_interest.end(); ifield++){
-      const vector<double> &fld=itime->second.find(*ifield)->second;
+      const SharedArray<double> &fld=itime->second.find(*ifield)->second;
       
       string dtest="ssh";
       if(ifield->c_str()==dtest){ // Use ssh to set prssure
@@ -429,7 +430,7 @@ int NEMOReader::Read(int time_index){
     // Check if we already have a copy of this field
     if(fields.find(time_index)!=fields.end())
       if(fields[time_index].find(*ifield)!=fields[time_index].end())
-        if(fields[time_index][*ifield].empty())
+        if(!fields[time_index][*ifield].empty())
           continue;
     
     long id = ncvarid(ncid, ifield->c_str());
@@ -441,18 +442,25 @@ int NEMOReader::Read(int time_index){
     ncvarinq(ncid, id, 0, &xtypep, &ndims, dims, &natts);
 //    assert(xtypep==NC_SHORT);
 
-    size_t len;
-    vector<float> field;
-   
     string dtest="ssh";
-    if (ifield->c_str()==dtest){
+    size_t len;
+    if (ifield->c_str()==dtest)
       len = vdimension[1]*vdimension[0];
-      field.resize(len);
+    else
+      len = ndepth*vdimension[1]*vdimension[0];
+    
+    // Another process on this node may already have decoded this slice
+    ostringstream key;
+    key<<SharedSegment::FileKey(NEMO_data_files[0])<<":"<<*ifield<<":"<<time_index;
+    SharedArray<double> &values = fields[time_index][*ifield];
+    if(values.Attach(key.str(), len))
+      continue;
+    
+    vector<float> field(len);
+    if (ifield->c_str()==dtest){
       long start[]={time_index, 0, 0}, count[]={1,vdimension[1],vdimension[0]};
       ncvarget(ncid, id, start, count, &(field[0]));
     }else{
-      len = ndepth*vdimension[1]*vdimension[0];
-      field.resize(len);
       long start[]={time_index, 0, 0, 0}, count[]={1,ndepth,vdimension[1],vdimension[0]};
       ncvarget(ncid, id, start, count, &(field[0]));
     }
@@ -466,11 +474,11 @@ int NEMOReader::Read(int time_index){
 //       myfile << i << '\t' << field[i] << endl;
 //     }
 
-    fields[time_index][*ifield].resize(len);
+    double *data = values.Values();
     for(size_t i=0; i<len; i++){
-      fields[time_index][*ifield][i] = field[i];
+      data[i] = field[i];
     }
-
+    values.Publish();
   }
 #else
   cerr<<"ERROR: No NetCDF support compiled\n";
@@ -64,6 +64,7 @@ typedef float vtkFloatingPointType;
 #include <stdlib.h>
 
 #include "Calendar.h"
+#include "SharedArray.h"
 
 #include <fstream>    // |
                       // |--> These two lines need to be removed. Here for temporary printing to file purposes.
@@ -129,7 +130,7 @@ class NEMOReader{
   std::deque<std::string> fields_of_interest;
 
   //    time index    |  name of field  | field values
-  std::map<int, std::map<std::string, std::vector<double> > > fields;
+  std::map<int, std::map<std::string, SharedArray<double> > > fields;
 
 };
 
@@ -21,11 +21,17 @@
  *    Contact info: gerard.j.gorman@gmail.com/g.gorman@imperial.ac.uk
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iostream>
 #include <map>
 #include <vector>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include <vtk.h>
 
 #include "SampleNetCDF.h"
@@ -34,6 +40,7 @@ using namespace std;
 
 SampleNetCDF::SampleNetCDF(){
   VerboseOff();
+  wrap = 0;
 }
 
 SampleNetCDF::~SampleNetCDF(){}
@@ -41,6 +48,7 @@ SampleNetCDF::~SampleNetCDF(){}
 
 SampleNetCDF::SampleNetCDF(string filename){
   VerboseOff();
+  wrap = 0;
   SetFile(filename);
   return;
 }
@@ -66,6 +74,9 @@ const SampleNetCDF& SampleNetCDF::operator=(const SampleNetCDF &in){
 
   data = in.data;
   verbose = in.verbose;
+
+  cache = in.cache;
+  wrap = in.wrap;
   
   reader = in.reader;
   
@@ -156,7 +167,7 @@ double SampleNetCDF::GetValue(double longitude, double latitude) const{
   }else if(j0==j1){ // No interpolation along latitude
     if(verbose)
       cout<<"Case 2\n";
-    return z11 - (x1-longitude)*(z11-z10)/(x1-x0);
+    return z00 + (longitude-x0)*(z10-z00)/(x1-x0);
   }
   //else{ // Bi-linear interpolation
   if(verbose)
@@ -172,6 +183,94 @@ double SampleNetCDF::GetValue(double longitude, double latitude) const{
   return val; 
 }
 
+void SampleNetCDF::GetValues(int n, const double *longitude, const double *latitude, double *values) const{
+  if(verbose)
+    cout<<"void SampleNetCDF::GetValues("<<n<<", const double *, const double *, double *) const\n";
+
+  if(n<=0)
+    return;
+  if(cache.empty()){
+    cerr<<"ERROR: SampleNetCDF::GetValues called before SetVariable\n";
+    exit(-1);
+  }
+
+  // Cell of each point and its position in the cell. Wrapping
+  // subtracts whole periods, which is a no-op for non-global grids
+  // where period is 0.
+  const int stride = dimension[0]+1;
+  const double period = wrap, inv_period = wrap?1.0/wrap:0.0;
+  const double xmax = wrap?wrap:dimension[0]-1, ymax = dimension[1]-1;
+  const double *base = &(cache[0]);
+
+  int i=0;
+#ifdef __AVX2__
+  const __m256d vx0 = _mm256_set1_pd(x_range[0]), vy0 = _mm256_set1_pd(y_range[0]);
+  const __m256d vdx = _mm256_set1_pd(spacing[0]), vdy = _mm256_set1_pd(spacing[1]);
+  const __m256d vperiod = _mm256_set1_pd(period), vinv_period = _mm256_set1_pd(inv_period);
+  const __m256d vxmax = _mm256_set1_pd(xmax), vymax = _mm256_set1_pd(ymax), zero = _mm256_setzero_pd();
+  const __m128i vimax = _mm_set1_epi32(dimension[0]-1), vjmax = _mm_set1_epi32(dimension[1]-1);
+  const __m128i vstride = _mm_set1_epi32(stride);
+  for(;i+4<=n;i+=4){
+    __m256d fx = _mm256_div_pd(_mm256_sub_pd(_mm256_loadu_pd(longitude+i), vx0), vdx);
+    fx = _mm256_sub_pd(fx, _mm256_mul_pd(vperiod, _mm256_floor_pd(_mm256_mul_pd(fx, vinv_period))));
+    fx = _mm256_min_pd(_mm256_max_pd(fx, zero), vxmax);
+    __m256d fy = _mm256_div_pd(_mm256_sub_pd(_mm256_loadu_pd(latitude+i), vy0), vdy);
+    fy = _mm256_min_pd(_mm256_max_pd(fy, zero), vymax);
+
+    __m128i i0 = _mm_min_epi32(_mm256_cvttpd_epi32(fx), vimax);
+    __m128i j0 = _mm_min_epi32(_mm256_cvttpd_epi32(fy), vjmax);
+    __m256d wx = _mm256_sub_pd(fx, _mm256_cvtepi32_pd(i0));
+    __m256d wy = _mm256_sub_pd(fy, _mm256_cvtepi32_pd(j0));
+
+    __m128i index = _mm_add_epi32(_mm_mullo_epi32(j0, vstride), i0);
+    __m256d z00 = _mm256_i32gather_pd(base, index, 8);
+    __m256d z10 = _mm256_i32gather_pd(base+1, index, 8);
+    __m256d z01 = _mm256_i32gather_pd(base+stride, index, 8);
+    __m256d z11 = _mm256_i32gather_pd(base+stride+1, index, 8);
+
+    __m256d z0 = _mm256_add_pd(z00, _mm256_mul_pd(wx, _mm256_sub_pd(z10, z00)));
+    __m256d z1 = _mm256_add_pd(z01, _mm256_mul_pd(wx, _mm256_sub_pd(z11, z01)));
+    _mm256_storeu_pd(values+i, _mm256_add_pd(z0, _mm256_mul_pd(wy, _mm256_sub_pd(z1, z0))));
+  }
+#endif
+  for(;i<n;i++){
+    double fx = (longitude[i] - x_range[0])/spacing[0];
+    fx -= period*floor(fx*inv_period);
+    fx = std::min(std::max(fx, 0.0), xmax);
+    double fy = std::min(std::max((latitude[i] - y_range[0])/spacing[1], 0.0), ymax);
+
+    int i0 = std::min((int)fx, dimension[0]-1);
+    int j0 = std::min((int)fy, dimension[1]-1);
+    double wx = fx - i0;
+    double wy = fy - j0;
+
+    const double *z = base + j0*stride + i0;
+    double z0 = z[0] + wx*(z[1] - z[0]);
+    double z1 = z[stride] + wx*(z[stride+1] - z[stride]);
+    values[i] = z0 + wy*(z1 - z0);
+  }
+}
+
+void SampleNetCDF::SetCache(){
+  // The grid is global if its columns, or all but a repeated last
+  // column, span 360 degrees.
+  int columns = (int)floor(360.0/spacing[0] + 0.5);
+  if(fabs(columns*spacing[0] - 360.0)<1.0e-6*360.0 &&
+     (columns==dimension[0] || columns==dimension[0]-1))
+    wrap = columns;
+  else
+    wrap = 0;
+
+  const int stride = dimension[0]+1;
+  cache.resize(stride*(dimension[1]+1));
+  for(int j=0;j<=dimension[1];j++){
+    int jj = std::min(j, dimension[1]-1);
+    for(int i=0;i<dimension[0];i++)
+      cache[j*stride+i] = data[jj*dimension[0]+i];
+    cache[j*stride+dimension[0]] = data[jj*dimension[0]+(wrap==dimension[0]?0:dimension[0]-1)];
+  }
+}
+
 void SampleNetCDF::SetFile(string filename){
   if(verbose)
     cout<<"void SampleNetCDF::SetFile("<<filename<<")\n";
@@ -190,6 +289,7 @@ void SampleNetCDF::SetVariable(string varname){
     cout<<"void SampleNetCDF::SetVariable("<<varname<<")\n";
 
   reader.Read(varname, data);
+  SetCache();
 }
 
 void SampleNetCDF::VerboseOff(){
@@ -237,6 +337,16 @@ extern "C" {
     *val = netcdf_sampler[*id].GetValue(*longitude, *latitude);
   }
   
+#define samplenetcdf_getvalues_fc F77_FUNC_(samplenetcdf_getvalues_c, SAMPLENETCDF_GETVALUES_C)
+  void samplenetcdf_getvalues_fc(const int *id, const int *n, const double *longitude, const double *latitude, double *values){
+    if(netcdf_sampler.find(*id)==netcdf_sampler.end()){
+      cerr<<"ERROR: netcdf file has not been opened\n";
+      exit(-1);
+    }
+    
+    netcdf_sampler[*id].GetValues(*n, longitude, latitude, values);
+  }
+  
 #define samplenetcdf_close_fc F77_FUNC_(samplenetcdf_close_c, SAMPLENETCDF_CLOSE_C)
   void samplenetcdf_close_fc(const int *id){
     map<int, SampleNetCDF>::iterator it = netcdf_sampler.find(*id);
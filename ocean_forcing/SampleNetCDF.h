@@ -48,6 +48,10 @@ class SampleNetCDF{
   void Close();
   double GetValue(double, double) const;
 
+  /// Sample n points at once. Longitudes outside the range of a
+  /// global grid wrap around; other points are clamped to the grid.
+  void GetValues(int n, const double *longitude, const double *latitude, double *values) const;
+
   bool HasPoint(double, double) const;
 
   void SetFile(std::string);
@@ -59,6 +63,7 @@ class SampleNetCDF{
  private:
   void Debug(char *) const;
   double GetValue(int, int) const;
+  void SetCache();
 
   double x_range[2];          // Longitude
   double y_range[2];          // Latitude
@@ -69,6 +74,12 @@ class SampleNetCDF{
   std::vector<double> data;
   bool verbose;
 
+  // The data with an extra column and row, so that every cell has
+  // four corners, and the number of columns spanning 360 degrees if
+  // the grid is global (otherwise 0).
+  std::vector<double> cache;
+  int wrap;
+
   NetCDFReader reader;
 };
 #endif
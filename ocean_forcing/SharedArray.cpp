@@ -0,0 +1,290 @@
+/*  Copyright (C) 2006 Imperial College London and others.
+    
+    Please see the AUTHORS file in the main source directory for a full list
+    of copyright holders.
+
+    Prof. C Pain
+    Applied Modelling and Computation Group
+    Department of Earth Science and Engineering
+    Imperial College London
+
+    amcgsoftware@imperial.ac.uk
+    
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation,
+    version 2.1 of the License.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+    USA
+*/
+
+#include "SharedArray.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace{
+  const char magic[8] = {'F', 'L', 'S', 'H', 'A', 'R', 'E', '1'};
+
+  struct Header{
+    char magic[8];
+    unsigned long long key_length, bytes;
+  };
+
+  // Removes the files made by this process when it exits normally.
+  // Processes that have mapped them keep their mappings. Files left by
+  // processes that are killed or aborted are removed by
+  // remove_stale_files.
+  class CreatedFiles : public vector<string>{
+  public:
+    ~CreatedFiles(){
+      for(const_iterator path=begin(); path!=end(); path++){
+        unlink(path->c_str());
+        unlink((*path+".lock").c_str());
+      }
+    }
+  } created_files;
+
+  string shared_directory(){
+    const char *dir = getenv("FLUIDITY_SHARED_CACHE");
+    string directory(dir?dir:"/dev/shm");
+    if(directory=="none" || access(directory.c_str(), W_OK)!=0)
+      return string();
+    return directory;
+  }
+
+  // Every process using a file holds a shared lock on it until it
+  // unmaps it or dies, so a file that can be locked exclusively is no
+  // longer used and can be removed. This covers blocks being filled,
+  // published blocks and lock files.
+  void remove_stale_files(const string &directory){
+    ostringstream name;
+    name<<"fluidity-"<<getuid()<<"-";
+    const string prefix = name.str();
+
+    vector<string> names;
+    DIR *dir = opendir(directory.c_str());
+    if(dir==NULL)
+      return;
+    for(struct dirent *entry=readdir(dir); entry!=NULL; entry=readdir(dir))
+      if(strncmp(entry->d_name, prefix.c_str(), prefix.size())==0)
+        names.push_back(entry->d_name);
+    closedir(dir);
+
+    for(size_t i=0;i<names.size();i++){
+      string path = directory+"/"+names[i];
+      int fd = open(path.c_str(), O_RDONLY);
+      if(fd<0)
+        continue;
+
+      // Only remove the file that was locked, not one that has
+      // replaced it since.
+      struct stat locked, current;
+      if(flock(fd, LOCK_EX|LOCK_NB)==0 && fstat(fd, &locked)==0 &&
+         stat(path.c_str(), &current)==0 &&
+         locked.st_dev==current.st_dev && locked.st_ino==current.st_ino)
+        unlink(path.c_str());
+      close(fd);
+    }
+  }
+
+  size_t data_offset(const string &key){
+    return (sizeof(Header) + key.size() + 7)/8*8;
+  }
+}
+
+SharedSegment::SharedSegment(){
+  references = 1;
+  base = NULL;
+  length = 0;
+  offset = 0;
+  bytes = 0;
+  data_fd = -1;
+  lock_fd = -1;
+}
+
+SharedSegment::~SharedSegment(){
+  Release();
+}
+
+void SharedSegment::Release(){
+  if(base)
+    munmap(base, length);
+  base = NULL;
+  if(!tmp_path.empty())
+    unlink(tmp_path.c_str());
+  tmp_path.clear();
+  if(data_fd>=0)
+    close(data_fd);
+  data_fd = -1;
+  if(lock_fd>=0)
+    close(lock_fd);
+  lock_fd = -1;
+  private_data.clear();
+}
+
+bool SharedSegment::MapExisting(const string &key, size_t _bytes){
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd<0)
+    return false;
+
+  struct stat stats;
+  if(flock(fd, LOCK_SH)!=0){
+    close(fd);
+    return false;
+  }
+  if(fstat(fd, &stats)!=0 || (size_t)stats.st_size!=data_offset(key)+_bytes){
+    close(fd);
+    return false;
+  }
+
+  void *addr = mmap(NULL, stats.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if(addr==MAP_FAILED){
+    close(fd);
+    return false;
+  }
+
+  const Header *header = (const Header *)addr;
+  if(memcmp(header->magic, magic, sizeof(magic))!=0 ||
+     header->key_length!=key.size() || header->bytes!=_bytes ||
+     memcmp((const char *)addr+sizeof(Header), key.data(), key.size())!=0){
+    munmap(addr, stats.st_size);
+    close(fd);
+    return false;
+  }
+
+  base = addr;
+  length = stats.st_size;
+  data_fd = fd;
+  return true;
+}
+
+bool SharedSegment::Attach(const string &key, size_t _bytes){
+  Release();
+  bytes = _bytes;
+  offset = data_offset(key);
+
+  string directory = shared_directory();
+  if(!directory.empty()){
+    // Name the files by a hash of the key (FNV-1a).
+    unsigned long long hash = 14695981039346656037ULL;
+    for(size_t i=0;i<key.size();i++){
+      hash ^= (unsigned char)key[i];
+      hash *= 1099511628211ULL;
+    }
+    ostringstream name;
+    name<<directory<<"/fluidity-"<<getuid()<<"-"<<hex<<hash;
+    path = name.str();
+
+    static bool removed_stale_files = false;
+    if(!removed_stale_files){
+      remove_stale_files(directory);
+      removed_stale_files = true;
+    }
+
+    if(MapExisting(key, bytes))
+      return true;
+
+    // Wait for any process that is filling the block.
+    lock_fd = open((path+".lock").c_str(), O_RDWR|O_CREAT, 0600);
+    if(lock_fd>=0 && flock(lock_fd, LOCK_EX)==0){
+      if(MapExisting(key, bytes)){
+        close(lock_fd);
+        lock_fd = -1;
+        return true;
+      }
+
+      // Leave a block with another key but the same hash alone.
+      if(access(path.c_str(), F_OK)!=0){
+        ostringstream tmp;
+        tmp<<path<<"."<<getpid();
+        int fd = open(tmp.str().c_str(), O_RDWR|O_CREAT|O_TRUNC, 0600);
+        if(fd>=0){
+          tmp_path = tmp.str();
+          data_fd = fd;
+          void *addr = MAP_FAILED;
+          if(flock(fd, LOCK_SH)==0 && posix_fallocate(fd, 0, offset+bytes)==0)
+            addr = mmap(NULL, offset+bytes, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+
+          if(addr!=MAP_FAILED){
+            base = addr;
+            length = offset+bytes;
+
+            Header *header = (Header *)base;
+            memcpy(header->magic, magic, sizeof(magic));
+            header->key_length = key.size();
+            header->bytes = bytes;
+            memcpy((char *)base+sizeof(Header), key.data(), key.size());
+            return false;
+          }
+        }
+      }
+    }
+
+    // The block cannot be shared.
+    Release();
+  }
+
+  offset = 0;
+  private_data.resize(bytes);
+  return false;
+}
+
+void *SharedSegment::Data() const{
+  if(base)
+    return (char *)base+offset;
+  return private_data.empty()?NULL:(void *)&(private_data[0]);
+}
+
+void SharedSegment::Publish(){
+  if(tmp_path.empty())
+    return;
+
+  if(rename(tmp_path.c_str(), path.c_str())==0)
+    created_files.push_back(path);
+  else
+    unlink(tmp_path.c_str());
+  tmp_path.clear();
+
+  close(lock_fd);
+  lock_fd = -1;
+}
+
+size_t SharedSegment::Size() const{
+  return (base || !private_data.empty())?bytes:0;
+}
+
+string SharedSegment::FileKey(const string &filename){
+  char resolved[PATH_MAX];
+  ostringstream key;
+  if(realpath(filename.c_str(), resolved))
+    key<<resolved;
+  else
+    key<<filename;
+
+  struct stat stats;
+  if(stat(filename.c_str(), &stats)==0)
+    key<<":"<<stats.st_size<<":"<<stats.st_mtime;
+
+  return key.str();
+}
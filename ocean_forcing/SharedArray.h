@@ -0,0 +1,147 @@
+/*  Copyright (C) 2006 Imperial College London and others.
+    
+    Please see the AUTHORS file in the main source directory for a full list
+    of copyright holders.
+
+    Prof. C Pain
+    Applied Modelling and Computation Group
+    Department of Earth Science and Engineering
+    Imperial College London
+
+    amcgsoftware@imperial.ac.uk
+    
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation,
+    version 2.1 of the License.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+    USA
+*/
+
+#ifndef SHAREDARRAY_H
+#define SHAREDARRAY_H
+
+#include "confdefs.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/** A block of memory shared by the processes on a node.
+
+    Blocks are named by a key that identifies their contents (see
+    FileKey). The first process to ask for a key creates a file for it
+    in a node-local directory (the environment variable
+    FLUIDITY_SHARED_CACHE, /dev/shm by default) and fills it while
+    holding a lock on the key. The other processes wait for the lock
+    and then map the finished file read-only, so each block is decoded
+    and held in memory once per node however many processes use it.
+    The files are removed when their creator exits. Each process holds
+    a shared lock on the files it uses, so files left by processes
+    that were killed or aborted are removed by the next process to
+    attach a block in the directory. If no shared directory can be
+    used (or FLUIDITY_SHARED_CACHE is "none") blocks are private to
+    the process.
+*/
+class SharedSegment{
+ public:
+  SharedSegment();
+  ~SharedSegment();
+
+  /// Map the block named by key. Returns true if a complete block was
+  /// found; otherwise returns false, and the block must be filled
+  /// through Data() and then published with Publish().
+  bool Attach(const std::string &key, size_t bytes);
+
+  void *Data() const;
+  void Publish();
+  size_t Size() const;
+
+  /// A key for the contents of a file: its path, size and modification time.
+  static std::string FileKey(const std::string &filename);
+
+  int references;
+
+ private:
+  bool MapExisting(const std::string &key, size_t bytes);
+  void Release();
+
+  void *base;
+  size_t length, offset, bytes;
+  std::vector<char> private_data;
+  int data_fd, lock_fd;
+  std::string path, tmp_path;
+};
+
+/** A read-only array (once filled) held in a SharedSegment. Copies
+    share the segment.
+*/
+template<class T>
+class SharedArray{
+ public:
+  SharedArray() : segment(NULL){}
+
+  SharedArray(const SharedArray &other) : segment(other.segment){
+    if(segment)
+      segment->references++;
+  }
+
+  ~SharedArray(){
+    clear();
+  }
+
+  SharedArray &operator=(const SharedArray &other){
+    if(other.segment)
+      other.segment->references++;
+    clear();
+    segment = other.segment;
+    return *this;
+  }
+
+  /// See SharedSegment::Attach.
+  bool Attach(const std::string &key, size_t n){
+    clear();
+    segment = new SharedSegment();
+    return segment->Attach(key, n*sizeof(T));
+  }
+
+  /// The values, to fill an array that was not found by Attach.
+  T *Values(){
+    return (T *)segment->Data();
+  }
+
+  void Publish(){
+    segment->Publish();
+  }
+
+  void clear(){
+    if(segment && --segment->references==0)
+      delete segment;
+    segment = NULL;
+  }
+
+  bool empty() const{
+    return size()==0;
+  }
+
+  size_t size() const{
+    return segment?segment->Size()/sizeof(T):0;
+  }
+
+  const T &operator[](size_t i) const{
+    return ((const T *)segment->Data())[i];
+  }
+
+ private:
+  SharedSegment *segment;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "confdefs.h"
+#include "fmangle.h"
+#include "../SampleNetCDF.h"
+
+using namespace std;
+
+extern "C" {
+#define test_SampleNetCDF_fc F77_FUNC(test_SampleNetCDF, TEST_SAMPLENETCDF)
+  void test_SampleNetCDF_fc();
+}
+
+extern void report_test(const string& title, const bool& fail, const bool& warn, const string& msg);
+
+#ifdef HAVE_LIBNETCDF
+// A global grid of 8 columns every 45 degrees and 5 rows every 30
+// degrees, with values that are not representable as floats.
+static const int nx=8, ny=5;
+
+static void write_grid(const char *filename){
+  int ncid, dims[2], xvar, yvar, zvar;
+  nc_create(filename, NC_CLOBBER, &ncid);
+  nc_def_dim(ncid, "longitude", nx, &dims[1]);
+  nc_def_dim(ncid, "latitude", ny, &dims[0]);
+  nc_def_var(ncid, "longitude", NC_DOUBLE, 1, &dims[1], &xvar);
+  nc_def_var(ncid, "latitude", NC_DOUBLE, 1, &dims[0], &yvar);
+  nc_def_var(ncid, "z", NC_DOUBLE, 2, dims, &zvar);
+  double x_range[] = {0.0, 315.0}, y_range[] = {-60.0, 60.0};
+  nc_put_att_double(ncid, xvar, "actual_range", NC_DOUBLE, 2, x_range);
+  nc_put_att_double(ncid, yvar, "actual_range", NC_DOUBLE, 2, y_range);
+  nc_enddef(ncid);
+
+  double x[nx], y[ny], z[ny*nx];
+  for(int i=0;i<nx;i++)
+    x[i] = 45.0*i;
+  for(int j=0;j<ny;j++)
+    y[j] = -60.0 + 30.0*j;
+  for(int j=0;j<ny;j++)
+    for(int i=0;i<nx;i++)
+      z[j*nx+i] = 1000.0/3.0 + cos(0.7*i)*(1.0 + 0.3*j) + 0.1*j*j;
+  nc_put_var_double(ncid, xvar, x);
+  nc_put_var_double(ncid, yvar, y);
+  nc_put_var_double(ncid, zvar, z);
+  nc_close(ncid);
+}
+
+// GetValue clamps to the grid, so sample the wrapped longitude and
+// interpolate across the seam between the last and first columns.
+static double wrapped_value(const SampleNetCDF &sampler, double longitude, double latitude){
+  longitude = fmod(longitude, 360.0);
+  if(longitude<0.0)
+    longitude += 360.0;
+  if(longitude<=315.0)
+    return sampler.GetValue(longitude, latitude);
+  double w = (longitude - 315.0)/45.0;
+  return (1.0 - w)*sampler.GetValue(315.0, latitude) + w*sampler.GetValue(0.0, latitude);
+}
+#endif
+
+void test_SampleNetCDF_fc(){
+#ifdef HAVE_LIBNETCDF
+  const char filename[] = "test_SampleNetCDF.nc";
+  write_grid(filename);
+
+  SampleNetCDF sampler(filename);
+  sampler.SetVariable("z");
+  char errorMessage[256];
+
+  // Points inside the grid, a count that is not a multiple of 4 so
+  // the remainder loop is also used.
+  const int n = 1003;
+  vector<double> longitude(n), latitude(n), values(n);
+  for(int i=0;i<n;i++){
+    longitude[i] = 315.0*fmod(0.618034*i, 1.0);
+    latitude[i] = -60.0 + 120.0*fmod(0.414214*i, 1.0);
+  }
+  longitude[0] = 0.0;   latitude[0] = -60.0;
+  longitude[1] = 315.0; latitude[1] = 60.0;
+  longitude[2] = 100.0; latitude[2] = 30.0;
+  sampler.GetValues(n, &longitude[0], &latitude[0], &values[0]);
+  double error = 0.0;
+  for(int i=0;i<n;i++)
+    error = max(error, fabs(values[i] - sampler.GetValue(longitude[i], latitude[i])));
+  sprintf(errorMessage, "Maximum difference from GetValue %g", error);
+  report_test("[test_SampleNetCDF: GetValues matches GetValue]", error>1.0e-10, false, errorMessage);
+
+  // Longitudes across the seam and outside [0, 360).
+  const int nwrap = 7;
+  double wrap_longitude[nwrap] = {337.5, -22.5, 405.0, 360.0, -315.0, 350.0, 730.0};
+  double wrap_latitude[nwrap] = {0.0, 15.0, -45.0, 60.0, -60.0, 7.5, 30.0};
+  double wrap_values[nwrap];
+  sampler.GetValues(nwrap, wrap_longitude, wrap_latitude, wrap_values);
+  error = 0.0;
+  for(int i=0;i<nwrap;i++)
+    error = max(error, fabs(wrap_values[i] - wrapped_value(sampler, wrap_longitude[i], wrap_latitude[i])));
+  sprintf(errorMessage, "Maximum difference from wrapped GetValue %g", error);
+  report_test("[test_SampleNetCDF: GetValues wraps longitude]", error>1.0e-10, false, errorMessage);
+
+  sampler.Close();
+  remove(filename);
+#else
+  report_test("[dummy]",false,false,"Dummy");
+#endif
+}
@@ -29,6 +29,10 @@
 #include <cmath>
 #include <limits>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include <spatialindex/SpatialIndex.h>
 
 #include "RTree.h"
@@ -88,6 +92,12 @@ void Node::loadFromByteArray(const byte* ptr)
 		memcpy(&(m_pDataLength[u32Child]), ptr, sizeof(uint32_t));
 		ptr += sizeof(uint32_t);
 
+		for (uint32_t cDim = 0; cDim < m_pTree->m_dimension; ++cDim)
+		{
+			m_pPackedLow[cDim * m_packedStride + u32Child] = m_ptrMBR[u32Child]->m_pLow[cDim];
+			m_pPackedHigh[cDim * m_packedStride + u32Child] = m_ptrMBR[u32Child]->m_pHigh[cDim];
+		}
+
 		if (m_pDataLength[u32Child] > 0)
 		{
 			m_totalDataLength += m_pDataLength[u32Child];
@@ -236,6 +246,9 @@ Node::Node() :
 	m_pData(0),
 	m_ptrMBR(0),
 	m_pIdentifier(0),
+	m_packedStride(0),
+	m_pPackedLow(0),
+	m_pPackedHigh(0),
 	m_pDataLength(0),
 	m_totalDataLength(0)
 {
@@ -250,6 +263,9 @@ Node::Node(SpatialIndex::RTree::RTree* pTree, id_type id, uint32_t level, uint32
 	m_pData(0),
 	m_ptrMBR(0),
 	m_pIdentifier(0),
+	m_packedStride(((capacity + 1) + 3) & ~3u),
+	m_pPackedLow(0),
+	m_pPackedHigh(0),
 	m_pDataLength(0),
 	m_totalDataLength(0)
 {
@@ -261,6 +277,8 @@ Node::Node(SpatialIndex::RTree::RTree* pTree, id_type id, uint32_t level, uint32
 		m_pData = new byte*[m_capacity + 1];
 		m_ptrMBR = new RegionPtr[m_capacity + 1];
 		m_pIdentifier = new id_type[m_capacity + 1];
+		m_pPackedLow = new double[m_pTree->m_dimension * m_packedStride];
+		m_pPackedHigh = new double[m_pTree->m_dimension * m_packedStride];
 	}
 	catch (...)
 	{
@@ -268,8 +286,18 @@ Node::Node(SpatialIndex::RTree::RTree* pTree, id_type id, uint32_t level, uint32
 		delete[] m_pData;
 		delete[] m_ptrMBR;
 		delete[] m_pIdentifier;
+		delete[] m_pPackedLow;
+		delete[] m_pPackedHigh;
 		throw;
 	}
+
+	// whole blocks of four are tested, the entries past the last child are
+	// empty boxes
+	for (uint32_t cIndex = 0; cIndex < m_pTree->m_dimension * m_packedStride; ++cIndex)
+	{
+		m_pPackedLow[cIndex] = std::numeric_limits<double>::max();
+		m_pPackedHigh[cIndex] = -std::numeric_limits<double>::max();
+	}
 }
 
 Node::~Node()
@@ -287,6 +315,8 @@ Node::~Node()
 	delete[] m_pDataLength;
 	delete[] m_ptrMBR;
 	delete[] m_pIdentifier;
+	delete[] m_pPackedLow;
+	delete[] m_pPackedHigh;
 }
 
 Node& Node::operator=(const Node& n)
@@ -294,6 +324,50 @@ Node& Node::operator=(const Node& n)
 	throw Tools::IllegalStateException("operator =: This should never be called.");
 }
 
+uint32_t Node::intersectingChildren(const double* low, const double* high, uint32_t* hits) const
+{
+	// Same test as Region::intersectsRegion: a child is rejected only if
+	// low > child high or high < child low in some dimension.
+	uint32_t cHits = 0;
+
+	for (uint32_t cBlock = 0; cBlock < m_children; cBlock += 4)
+	{
+#ifdef __AVX2__
+		__m256d in = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+		for (uint32_t cDim = 0; cDim < m_pTree->m_dimension; ++cDim)
+		{
+			__m256d lo = _mm256_loadu_pd(m_pPackedLow + cDim * m_packedStride + cBlock);
+			__m256d hi = _mm256_loadu_pd(m_pPackedHigh + cDim * m_packedStride + cBlock);
+			in = _mm256_and_pd(in, _mm256_cmp_pd(lo, _mm256_set1_pd(high[cDim]), _CMP_NGT_UQ));
+			in = _mm256_and_pd(in, _mm256_cmp_pd(hi, _mm256_set1_pd(low[cDim]), _CMP_NLT_UQ));
+		}
+
+		int mask = _mm256_movemask_pd(in);
+#else
+		int mask = 0xf;
+
+		for (uint32_t cDim = 0; cDim < m_pTree->m_dimension; ++cDim)
+		{
+			const double* lo = m_pPackedLow + cDim * m_packedStride + cBlock;
+			const double* hi = m_pPackedHigh + cDim * m_packedStride + cBlock;
+
+			for (uint32_t cLane = 0; cLane < 4; ++cLane)
+			{
+				if (lo[cLane] > high[cDim] || hi[cLane] < low[cDim]) mask &= ~(1 << cLane);
+			}
+		}
+#endif
+
+		for (uint32_t cLane = 0; cLane < 4 && cBlock + cLane < m_children; ++cLane)
+		{
+			if (mask & (1 << cLane)) hits[cHits++] = cBlock + cLane;
+		}
+	}
+
+	return cHits;
+}
+
 void Node::insertEntry(uint32_t dataLength, byte* pData, Region& mbr, id_type id)
 {
 	assert(m_children < m_capacity);
@@ -96,6 +96,11 @@ namespace SpatialIndex
 
 			virtual void split(uint32_t dataLength, byte* pData, Region& mbr, id_type id, NodePtr& left, NodePtr& right) = 0;
 
+			// Stores in hits the indices of the children whose MBRs intersect
+			// the box [low, high] and returns their number. Uses the packed
+			// MBRs, so it is only valid for nodes returned by readNode.
+			uint32_t intersectingChildren(const double* low, const double* high, uint32_t* hits) const;
+
 			RTree* m_pTree;
 				// Parent of all nodes.
 
@@ -124,6 +129,15 @@ namespace SpatialIndex
 			id_type* m_pIdentifier;
 				// The corresponding data identifiers.
 
+			uint32_t m_packedStride;
+				// The capacity rounded up to a multiple of four.
+
+			double* m_pPackedLow;
+			double* m_pPackedHigh;
+				// The data MBRs as structure of arrays, filled when the node is
+				// loaded. Coordinate d of child i is at [d * m_packedStride + i],
+				// and the unused entries are empty boxes.
+
 			uint32_t* m_pDataLength;
 
 			uint32_t m_totalDataLength;
@@ -28,6 +28,7 @@
 #include <cstring>
 #include <cmath>
 #include <limits>
+#include <typeinfo>
 
 #include <spatialindex/SpatialIndex.h>
 #include "Node.h"
@@ -1394,6 +1395,31 @@ void SpatialIndex::RTree::RTree::rangeQuery(RangeQueryType type, const IShape& q
 	Tools::LockGuard lock(&m_lock);
 #endif
 
+	// Plain regions and points are tested against all children of a node at
+	// once, using the packed child MBRs. Other shapes, including classes
+	// derived from Region or Point, go through the IShape interface.
+	const double* pLow = 0;
+	const double* pHigh = 0;
+	if (typeid(query) == typeid(Region))
+	{
+		const Region* pr = dynamic_cast<const Region*>(&query);
+		if (pr->m_dimension == m_dimension)
+		{
+			pLow = pr->m_pLow;
+			pHigh = pr->m_pHigh;
+		}
+	}
+	else if (typeid(query) == typeid(Point))
+	{
+		const Point* pp = dynamic_cast<const Point*>(&query);
+		if (pp->m_dimension == m_dimension)
+		{
+			pLow = pp->m_pCoords;
+			pHigh = pp->m_pCoords;
+		}
+	}
+	std::vector<uint32_t> hits(std::max(m_indexCapacity, m_leafCapacity) + 1);
+
 	std::stack<NodePtr> st;
 	NodePtr root = readNode(m_rootID);
 
@@ -1407,6 +1433,20 @@ void SpatialIndex::RTree::RTree::rangeQuery(RangeQueryType type, const IShape& q
 		{
 			v.visitNode(*n);
 
+			if (pLow != 0 && type == IntersectionQuery)
+			{
+				uint32_t cHits = n->intersectingChildren(pLow, pHigh, &hits[0]);
+
+				for (uint32_t cHit = 0; cHit < cHits; ++cHit)
+				{
+					uint32_t cChild = hits[cHit];
+					Data data = Data(n->m_pDataLength[cChild], n->m_pData[cChild], *(n->m_ptrMBR[cChild]), n->m_pIdentifier[cChild]);
+					v.visitData(data);
+					++(m_stats.m_u64QueryResults);
+				}
+				continue;
+			}
+
 			for (uint32_t cChild = 0; cChild < n->m_children; ++cChild)
 			{
 				bool b;
@@ -1425,6 +1465,17 @@ void SpatialIndex::RTree::RTree::rangeQuery(RangeQueryType type, const IShape& q
 		{
 			v.visitNode(*n);
 
+			if (pLow != 0)
+			{
+				uint32_t cHits = n->intersectingChildren(pLow, pHigh, &hits[0]);
+
+				for (uint32_t cHit = 0; cHit < cHits; ++cHit)
+				{
+					st.push(readNode(n->m_pIdentifier[hits[cHit]]));
+				}
+				continue;
+			}
+
 			for (uint32_t cChild = 0; cChild < n->m_children; ++cChild)
 			{
 				if (query.intersectsShape(*(n->m_ptrMBR[cChild]))) st.push(readNode(n->m_pIdentifier[cChild]));
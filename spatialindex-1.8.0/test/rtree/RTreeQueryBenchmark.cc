@@ -0,0 +1,201 @@
+/******************************************************************************
+ * Project:  libspatialindex - A C++ library for spatial indexing
+ * Author:   Marios Hadjieleftheriou, mhadji@gmail.com
+ ******************************************************************************
+ * Copyright (c) 2002, Marios Hadjieleftheriou
+ *
+ * All rights reserved.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+******************************************************************************/
+
+
+// Times intersection and point location queries on an in-memory R*-tree of
+// random boxes. Each query is run once as a Region or Point, which the tree
+// tests against all children of a node at once using the packed child MBRs,
+// and once as a class derived from Region or Point, which goes through the
+// IShape interface child by child. Both must find the same data.
+
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+
+// include library header file.
+#include <spatialindex/SpatialIndex.h>
+
+using namespace SpatialIndex;
+using namespace std;
+
+// Shapes that the tree only knows through IShape.
+class ShapeRegion : public Region
+{
+public:
+	ShapeRegion(const double* pLow, const double* pHigh, uint32_t dimension) : Region(pLow, pHigh, dimension) {}
+};
+
+class ShapePoint : public Point
+{
+public:
+	ShapePoint(const double* pCoords, uint32_t dimension) : Point(pCoords, dimension) {}
+};
+
+// counts the answers and sums their IDs.
+class CountVisitor : public IVisitor
+{
+public:
+	size_t m_count;
+	id_type m_sum;
+
+public:
+	CountVisitor() : m_count(0), m_sum(0) {}
+
+	void visitNode(const INode& n) {}
+
+	void visitData(const IData& d)
+	{
+		m_count++;
+		m_sum += d.getIdentifier();
+	}
+
+	void visitData(std::vector<const IData*>& v) {}
+};
+
+static double random01()
+{
+	return static_cast<double>(rand()) / RAND_MAX;
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		if (argc > 4)
+		{
+			cerr << "Usage: " << argv[0] << " [entries [queries [dimension]]]." << endl;
+			return -1;
+		}
+
+		uint32_t entries = (argc > 1) ? atoi(argv[1]) : 100000;
+		uint32_t queries = (argc > 2) ? atoi(argv[2]) : 100000;
+		uint32_t dimension = (argc > 3) ? atoi(argv[3]) : 3;
+		if (dimension < 1 || dimension > 3)
+		{
+			cerr << "The dimension must be 1, 2 or 3." << endl;
+			return -1;
+		}
+
+		// boxes about the size of mesh elements, so that a query hits a few.
+		double size = 1.0 / pow(static_cast<double>(entries), 1.0 / dimension);
+		double plow[3], phigh[3];
+
+		IStorageManager* memfile = StorageManager::createNewMemoryStorageManager();
+		id_type indexIdentifier;
+		ISpatialIndex* tree = RTree::createNewRTree(*memfile, 0.7, 100, 100, dimension, RTree::RV_RSTAR, indexIdentifier);
+
+		srand(0);
+		for (uint32_t cEntry = 0; cEntry < entries; ++cEntry)
+		{
+			for (uint32_t cDim = 0; cDim < dimension; ++cDim)
+			{
+				plow[cDim] = random01();
+				phigh[cDim] = plow[cDim] + size * random01();
+			}
+			Region r = Region(plow, phigh, dimension);
+			tree->insertData(0, 0, r, cEntry);
+		}
+
+		vector<double> lows(queries * dimension), highs(queries * dimension);
+		for (uint32_t cQuery = 0; cQuery < queries; ++cQuery)
+		{
+			for (uint32_t cDim = 0; cDim < dimension; ++cDim)
+			{
+				lows[cQuery * dimension + cDim] = random01();
+				highs[cQuery * dimension + cDim] = lows[cQuery * dimension + cDim] + size * random01();
+			}
+		}
+
+		CountVisitor packedRegion, shapeRegion, packedPoint, shapePoint;
+		clock_t start;
+
+		start = clock();
+		for (uint32_t cQuery = 0; cQuery < queries; ++cQuery)
+		{
+			Region r = Region(&lows[cQuery * dimension], &highs[cQuery * dimension], dimension);
+			tree->intersectsWithQuery(r, packedRegion);
+		}
+		double packedRegionTime = static_cast<double>(clock() - start) / CLOCKS_PER_SEC;
+
+		start = clock();
+		for (uint32_t cQuery = 0; cQuery < queries; ++cQuery)
+		{
+			ShapeRegion r = ShapeRegion(&lows[cQuery * dimension], &highs[cQuery * dimension], dimension);
+			tree->intersectsWithQuery(r, shapeRegion);
+		}
+		double shapeRegionTime = static_cast<double>(clock() - start) / CLOCKS_PER_SEC;
+
+		start = clock();
+		for (uint32_t cQuery = 0; cQuery < queries; ++cQuery)
+		{
+			Point p = Point(&lows[cQuery * dimension], dimension);
+			tree->intersectsWithQuery(p, packedPoint);
+		}
+		double packedPointTime = static_cast<double>(clock() - start) / CLOCKS_PER_SEC;
+
+		start = clock();
+		for (uint32_t cQuery = 0; cQuery < queries; ++cQuery)
+		{
+			ShapePoint p = ShapePoint(&lows[cQuery * dimension], dimension);
+			tree->intersectsWithQuery(p, shapePoint);
+		}
+		double shapePointTime = static_cast<double>(clock() - start) / CLOCKS_PER_SEC;
+
+		cerr << "Entries: " << entries << ", queries: " << queries << ", dimension: " << dimension << endl;
+		cerr << "Region queries: " << packedRegion.m_count << " answers, packed "
+			<< packedRegionTime << " s, per child " << shapeRegionTime << " s, speedup "
+			<< shapeRegionTime / packedRegionTime << endl;
+		cerr << "Point queries: " << packedPoint.m_count << " answers, packed "
+			<< packedPointTime << " s, per child " << shapePointTime << " s, speedup "
+			<< shapePointTime / packedPointTime << endl;
+
+		delete tree;
+		delete memfile;
+
+		if (packedRegion.m_count != shapeRegion.m_count || packedRegion.m_sum != shapeRegion.m_sum ||
+			packedPoint.m_count != shapePoint.m_count || packedPoint.m_sum != shapePoint.m_sum)
+		{
+			cerr << "Packed and per child queries found different data." << endl;
+			return -1;
+		}
+	}
+	catch (Tools::Exception& e)
+	{
+		cerr << "******ERROR******" << endl;
+		std::string s = e.what();
+		cerr << s << endl;
+		return -1;
+	}
+	catch (...)
+	{
+		cerr << "******ERROR******" << endl;
+		cerr << "other exception" << endl;
+		return -1;
+	}
+
+	return 0;
+}
@@ -38,6 +38,7 @@
 #include "c++debug.h"
 
 #include "flmpi.h"
+#include "Halos_IO.h"
 
 using namespace std;
 
@@ -54,6 +55,7 @@ void Usage(){
        << "\n"
        << "Options:\n"
        << "\n"
+       << "-b\t\tWrite halo files in the binary format\n"
        << "-h\t\tDisplay this help\n"
        << "-i\t\tInput number of processors\n"
        << "-l\t\tWrite output to log files\n"
@@ -78,7 +80,7 @@ int main(int argc, char** argv){
   optarg = NULL;  
   char c;
   map<char, string> args;
-  while((c = getopt(argc, argv, "i:o:hlv")) != -1){
+  while((c = getopt(argc, argv, "bi:o:hlv")) != -1){
     if (c != '?'){
       if(optarg == NULL){
         args[c] = "true";
@@ -133,6 +135,11 @@ int main(int argc, char** argv){
     verbosity = 3;
   }
   set_global_debug_level_fc(&verbosity);
+
+  // Halo file format
+  if(args.count('b')){
+    Fluidity::SetHaloWriteFormat(Fluidity::HALO_FORMAT_BINARY);
+  }
   
   // Input and output base names
   string input_basename, output_basename;
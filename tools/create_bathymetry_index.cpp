@@ -0,0 +1,55 @@
+/*  Copyright (C) 2006 Imperial College London and others.
+
+    Please see the AUTHORS file in the main source directory for a full list
+    of copyright holders.
+
+    Prof. C Pain
+    Applied Modelling and Computation Group
+    Department of Earth Science and Engineering
+    Imperial College London
+
+    amcgsoftware@imperial.ac.uk
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation,
+    version 2.1 of the License.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+    USA
+*/
+
+// Converts a netCDF bathymetry grid into a tiled, memory mapped
+// bathymetry index (basename.idx and basename.dat). Giving basename.idx
+// as the bathymetry file samples the grid out-of-core, with the mapped
+// pages shared by all the processes on a node.
+//
+// Usage: create_bathymetry_index input.nc basename
+
+#include "confdefs.h"
+#include "BathymetryIndex.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char **argv){
+  if(argc!=3){
+    cerr<<"Usage: "<<argv[0]<<" input.nc basename\n";
+    return 1;
+  }
+
+  BathymetryIndex::Create(string(argv[1]), string(argv[2]));
+
+  cout<<"Created "<<argv[2]<<".idx and "<<argv[2]<<".dat\n";
+  return 0;
+}
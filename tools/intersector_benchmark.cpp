@@ -0,0 +1,227 @@
+/*  Copyright (C) 2006 Imperial College London and others.
+
+    Please see the AUTHORS file in the main source directory for a full list
+    of copyright holders.
+
+    Prof. C Pain
+    Applied Modelling and Computation Group
+    Department of Earth Science and Engineering
+    Imperial College London
+
+    amcgsoftware@imperial.ac.uk
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation,
+    version 2.1 of the License.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+    USA
+*/
+
+// Microbenchmark of the element intersectors: compares the number of
+// triangle and tetrahedron pairs intersected per second by the Wm4
+// intersectors, used as they were before the clipping fast path, with
+// ElementIntersector2D and WmElementIntersector3D.
+//
+// Usage: intersector_benchmark [npairs]
+
+#include "confdefs.h"
+#include "Element_Intersection.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sys/time.h>
+#include <vector>
+
+using namespace std;
+
+using namespace Fluidity;
+
+namespace
+{
+  double WallTime()
+  {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + 1.0e-6 * tv.tv_usec;
+  }
+
+  double Random()
+  {
+    return (double) rand() / RAND_MAX;
+  }
+
+  // npairs random pairs of simplices of unit size, the second displaced
+  // from the first by up to one unit, so that roughly half intersect
+  void RandomPairs(int dim, int npairs, vector<double>& a, vector<double>& b)
+  {
+    int n = dim * (dim + 1);
+    a.resize(n * npairs);
+    b.resize(n * npairs);
+    for(int p = 0;p < npairs;p++)
+    {
+      double shift[3];
+      for(int i = 0;i < dim;i++)
+      {
+        shift[i] = Random() - 0.5;
+      }
+      for(int j = 0;j < dim + 1;j++)
+      {
+        for(int i = 0;i < dim;i++)
+        {
+          a[p * n + j * dim + i] = Random();
+          b[p * n + j * dim + i] = Random() + shift[i];
+        }
+      }
+    }
+  }
+
+  double TriangleArea(const double* p0, const double* p1, const double* p2)
+  {
+    return 0.5 * fabs((p1[0] - p0[0]) * (p2[1] - p0[1]) - (p1[1] - p0[1]) * (p2[0] - p0[0]));
+  }
+
+  // Intersect every pair with Wm4, allocating an intersector per pair as
+  // the intersectors did. Returns the total measure of the intersections.
+  double Wm4Pairs(int dim, int npairs, const vector<double>& a, const vector<double>& b)
+  {
+    typedef Wm4::Vector2<double> Vector2;
+    typedef Wm4::Vector3<double> Vector3;
+
+    int n = dim * (dim + 1);
+    double measure = 0.0;
+    for(int p = 0;p < npairs;p++)
+    {
+      const double* pa = &a[p * n];
+      const double* pb = &b[p * n];
+      if(dim == 2)
+      {
+        Wm4::Triangle2<double> triA(Vector2(pa[0], pa[1]), Vector2(pa[2], pa[3]), Vector2(pa[4], pa[5]));
+        Wm4::Triangle2<double> triB(Vector2(pb[0], pb[1]), Vector2(pb[2], pb[3]), Vector2(pb[4], pb[5]));
+        triA.Orient();
+        triB.Orient();
+        Wm4::IntrTriangle2Triangle2<double>* intersection = new Wm4::IntrTriangle2Triangle2<double>(triA, triB);
+        intersection->Find();
+        for(int i = 1;i < intersection->GetQuantity() - 1;i++)
+        {
+          Vector2 p0 = intersection->GetPoint(0), p1 = intersection->GetPoint(i), p2 = intersection->GetPoint(i + 1);
+          measure += 0.5 * fabs((p1[0] - p0[0]) * (p2[1] - p0[1]) - (p1[1] - p0[1]) * (p2[0] - p0[0]));
+        }
+        delete intersection;
+      }
+      else
+      {
+        Wm4::Tetrahedron3<double> tetA(Vector3(pa), Vector3(pa + 3), Vector3(pa + 6), Vector3(pa + 9));
+        Wm4::Tetrahedron3<double> tetB(Vector3(pb), Vector3(pb + 3), Vector3(pb + 6), Vector3(pb + 9));
+        Wm4::IntrTetrahedron3Tetrahedron3<double>* intersection = new Wm4::IntrTetrahedron3Tetrahedron3<double>(tetA, tetB);
+        intersection->Find();
+        vector<Wm4::Tetrahedron3<double> > tets = intersection->GetIntersection();
+        vector<double>* volumes = new vector<double>(tets.size());
+        for(size_t i = 0;i < tets.size();i++)
+        {
+          (*volumes)[i] = tets[i].GetVolume();
+          if((*volumes)[i] > 0.0)
+          {
+            measure += (*volumes)[i];
+          }
+        }
+        delete volumes;
+        delete intersection;
+      }
+    }
+
+    return measure;
+  }
+
+  // Intersect every pair with the ElementIntersector for dim
+  double IntersectorPairs(int dim, int npairs, const vector<double>& a, const vector<double>& b)
+  {
+    ElementIntersector* intersector = NewElementIntersector(dim, 0);
+    vector<double> positions(3 * 4 * maxClippedTetrahedra);
+    vector<int> enlist(4 * maxClippedTetrahedra);
+    double input[2][12];
+    double* inputA = input[0];
+    double* inputB = input[1];
+    double* outputPositions = &positions[0];
+    int* outputEnlist = &enlist[0];
+
+    int n = dim * (dim + 1);
+    double measure = 0.0;
+    for(int p = 0;p < npairs;p++)
+    {
+      memcpy(inputA, &a[p * n], n * sizeof(double));
+      memcpy(inputB, &b[p * n], n * sizeof(double));
+      intersector->SetInput(inputA, inputB, dim, dim + 1);
+      intersector->Intersect();
+      int nnodes, nelms;
+      intersector->QueryOutput(nnodes, nelms);
+      if(nelms == 0)
+      {
+        continue;
+      }
+      intersector->GetOutput(outputPositions, outputEnlist);
+      for(int ele = 0;ele < nelms;ele++)
+      {
+        const int* nodes = &enlist[ele * (dim + 1)];
+        double vertices[4][3];
+        for(int j = 0;j < dim + 1;j++)
+        {
+          for(int i = 0;i < dim;i++)
+          {
+            vertices[j][i] = positions[nodes[j] - 1 + i * nnodes];
+          }
+        }
+        if(dim == 2)
+        {
+          measure += TriangleArea(vertices[0], vertices[1], vertices[2]);
+        }
+        else
+        {
+          measure += fabs(TetrahedronVolume(&vertices[0][0]));
+        }
+      }
+    }
+    delete intersector;
+
+    return measure;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  int npairs = argc > 1 ? atoi(argv[1]) : 100000;
+  if(npairs <= 0)
+  {
+    cerr << "Usage: intersector_benchmark [npairs]" << endl;
+    return 1;
+  }
+
+  for(int dim = 2;dim <= 3;dim++)
+  {
+    vector<double> a, b;
+    srand(1);
+    RandomPairs(dim, npairs, a, b);
+
+    double start = WallTime();
+    double wm4Measure = Wm4Pairs(dim, npairs, a, b);
+    double wm4Time = WallTime() - start;
+
+    start = WallTime();
+    double measure = IntersectorPairs(dim, npairs, a, b);
+    double time = WallTime() - start;
+
+    cout << dim << "D: Wm4 " << npairs / wm4Time << " pairs/s, clipping " << npairs / time
+         << " pairs/s, speedup " << wm4Time / time << endl;
+    cout << "    total intersection measure: Wm4 " << wm4Measure << ", clipping " << measure << endl;
+  }
+
+  return 0;
+}